@@ -0,0 +1,147 @@
+/// @file Benchmark.cpp performance profile of the card, the buses and the sensors
+///
+#include <stdio.h>
+#include <string.h>
+#include "Benchmark.h"
+
+#define BENCH_SECTOR    512
+#define BENCH_W1_MS     1000        // a conversion takes 750 ms at 12 bit
+
+static uint32_t rate(uint32_t n, uint32_t us)
+{
+    return us ? (uint32_t)((uint64_t)n * 1000000 / us) : 0;
+}
+
+bool Benchmark_Sequential(const char *path, char *buf, int size, uint32_t bytes, BENCH_SEQ_T *r)
+{
+    Timer t;
+    bool ok = true;
+    memset(r, 0, sizeof(*r));
+    r->size = size;
+    for (int i = 0; i < size; i++)
+        buf[i] = 'A' + i % 26;
+
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL)
+        return false;
+    setvbuf(fp, NULL, _IONBF, 0);       // one call, one file system write
+    t.start();
+    for (uint32_t done = 0; ok && done < bytes; done += size) {
+        int t0 = t.read_us();
+        ok = fwrite(buf, 1, size, fp) == (size_t)size;
+        uint32_t us = t.read_us() - t0;
+        if (us > r->wr_max)
+            r->wr_max = us;
+    }
+    if (fclose(fp))
+        ok = false;
+    r->wr_bps = rate(bytes, t.read_us());
+    if (!ok)
+        return false;
+
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return false;
+    setvbuf(fp, NULL, _IONBF, 0);
+    uint32_t got = 0;
+    t.reset();
+    while (got < bytes && fread(buf, 1, size, fp) == (size_t)size)
+        got += size;
+    r->rd_bps = rate(got, t.read_us());
+    fclose(fp);
+    return got == bytes;
+}
+
+bool Benchmark_Random(const char *path, char *buf, uint32_t bytes, int writes, BENCH_RAND_T *r)
+{
+    Timer t;
+    uint32_t seed = 12345, sectors = bytes / BENCH_SECTOR, total = 0;
+    memset(r, 0, sizeof(*r));
+    FILE *fp = fopen(path, "r+");
+    if (fp == NULL || sectors == 0)
+        return false;
+    setvbuf(fp, NULL, _IONBF, 0);
+    t.start();
+    for (int i = 0; i < writes; i++) {
+        seed = seed * 1103515245 + 12345;
+        long off = (long)((seed >> 16) % sectors) * BENCH_SECTOR;
+        int t0 = t.read_us();
+        if (fseek(fp, off, SEEK_SET) || fwrite(buf, 1, BENCH_SECTOR, fp) != BENCH_SECTOR)
+            break;
+        uint32_t us = t.read_us() - t0;
+        total += us;
+        if (us > r->max)
+            r->max = us;
+        r->writes++;
+    }
+    bool ok = fclose(fp) == 0 && r->writes == writes;
+    r->iops = rate(r->writes, t.read_us());
+    r->avg = r->writes ? total / r->writes : 0;
+    return ok;
+}
+
+void Benchmark_OneWire(ProbeManager *chain, BENCH_W1_T *r)
+{
+    Timer t;
+    memset(r, 0, sizeof(*r));
+    if (chain->count() == 0)
+        return;
+    r->ok = true;
+
+    DS1820 *first = chain->probe(0);
+    t.start();
+    first->startConversion(DS1820::this_device);
+    while (first->conversionState() != DS1820::conv_ready) {
+        if (t.read_ms() > BENCH_W1_MS) {
+            r->ok = false;
+            break;
+        }
+    }
+    r->conversion = t.read_us();
+
+    uint32_t total = 0;
+    for (int i = 0; i < chain->count(); i++) {
+        t.reset();
+        if (chain->probe(i)->temperature_raw() == DS1820::invalid_conversion)
+            r->ok = false;
+        uint32_t us = t.read_us();
+        total += us;
+        if (us > r->readmax)
+            r->readmax = us;
+    }
+    r->readavg = total / chain->count();
+
+    t.reset();
+    if (!chain->convertAll(BENCH_W1_MS))
+        r->ok = false;
+    r->chain = t.read_us();
+}
+
+void Benchmark_AdcStart(PressureADC *adc, BENCH_ADC_T *r)
+{
+    r->start_us = us_ticker_read();
+    r->start_samples = adc->samples();
+    r->start_readings = adc->readings();
+}
+
+void Benchmark_AdcEnd(PressureADC *adc, BENCH_ADC_T *r)
+{
+    r->window = us_ticker_read() - r->start_us;
+    r->samples = rate(adc->samples() - r->start_samples, r->window);
+    r->readings = rate(adc->readings() - r->start_readings, r->window);
+}
+
+uint32_t Benchmark_SerialTx(Serial *port, int bytes)
+{
+    Timer t;
+    // the first two characters only fill the holding and shift registers,
+    // from then on every character waits for one on the line
+    port->putc('-');
+    port->putc('-');
+    t.start();
+    for (int i = 2; i < bytes - 2; i++)
+        port->putc('-');
+    port->putc('\r');
+    port->putc('\n');
+    return rate(bytes - 2, t.read_us());
+}
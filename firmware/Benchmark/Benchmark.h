@@ -0,0 +1,123 @@
+/// @file Benchmark.h performance profile of the card, the buses and the sensors
+///
+/// The Bench command qualifies a unit before deployment: a slow card, a
+/// long 1-Wire chain or a weak serial link shows up on the bench instead of
+/// at sea. Every measurement takes the path the firmware uses in the field,
+/// the card through stdio and FatFs, the probes through DS1820 and the
+/// ProbeManager, so the numbers include the driver and file system cost.
+///
+/// \li sequential: a file is written and read back in calls of one
+///     transfer size, unbuffered, so each call is one file system write or
+///     read; the result is bytes per second and the longest write call
+/// \li random: 512 byte writes at sector aligned random offsets of that
+///     file, each a single sector write; writes per second, mean and
+///     longest write
+/// \li 1-Wire: one conversion on the first probe, polled until it is done,
+///     a scratchpad read of every probe and one complete chain reading
+/// \li ADC: samples the DMA handed over and decimated readings, counted
+///     over a window the caller lets pass between start and end
+/// \li serial: bytes per second the port takes over a line of text
+///
+/// Times are measured with a Timer, in us. The functions take their time
+/// in one go, the caller runs them one at a time and lets the other work
+/// run between them.
+///
+/// example:
+/// @code
+/// char buf[1024];
+/// BENCH_SEQ_T s;
+///
+/// if (Benchmark_Sequential("/sd/bench.tmp", buf, 512, 32768, &s))
+///     printf("%lu bytes/s\r\n", s.wr_bps);
+/// @endcode
+///
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "mbed.h"
+#include "ProbeManager.h"
+#include "PressureADC.h"
+
+/// One sequential pass
+typedef struct {
+    uint16_t size;          ///< bytes per write and read call
+    uint32_t wr_bps;        ///< write, bytes per second, the closing sync included
+    uint32_t rd_bps;        ///< read, bytes per second
+    uint32_t wr_max;        ///< longest write call, us
+} BENCH_SEQ_T;
+
+/// Random sector writes
+typedef struct {
+    uint16_t writes;        ///< 512 byte writes done
+    uint32_t iops;          ///< writes per second
+    uint32_t avg;           ///< mean write, us
+    uint32_t max;           ///< longest write, us
+} BENCH_RAND_T;
+
+/// 1-Wire bus timing
+typedef struct {
+    uint32_t conversion;    ///< first probe, Convert T until it reports done, us
+    uint32_t readavg;       ///< scratchpad read and CRC check per probe, us
+    uint32_t readmax;
+    uint32_t chain;         ///< complete chain reading, conversion and all reads, us
+    bool     ok;            ///< every probe answered
+} BENCH_W1_T;
+
+/// ADC rates
+typedef struct {
+    uint32_t samples;       ///< ADC samples per second
+    uint32_t readings;      ///< decimated readings per second
+    uint32_t window;        ///< time counted over, us
+    // the counts at Benchmark_AdcStart()
+    uint32_t start_us;
+    uint32_t start_samples;
+    uint32_t start_readings;
+} BENCH_ADC_T;
+
+/// Write a file and read it back, transfer size by transfer size
+///
+/// @param path is the scratch file, it is overwritten
+/// @param buf is the transfer buffer, size bytes
+/// @param size is the bytes per call
+/// @param bytes is the file size, a multiple of size
+/// @param r receives the result
+/// @returns false if the file cannot be written or read
+bool Benchmark_Sequential(const char *path, char *buf, int size, uint32_t bytes, BENCH_SEQ_T *r);
+
+/// Overwrite random sectors of a file written by Benchmark_Sequential()
+///
+/// @param path is the scratch file
+/// @param buf is a 512 byte buffer
+/// @param bytes is the file size
+/// @param writes is the number of writes
+/// @param r receives the result
+/// @returns false if the file cannot be written
+bool Benchmark_Random(const char *path, char *buf, uint32_t bytes, int writes, BENCH_RAND_T *r);
+
+/// Time the probes
+///
+/// @param chain is the probe chain, idle, with at least one probe
+/// @param r receives the result
+void Benchmark_OneWire(ProbeManager *chain, BENCH_W1_T *r);
+
+/// Start counting the ADC samples and readings, returns at once
+///
+/// @param adc is the running acquisition
+/// @param r holds the counts until Benchmark_AdcEnd()
+void Benchmark_AdcStart(PressureADC *adc, BENCH_ADC_T *r);
+
+/// End the count, a window of several seconds keeps the slow decimated
+/// rate within a few percent
+///
+/// @param adc is the acquisition given to Benchmark_AdcStart()
+/// @param r receives the result
+void Benchmark_AdcEnd(PressureADC *adc, BENCH_ADC_T *r);
+
+/// Send a line of text and time it
+///
+/// @param port is the serial port
+/// @param bytes is the line length, the line end included
+/// @returns bytes per second
+uint32_t Benchmark_SerialTx(Serial *port, int bytes);
+
+#endif // BENCHMARK_H
@@ -30,38 +30,56 @@
 
 #include "CommandProcessor.h"
 
-/// This holds the single linked list of commands
+/// This holds the commands, up to CMDP_MAX_COMMANDS, sorted by name without
+/// regard to case. The commands that start with what the user typed are
+/// then next to each other, two binary searches find them.
 /// @verbatim
-/// +-- Head->next
-/// v
-/// +-- p       +-- n
-/// v           v
-/// |menu|-------------------------------->|"Command"  |
-/// |next|->0   |menu|---->|"Help"         |"Help"     |
-///             |next|->0  |"..."          |*(callback)|
-///                        |*(callback)    |visible    |
-///                        |visible
+/// table[0]     table[1]     table[2]     table[3]
+///    |            |            |            |
+///    v            v            v            v
+/// |"?"    |    |"Adc"  |    |"Bench"|    |"Cal"  | ...
 /// @endverbatim
 ///
-typedef struct CMDLINK_T {
-    CMD_T * menu;                // handle to the menu item
-    struct CMDLINK_T * next;    // handle to the next link
-} CMDLINK_T;
+static CMD_T * table[CMDP_MAX_COMMANDS];
+static int tableCount = 0;
 
-static CMDLINK_T * head = NULL;
-
-static char *buffer;        // buffer space must be allocated based on the longest command
+static char *buffer;        // buffer space is sized based on the longest command
 static char *historyBuffer;        // keeps the history of commands for recall
+static char commandBuffer[CMDP_MAX_CMDLEN + 1];     // +1 for the terminator of a full line
+static char historyStore[CMDP_MAX_HISTORY * (CMDP_MAX_CMDLEN + 1)];
 static int historyCount = 0;    // and the count of
 static int historyDepth = 0;
 static size_t longestCommand = 0;
+static CMD_T *busy = NULL;      // the command that returned runbusy, each Run calls it again
+static char paramBuffer[CMDP_MAX_CMDLEN + 1];   // the parameters of the running command
+
+// Machine mode
+static unsigned char queue[CMDP_MAX_QUEUE];     // waiting requests, each id, len and the command line
+static int queueLen = 0;        // bytes in use, a request being received follows them
+static int requestId = -1;      // id of the running request
+static int inRequest = FALSE;   // its callback runs, Write goes into its reply
+static char reply[CMDP_MAX_PAYLOAD];
+static int replyLen = 0;
+
+enum { rx_sof, rx_id, rx_len, rx_data, rx_crc };
+static struct {
+    int state;              // the part of the request frame expected next
+    unsigned char id;
+    unsigned char len;
+    unsigned char crc;      // of the bytes so far
+    int got;                // command line bytes so far
+    int full;               // some of them did not fit the queue
+    unsigned long last;     // clock time of the latest byte
+} rx;
+static unsigned long (*clockMs)(void) = NULL;   // time base of the frame timeout, none without it
 
 static struct {
     CMD_T *SignOnBanner;
     int showSignOnBanner;        // Shows the sign-on banner at startup
     int caseinsensitive;    // FALSE=casesensitive, TRUE=insensitive
     int echo;               // TRUE=echo on, FALSE=echo off
-    int bufferSize;         // size of the command buffer
+    int machine;            // TRUE=machine mode, FALSE=command line
+    int bufferSize;         // size of the command buffer, the terminator included
     int (*kbhit)(void);
     int (*getch)(void);
     int (*putch)(int ch);
@@ -90,26 +108,40 @@ static ADDRESULT_T CommandProcessor_Add(CMD_T *m);
 static RUNRESULT_T CommandProcessor_Run(void);
 static RUNRESULT_T CommandProcessor_End(void);
 static RUNRESULT_T CommandProcessor_Echo(int echo);
+static void CommandProcessor_Write(const char *s, int n);
+static void CommandProcessor_Clock(unsigned long (*ms)(void));
+static int CommandProcessor_Machine(void);
 static void EraseChars(int keycount);
 static void EchoString(char * p);
+static RUNRESULT_T RunBusy(void);
+static RUNRESULT_T RunMachine(void);
+static void PutLine(const char *s);
+static void SendFrame(int id, REPLY_T status, const char *p, int n);
+static void CancelQueue(void);
 
 // helper functions
 static int myisprint(int c);
 static void mystrcat(char *dst, char *src);
 static char mytolower(char a);
 static int mystrnicmp(const char *l, const char *r, size_t n);
+static int prefixcmp(const char *name, const char *prefix, size_t n);
+static unsigned char crc8(unsigned char crc, unsigned char b);
 
 static CMDP_T CommandProcessor = {
     CommandProcessor_Init,
     CommandProcessor_Add,
     CommandProcessor_Run,
     CommandProcessor_Echo,
-    CommandProcessor_End
+    CommandProcessor_End,
+    CommandProcessor_Write,
+    CommandProcessor_Clock,
+    CommandProcessor_Machine
 };
 
 static RUNRESULT_T Help(char *p);
 static RUNRESULT_T History(char *p);
 static RUNRESULT_T Echo(char *p);
+static RUNRESULT_T Machine(char *p);
 static RUNRESULT_T Exit(char *p);
 //static RUNRESULT_T About(char *p);
 
@@ -117,6 +149,7 @@ static CMD_T HelpMenu = {"Help", "Help or '?' shows this help, 'Help ?' shows mo
 static CMD_T QuestionMenu = {"?", "Shows this help, '? ?' shows more details.", Help, invisible};
 static CMD_T HistoryMenu = {"History", "Show command history", History, visible};
 static CMD_T EchoMenu = {"Echo", "Echo [1|on|0|off] turns echo on or off.", Echo, visible};
+static CMD_T MachineMenu = {"Machine", "Machine [1|on|0|off] framed requests and replies for programs.", Machine, visible};
 static CMD_T ExitMenu = {"Exit", "Exits the program", Exit, visible};
 
 /// Gets a handle to the CommandProcessor
@@ -140,13 +173,13 @@ static RUNRESULT_T History(char *p) {
     int whereInHistory = 0;
     char buf[100];
 
-    cfg.puts("");
+    PutLine("");
     for (whereInHistory = 0; whereInHistory < historyCount; whereInHistory++) {
         sprintf(buf, "  %2i: %s", whereInHistory - historyCount, &historyBuffer[whereInHistory * cfg.bufferSize]);
-        cfg.puts(buf);
+        PutLine(buf);
     }
     sprintf(buf, "  %2i: %s", 0, buffer);
-    cfg.puts(buf);
+    PutLine(buf);
     return runok;
 }
 
@@ -169,37 +202,91 @@ static RUNRESULT_T Echo(char *p) {
             CommandProcessor_Echo(0);
     }
     if (cfg.echo)
-        cfg.puts("\r\nEcho is on");
+        PutLine("\r\nEcho is on");
     else
-        cfg.puts("\r\nEcho is off");
+        PutLine("\r\nEcho is off");
+    return runok;
+}
+
+/// Turns machine mode on and off
+///
+/// Switching it off cancels the requests that still wait, the reply to
+/// this one is the last frame.
+///
+/// @param p is a pointer to a string "on" | "1" | "off" | "0"
+/// @returns runok
+///
+static RUNRESULT_T Machine(char *p) {
+    if ((*p == '1' || mystrnicmp(p, "on", 2) == 0) && !cfg.machine) {
+        rx.state = rx_sof;
+        cfg.machine = TRUE;
+    }
+    if ((*p == '0' || mystrnicmp(p, "off", 3) == 0) && cfg.machine) {
+        CancelQueue();
+        keycount = 0;
+        buffer[keycount] = '\0';
+        cfg.machine = FALSE;
+    }
+    if (cfg.machine)
+        PutLine("\r\nMachine mode is on");
+    else
+        PutLine("\r\nMachine mode is off");
     return runok;
 }
 
 static RUNRESULT_T Exit(char *p) {
     (void)p;
-    cfg.puts("\r\nbye.");
+    PutLine("\r\nbye.");
     return runexit;
 }
 
 static RUNRESULT_T Help(char *p) {
-    CMDLINK_T *link = head;
+    int i;
     char buffer[100];
-    cfg.puts("\r\n");
+    PutLine("\r\n");
     //sprintf(buffer, " %-10s: %s", "Command", "Description");
     //cfg.puts(buffer);
-    while (link && link->menu) {
-        if (link->menu->visible) {
-            if (strlen(link->menu->command) + strlen(link->menu->helptext) + 5 < sizeof(buffer)) {
-                sprintf(buffer, " %-*s: %s", longestCommand, link->menu->command, link->menu->helptext);
-                cfg.puts(buffer);
+    for (i = 0; i < tableCount; i++) {
+        if (table[i]->visible) {
+            if (1 + longestCommand + 2 + strlen(table[i]->helptext) < sizeof(buffer)) {
+                sprintf(buffer, " %-*s: %s", (int)longestCommand, table[i]->command, table[i]->helptext);
+                PutLine(buffer);
             }
         }
-        link = link->next;
     }
-    cfg.puts("");
+    PutLine("");
     return runok;
 }
 
+/// FindCommands finds the commands that start with what the user typed
+///
+/// @param buffer is what the user typed
+/// @param n is the length of the command part of it
+/// @param first receives the table index of the first command that matches
+/// @returns the number of commands that match, they follow first in the table
+///
+static int FindCommands(const char *buffer, size_t n, int *first) {
+    int lo = 0, hi = tableCount;
+
+    while (lo < hi) {       // the first name not below the prefix
+        int mid = (lo + hi) / 2;
+        if (prefixcmp(table[mid]->command, buffer, n) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    *first = lo;
+    hi = tableCount;
+    while (lo < hi) {       // the first name above it
+        int mid = (lo + hi) / 2;
+        if (prefixcmp(table[mid]->command, buffer, n) <= 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo - *first;
+}
+
 
 /// CommandMatches is the function that determines if the user is entering a valid
 /// command
@@ -221,8 +308,7 @@ static int CommandMatches(char * buffer, int exec, CMD_T **menu, char **params)
     char *space;
     int compareLength;
     int foundCount = 0;
-    CMDLINK_T *link = head;
-    char * alternateBuffer;
+    int first, count, i;
 
     if (strlen(buffer)) {  // simple sanity check
         // Try to process the buffer. A command could be "Help", or it could be "Test1 123 abc"
@@ -234,47 +320,35 @@ static int CommandMatches(char * buffer, int exec, CMD_T **menu, char **params)
             compareLength = strlen(buffer);
             space = buffer + compareLength; // points to the NULL terminator
         }
-        while (link && link->menu) {
-            int cmpResult;
-
-            if (cfg.caseinsensitive) {
-                cmpResult = mystrnicmp(buffer, link->menu->command, compareLength);
-            } else
-                cmpResult = strncmp(buffer, link->menu->command, compareLength);
-            if (0 == cmpResult) {  // A match to what they typed
+        count = FindCommands(buffer, compareLength, &first);
+        for (i = first; i < first + count; i++) {
+            // the table matches without regard to case, a case sensitive parser checks again
+            if (cfg.caseinsensitive || 0 == strncmp(buffer, table[i]->command, compareLength)) {
                 if (menu) {  // yes, we have a callback
-                    *menu = link->menu;    // accessor to the command they want to execute
+                    *menu = table[i];    // accessor to the command they want to execute
                     *params = space;
                 }
                 foundCount++;    // how many command match what they typed so far
             }
-            link = link->next;    // follow the link to the next command
         }
         if (foundCount == 1) {
             // If we found exactly one and they expressed an intent to execute that command
-            // then we'll rewrite the command to be fully qualified
+            // then we'll rewrite the command to be fully qualified, in place
             if (exec) {  // command wants to execute it, not just validate the command syntax
                 // If they type "He 1234 5678", we backup and rewrite as "Help 1234 5678"
-                int diff = strlen((*menu)->command) - compareLength;    // e.g. 5 - 3
-
-                // or if they entered it in a case that doesn't match the command exactly
-                if (diff > 0 || 0 != strncmp(buffer, (*menu)->command, compareLength)) {
-                    char *p = buffer;
-                    alternateBuffer = (char *)malloc(cfg.bufferSize);
-                    strcpy(alternateBuffer, (*menu)->command);
-                    strcat(alternateBuffer, " ");
-                    strcat(alternateBuffer, space);
+                size_t len = strlen((*menu)->command);
+                size_t rest = strlen(space);    // the parameters
+
+                // or if they entered it in a case that doesn't match the command exactly,
+                // unless the full command would not fit the buffer
+                if ((len != (size_t)compareLength || 0 != strncmp(buffer, (*menu)->command, compareLength))
+                        && len + 1 + rest < (size_t)cfg.bufferSize) {
                     EraseChars(strlen(buffer));
-                    strcpy(buffer, alternateBuffer);
-                    free(alternateBuffer);
-                    EchoString(p);
-                    *params = strchr(buffer, ' ');        // if the command has parameters, find the delimiter
-                    if (*params) {
-                        (*params)++;        // advance to the char after the space (where the params may start)
-                    } else {
-                        compareLength = strlen(buffer);
-                        *params = buffer + compareLength; // points to the NULL terminator
-                    }
+                    memmove(buffer + len + 1, space, rest + 1);
+                    memcpy(buffer, (*menu)->command, len);
+                    buffer[len] = ' ';
+                    EchoString(buffer);
+                    *params = buffer + len + 1;
                 }
             }
         }
@@ -295,7 +369,8 @@ static int CommandMatches(char * buffer, int exec, CMD_T **menu, char **params)
 ///   \li CFG_ECHO_ON          - initialize with echo on
 ///   \li CFG_CASE_INSENSITIVE - Command Parser is case insensitive
 /// @param maxCmdLen sizes the buffer, and is the maximum number of characters in a single
-///        command, including all command arguments
+///        command, including all command arguments, at most CMDP_MAX_CMDLEN
+/// @param numInHistory is the history depth, at most CMDP_MAX_HISTORY
 /// @param kbhit is a user provided function to detect if a character is available for the CommandProcessor,
 ///        and when using standard io, you can typically use kbhit, or _kbhit as your system provides.
 /// @param getch is a user provided function that provides a single character to the CommandProcessor
@@ -321,16 +396,21 @@ INITRESULT_T CommandProcessor_Init(
     }
     if (maxCmdLen < 6)
         maxCmdLen = 6;
-    buffer = (char *)malloc(maxCmdLen);            // users often error by one, so we'll be generous
+    if (maxCmdLen > CMDP_MAX_CMDLEN)
+        maxCmdLen = CMDP_MAX_CMDLEN;
+    if (numInHistory > CMDP_MAX_HISTORY)
+        numInHistory = CMDP_MAX_HISTORY;
+    buffer = commandBuffer;
     historyDepth = numInHistory;
-    historyBuffer = (char *)malloc(historyDepth * maxCmdLen);
-    cfg.bufferSize = maxCmdLen;
+    historyBuffer = historyStore;
+    cfg.bufferSize = maxCmdLen + 1;
     if (buffer && historyBuffer) {
         if (config & CFG_ENABLE_SYSTEM) {
             CommandProcessor.Add(&QuestionMenu);
             CommandProcessor.Add(&HelpMenu);
             CommandProcessor.Add(&HistoryMenu);
             CommandProcessor.Add(&EchoMenu);
+            CommandProcessor.Add(&MachineMenu);
         }
         if (config & CFG_ENABLE_TERMINATE)
             CommandProcessor.Add(&ExitMenu);
@@ -338,6 +418,7 @@ INITRESULT_T CommandProcessor_Init(
         //    CommandProcessor.Add(&AboutMenu);
         cfg.caseinsensitive = (config & CFG_CASE_INSENSITIVE) ? 1 : 0;
         cfg.echo = (config & CFG_ECHO_ON) ? 1 : 0;
+        cfg.machine = FALSE;
         cfg.kbhit = kbhit;
         cfg.getch = getch;
         cfg.putch = putch;
@@ -357,41 +438,25 @@ INITRESULT_T CommandProcessor_Init(
 ///
 /// @param menu is the menu to add to the CommandProcessor
 /// @returns addok if the command was added
-/// @returns addfail if the command could not be added (failure to allocate memory for the linked list)
+/// @returns addfail if the command could not be added (the CMDP_MAX_COMMANDS table is full)
 ///
 ADDRESULT_T CommandProcessor_Add(CMD_T * menu) {
-    CMDLINK_T *ptr;
-    CMDLINK_T *prev;
-    CMDLINK_T *temp;
-
-    if (strlen(menu->command) > longestCommand)
-        longestCommand = strlen(menu->command);
-
-    // Allocate the storage for this menu item
-    temp = (CMDLINK_T *)malloc(sizeof(CMDLINK_T));
-    if (!temp)
-        return addfailed;            // something went really bad
-    temp->menu = menu;
-    temp->next = NULL;
-
-    prev = ptr = head;
-    if (!ptr) {
-        head = temp;            // This installs the very first item
-        return addok;
-    }
-    // Search alphabetically for the insertion point
-    while (ptr && mystrnicmp(ptr->menu->command, menu->command, strlen(menu->command)) < 0) {
-        prev = ptr;
-        ptr = ptr->next;
-    }
-    if (prev == head) {
-        head = temp;
-        head->next = prev;
-    } else {
-        prev->next = temp;
-        prev = temp;
-        prev->next = ptr;
+    size_t n = strlen(menu->command) + 1;   // the whole name, the terminator included
+    int i;
+
+    if (tableCount == CMDP_MAX_COMMANDS)
+        return addfailed;            // the command table is full
+    if (n - 1 > longestCommand)
+        longestCommand = n - 1;
+
+    // Search alphabetically for the insertion point, after any command of the same name
+    i = tableCount;
+    while (i > 0 && prefixcmp(table[i - 1]->command, menu->command, n) > 0) {
+        table[i] = table[i - 1];
+        i--;
     }
+    table[i] = menu;
+    tableCount++;
     return addok;
 }
 
@@ -513,8 +578,15 @@ static RUNRESULT_T ProcessStandardSequence(int c) {
             if (strlen(buffer)) {
                 foundCount = CommandMatches(buffer, TRUE, &cbk, &params);
                 if (foundCount == 1) {
-                    val = (*cbk->callback)(params);        // Execute the command
-                    if (mystrnicmp(buffer, (const char *)&historyBuffer[(historyCount-1) * cfg.bufferSize], strlen(&historyBuffer[(historyCount-1) * cfg.bufferSize])) != 0) {
+                    // the parameters outlive the command line, for a command that runs on
+                    strcpy(paramBuffer, params);
+                    val = (*cbk->callback)(paramBuffer);        // Execute the command
+                    if (val == runbusy)
+                        busy = cbk;
+                    else if (val == runfailed)
+                        val = runok;
+                    if (historyCount == 0
+                    || mystrnicmp(buffer, (const char *)&historyBuffer[(historyCount-1) * cfg.bufferSize], strlen(&historyBuffer[(historyCount-1) * cfg.bufferSize])) != 0) {
                         // not repeating the last command, so enter into the history
                         if (historyCount == historyDepth) {
                             int i;
@@ -538,7 +610,7 @@ static RUNRESULT_T ProcessStandardSequence(int c) {
             break;
         default:
             // any other character is assumed to be part of the command
-            if (myisprint(c) && keycount < cfg.bufferSize) {
+            if (myisprint(c) && keycount < cfg.bufferSize - 1) {
                 buffer[keycount++] = (char)c;
                 buffer[keycount] = '\0';
                 if (CommandMatches(buffer, FALSE, &cbk, &params))
@@ -584,12 +656,23 @@ static void PutCharToHex(int c) {
 /// When you press <enter> it will evaluate the command and execute the command
 /// passing it the parameter string.
 ///
+/// While a command is busy, this runs its next slice instead, the prompt
+/// and the command line wait for it.
+///
 /// @returns runok if the command that was run allows continuation of the CommandProcessor
 /// @returns runfail if the command that was run is asking the CommandProcessor to exit
+/// @returns runbusy if the command that was run is not finished
 ///
 RUNRESULT_T CommandProcessor_Run(void) {
     RUNRESULT_T val = runok;            // return true when happy, false to exit the prog
 
+    if (cfg.machine)
+        return RunMachine();
+    if (busy) {
+        val = RunBusy();
+        if (val != runok)
+            return val;
+    }
     if (cfg.showSignOnBanner) {
         cfg.SignOnBanner->callback("");
         cfg.showSignOnBanner = 0;
@@ -606,31 +689,342 @@ RUNRESULT_T CommandProcessor_Run(void) {
             // to be processed
             c = ProcessComplexSequence(c);
         }
-        ProcessStandardSequence(c);
+        val = ProcessStandardSequence(c);
+    }
+    return val;
+}
+
+/// RunBusy runs the next slice of the busy command, or cancels it
+///
+/// Input is read only for \<ctrl-c\> meanwhile, it would interleave with
+/// the output of the command, anything else is dropped.
+///
+/// @returns runbusy while the command goes on, else what it returned
+///
+static RUNRESULT_T RunBusy(void) {
+    RUNRESULT_T val;
+
+    if (cfg.kbhit() && cfg.getch() == 0x03) {   // <ctrl-c>
+        (*busy->callback)(NULL);
+        cfg.puts("^C");
+        val = runok;
+    } else
+        val = (*busy->callback)(paramBuffer);
+    if (val != runbusy)
+        busy = NULL;
+    return val == runfailed ? runok : val;
+}
+
+/// Call runs the callback of a machine mode request, its output is the reply
+///
+/// @param callback is the command
+/// @param p is the parameters, NULL to cancel it
+/// @returns what the command returned
+///
+static RUNRESULT_T Call(MENU_CALLBACK callback, char *p) {
+    RUNRESULT_T val;
+
+    inRequest = TRUE;
+    val = (*callback)(p);
+    inRequest = FALSE;
+    return val;
+}
+
+/// Finish sends the last frame of the reply to the running request
+///
+/// @param status is the outcome
+///
+static void Finish(REPLY_T status) {
+    SendFrame(requestId, status, reply, replyLen);
+    replyLen = 0;
+    requestId = -1;
+}
+
+/// ReplyStatus is the status of the reply to a command that is done
+///
+/// @param val is what it returned
+/// @returns the status
+///
+static REPLY_T ReplyStatus(RUNRESULT_T val) {
+    if (val == runfailed)
+        return replyfailed;
+    if (val == runexit)
+        return replyexit;
+    return replyok;
+}
+
+/// Dequeue removes a request from the queue
+///
+/// The request being received, behind the queue, moves along.
+///
+/// @param i is the offset of the request
+///
+static void Dequeue(int i) {
+    int n = 2 + queue[i + 1];
+
+    memmove(queue + i, queue + i + n, CMDP_MAX_QUEUE - i - n);
+    queueLen -= n;
+}
+
+/// CancelQueue cancels every request that waits
+static void CancelQueue(void) {
+    while (queueLen) {
+        SendFrame(queue[0], replycancelled, NULL, 0);
+        Dequeue(0);
+    }
+}
+
+/// Cancel cancels a request, running or waiting
+///
+/// @param id is the request id, an id that is neither is ignored
+///
+static void Cancel(int id) {
+    int i;
+
+    if (busy && id == requestId) {
+        Call(busy->callback, NULL);
+        busy = NULL;
+        Finish(replycancelled);
+        return;
+    }
+    for (i = 0; i < queueLen; i += 2 + queue[i + 1]) {
+        if (queue[i] == id) {
+            Dequeue(i);
+            SendFrame(id, replycancelled, NULL, 0);
+            return;
+        }
+    }
+}
+
+/// Receive takes the next byte of a request frame
+///
+/// A complete request joins the queue, unless it does not check, is longer
+/// than the command buffer, has id 0 or the queue has no room for it; the
+/// reply says so at once then.
+///
+/// @param c is the byte
+///
+static void Receive(int c) {
+    if (clockMs)
+        rx.last = clockMs();
+    switch (rx.state) {
+        case rx_sof:
+            if (c == CMDP_SOF)
+                rx.state = rx_id;
+            break;
+        case rx_id:
+            rx.id = (unsigned char)c;
+            rx.crc = crc8(0, rx.id);
+            rx.state = rx_len;
+            break;
+        case rx_len:
+            rx.len = (unsigned char)c;
+            rx.crc = crc8(rx.crc, rx.len);
+            rx.got = 0;
+            rx.full = FALSE;
+            rx.state = rx.len ? rx_data : rx_crc;
+            break;
+        case rx_data:
+            rx.crc = crc8(rx.crc, (unsigned char)c);
+            if (queueLen + 2 + rx.got < CMDP_MAX_QUEUE)
+                queue[queueLen + 2 + rx.got] = (unsigned char)c;
+            else
+                rx.full = TRUE;     // a Dequeue meanwhile does not bring the byte back
+            if (++rx.got == rx.len)
+                rx.state = rx_crc;
+            break;
+        case rx_crc:
+            rx.state = rx_sof;
+            if (c != rx.crc || rx.len >= cfg.bufferSize || rx.id == 0)
+                SendFrame(rx.id, replybadframe, NULL, 0);
+            else if (rx.len == 0)
+                Cancel(rx.id);
+            else if (rx.full || queueLen + 2 + rx.len > CMDP_MAX_QUEUE)
+                SendFrame(rx.id, replyfull, NULL, 0);
+            else {
+                queue[queueLen] = rx.id;
+                queue[queueLen + 1] = rx.len;
+                queueLen += 2 + rx.len;
+            }
+            break;
     }
+}
+
+/// ReceiveTimeout gives up a request frame that stopped short
+///
+/// A byte lost on the way would otherwise leave the receiver waiting for
+/// it, taking the following requests for the rest of this one. The reply,
+/// once the id is in, is replybadframe.
+///
+static void ReceiveTimeout(void) {
+    if (rx.state == rx_sof || !clockMs || clockMs() - rx.last <= CMDP_FRAME_TIMEOUT)
+        return;
+    if (rx.state != rx_id)
+        SendFrame(rx.id, replybadframe, NULL, 0);
+    rx.state = rx_sof;
+}
+
+/// StartRequest runs the request at the head of the queue
+///
+/// @returns what the command returned, runok if there was none
+///
+static RUNRESULT_T StartRequest(void) {
+    CMD_T *cbk = NULL;
+    char *params = NULL;
+    int id = queue[0];
+    int n = queue[1];
+    int foundCount;
+    RUNRESULT_T val;
+
+    memcpy(buffer, queue + 2, n);
+    buffer[n] = '\0';
+    Dequeue(0);
+    foundCount = CommandMatches(buffer, FALSE, &cbk, &params);
+    if (foundCount != 1) {
+        SendFrame(id, foundCount ? replyambiguous : replyunknown, NULL, 0);
+        return runok;
+    }
+    requestId = id;
+    strcpy(paramBuffer, params);
+    val = Call(cbk->callback, paramBuffer);
+    if (val == runbusy)
+        busy = cbk;
+    else
+        Finish(ReplyStatus(val));
     return val;
 }
 
+/// RunMachine is Run in machine mode
+///
+/// Takes the requests that came in, then runs a slice of the busy command
+/// or starts the next request.
+///
+/// @returns runbusy while a command runs, requests wait or a request frame
+///          is coming in, with a clock for its timeout
+///
+static RUNRESULT_T RunMachine(void) {
+    RUNRESULT_T val = runok;
+
+    ReceiveTimeout();
+    while (cfg.machine && cfg.kbhit())
+        Receive(cfg.getch() & 0xFF);
+    if (busy) {
+        val = Call(busy->callback, paramBuffer);
+        if (val != runbusy) {
+            busy = NULL;
+            Finish(ReplyStatus(val));
+        } else if (replyLen) {      // what the slice wrote goes out now
+            SendFrame(requestId, replymore, reply, replyLen);
+            replyLen = 0;
+        }
+    } else if (queueLen)
+        val = StartRequest();
+    if (val == runexit)
+        return runexit;
+    if (busy || queueLen || (clockMs && rx.state != rx_sof))
+        return runbusy;
+    return runok;
+}
+
+/// SendFrame sends one frame of a reply
+///
+/// @param id is the request id, 0 for output outside of one
+/// @param status is the status
+/// @param p is the payload
+/// @param n is its length, at most CMDP_MAX_PAYLOAD
+///
+static void SendFrame(int id, REPLY_T status, const char *p, int n) {
+    unsigned char head[3];
+    unsigned char crc = 0;
+    int i;
+
+    head[0] = (unsigned char)id;
+    head[1] = (unsigned char)status;
+    head[2] = (unsigned char)n;
+    cfg.putch(CMDP_SOF);
+    for (i = 0; i < 3; i++) {
+        crc = crc8(crc, head[i]);
+        cfg.putch(head[i]);
+    }
+    for (i = 0; i < n; i++) {
+        crc = crc8(crc, (unsigned char)p[i]);
+        cfg.putch((unsigned char)p[i]);
+    }
+    cfg.putch(crc);
+}
+
+/// Write is the output of the application, see CMDP_T
+///
+/// @param s is the output
+/// @param n is its length
+///
+static void CommandProcessor_Write(const char *s, int n) {
+    if (inRequest) {
+        while (n-- > 0) {
+            if (replyLen == CMDP_MAX_PAYLOAD) {     // the last frame of a reply carries the status
+                SendFrame(requestId, replymore, reply, replyLen);
+                replyLen = 0;
+            }
+            reply[replyLen++] = *s++;
+        }
+    } else if (cfg.machine) {
+        while (n > 0) {
+            int k = n < CMDP_MAX_PAYLOAD ? n : CMDP_MAX_PAYLOAD;
+            SendFrame(0, replyok, s, k);
+            s += k;
+            n -= k;
+        }
+    } else {
+        while (n-- > 0)
+            cfg.putch((unsigned char)*s++);
+    }
+}
+
+/// Clock sets the time base of the machine mode frame timeout, see CMDP_T
+///
+/// @param ms returns the time in milliseconds
+///
+static void CommandProcessor_Clock(unsigned long (*ms)(void)) {
+    clockMs = ms;
+}
+
+/// Machine tells if machine mode is on, see CMDP_T
+///
+/// @returns non-zero in machine mode
+///
+static int CommandProcessor_Machine(void) {
+    return cfg.machine;
+}
+
+/// PutLine shows a line of the system commands, in the reply in machine mode
+///
+/// @param s is the line, a line end is added
+///
+static void PutLine(const char *s) {
+    if (inRequest) {
+        CommandProcessor_Write(s, strlen(s));
+        CommandProcessor_Write("\r\n", 2);
+    } else
+        cfg.puts(s);
+}
+
 static RUNRESULT_T CommandProcessor_Echo(int echo) {
     cfg.echo = echo;
     return runok;
 }
 
-/// End the CommandProcessor by freeing all the memory that was allocated
+/// End the CommandProcessor by emptying the command table
 ///
 /// @returns runok
 ///
 RUNRESULT_T CommandProcessor_End(void) {
-    CMDLINK_T *p = head;
-    CMDLINK_T *n;
-
-    do {
-        n = p->next;
-        free(p);            // free each of the allocated links to menu items.
-        p = n;
-    } while (n);
-    free(buffer);            // finally, free the command buffer
-    buffer = NULL;            // flag it as deallocated
+    busy = NULL;
+    queueLen = 0;
+    requestId = -1;
+    cfg.machine = FALSE;
+    tableCount = 0;
+    longestCommand = 0;
+    buffer = NULL;            // flag the command buffer as released
     return runok;
 }
 
@@ -681,6 +1075,47 @@ static int mystrnicmp(const char *l, const char *r, size_t n) {
     return result;
 }
 
+/// prefixcmp orders a command name against the start of what the user typed
+///
+/// The comparison is without regard to case. A name that ends before n
+/// characters is below a prefix that goes on, with n past the end of the
+/// prefix it compares whole names.
+///
+/// @param name is the command name
+/// @param prefix is what the user typed
+/// @param n is the number of characters to compare
+/// @returns < 0 if name sorts before the prefix
+/// @returns 0 if name starts with the prefix
+/// @returns > 0 if name sorts after the prefix
+///
+static int prefixcmp(const char *name, const char *prefix, size_t n) {
+    for (; n > 0; n--, name++, prefix++) {
+        int result = mytolower(*name) - mytolower(*prefix);
+        if (result != 0 || *name == '\0')
+            return result;
+    }
+    return 0;
+}
+
+/// crc8 adds a byte to a Dallas/Maxim CRC-8, the check of machine mode frames
+///
+/// @param crc is the CRC of the bytes before
+/// @param b is the byte
+/// @returns the CRC including b
+///
+static unsigned char crc8(unsigned char crc, unsigned char b) {
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        int mix = (crc ^ b) & 0x01;
+        crc >>= 1;
+        if (mix)
+            crc ^= 0x8C;
+        b >>= 1;
+    }
+    return crc;
+}
+
 /// mystrcat exists because not all compiler libraries have this function
 ///
 /// This function concatinates one string onto another. It is generally
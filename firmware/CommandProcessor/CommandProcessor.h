@@ -33,6 +33,10 @@
 ///   the buffer is erased.
 /// \li The user is not permitted to enter text longer than the defined buffer,
 ///   to avoid buffer overrun and the possible memory damaging results.
+/// \li A long command can run in slices between calls of Run, so the application
+///   goes on meanwhile; \<ctrl-c\> cancels it. See MENU_CALLBACK.
+/// \li A machine mode for programs: framed requests with ids, several at a
+///   time, and framed replies with a status. See REPLY_T.
 ///
 /// The CommandProcessor is designed as a set of C functions, which makes it
 /// reusable in more systems (as C++ compilers are not always available for
@@ -144,13 +148,55 @@ typedef enum
 typedef enum
 {
     runexit,        ///< use this return value to cause the menu (perhaps the program) to exit
-    runok            ///< use this return value to keep the menu running
+    runok,           ///< use this return value to keep the menu running
+    runbusy,        ///< use this return value when the command is not finished, Run calls it again
+    runfailed       ///< use this return value when the command could not do what was asked, the menu keeps running
 } RUNRESULT_T;
 
+/// Machine mode replaces the interactive command line with frames, for a
+/// program on the other end instead of a user. The Machine command, one of
+/// the system commands, switches to it and 'Machine off' back.
+///
+/// A request is one command line, sent as
+/// @verbatim
+/// CMDP_SOF | id | len | command line, len bytes | crc
+/// @endverbatim
+/// The host picks the id, 1 to 255, to match the replies to the request;
+/// id 0 is refused, it is kept for the output outside of requests.
+/// It may send more requests without waiting, they queue up and run in
+/// the order they came, one at a time; a request with len 0 cancels the
+/// request with that id, waiting or running.
+///
+/// The reply is one or more frames
+/// @verbatim
+/// CMDP_SOF | id | status | len | payload, len bytes | crc
+/// @endverbatim
+/// The payload is the output of the command, split over as many frames as
+/// it takes, every frame but the last has status replymore. Frames of
+/// different requests do not mix within a frame, output that is not part
+/// of a request has id 0. The crc is the Dallas/Maxim CRC-8 of the bytes
+/// from the id on. A request that does not check is answered with
+/// replybadframe; the receiver looks for the next CMDP_SOF. So is one that
+/// stops short for CMDP_FRAME_TIMEOUT, when the application gave a Clock.
+typedef enum
+{
+    replymore,      ///< output of the command, more frames follow
+    replyok,        ///< the command is done
+    replyfailed,    ///< the command is done, it could not do what was asked (runfailed)
+    replyunknown,   ///< no command matches the request
+    replyambiguous, ///< more than one command matches the request
+    replyfull,      ///< the queue had no room for the request, it was dropped
+    replycancelled, ///< the request was cancelled, waiting or running
+    replybadframe,  ///< the request was too long, had id 0, timed out or did not check
+    replyexit       ///< the command asked the CommandProcessor to exit (runexit)
+} REPLY_T;
+
+#define CMDP_SOF             0xA5   ///<- first byte of every machine mode frame
+
 /// Adding items to the menu can succeed, or fail.
 typedef enum
 {
-    addfailed,        ///< this indicates the menu was not added (usually failure to allocate memory)
+    addfailed,        ///< this indicates the menu was not added (the command table is full)
     addok            ///< this indicates the menu was successfully added
 } ADDRESULT_T;
 
@@ -175,6 +221,28 @@ typedef unsigned long CONFIG_T;
 #define CFG_ECHO_ON          0x2000 ///<- Initialize with command prompt Echo on
 #define CFG_CASE_INSENSITIVE 0x4000 ///<- Enable case insensitive command entry
 
+/// The CommandProcessor takes no memory from the heap, its storage is sized
+/// at compile time. Override these before including the header, or on the
+/// compiler command line, to change them.
+#ifndef CMDP_MAX_COMMANDS
+#define CMDP_MAX_COMMANDS    32     ///<- Commands in the table, the system commands included
+#endif
+#ifndef CMDP_MAX_CMDLEN
+#define CMDP_MAX_CMDLEN      80     ///<- Longest command line, Init clamps maxCmdLen to it
+#endif
+#ifndef CMDP_MAX_HISTORY
+#define CMDP_MAX_HISTORY     5      ///<- Deepest history, Init clamps historyLen to it
+#endif
+#ifndef CMDP_MAX_QUEUE
+#define CMDP_MAX_QUEUE       128    ///<- Machine mode, bytes of waiting requests, each takes its length + 2
+#endif
+#ifndef CMDP_MAX_PAYLOAD
+#define CMDP_MAX_PAYLOAD     64     ///<- Machine mode, longest payload of a reply frame
+#endif
+#ifndef CMDP_FRAME_TIMEOUT
+#define CMDP_FRAME_TIMEOUT   250    ///<- Machine mode, ms a request frame may stop between two bytes
+#endif
+
 
 /// This is the type for the basic callback, when a menu pick is activated.
 ///
@@ -188,7 +256,34 @@ typedef unsigned long CONFIG_T;
 ///    passing to that function the string "ab c 123 567". Note that the delimiter space
 ///    was removed.
 /// 
-/// @param p is a pointer to a character string
+/// A command that takes longer than the application can wait for, a file
+/// transfer or a self-test, does a slice of its work and returns runbusy.
+/// Each following call of Run then calls it again, with the same parameters,
+/// until it returns runok or runexit; it keeps its progress in its own
+/// static variables. The prompt waits for it, and while it runs the input
+/// is read only for \<ctrl-c\>, other characters are dropped. \<ctrl-c\>
+/// cancels the command: it is called once more with p NULL, releases what
+/// it holds and returns.
+///
+/// A command that could not do what was asked, bad parameters or a device
+/// that does not answer, says why and returns runfailed. On the command line
+/// that is the same as runok, in machine mode the reply status tells it.
+///
+/// example:
+/// @code
+/// RUNRESULT_T Count(char *p)
+/// {
+///     static int n = -1;
+///     if (p == NULL || n == 10) {     // cancelled, or done
+///         n = -1;
+///         return runok;
+///     }
+///     printf("\r\n%d", ++n);
+///     return runbusy;
+/// }
+/// @endcode
+///
+/// @param p is a pointer to a character string, NULL to cancel a busy command
 /// @returns RUNRESULT_T to indicate if the CommandProcessor should continue
 ///
 typedef RUNRESULT_T (*MENU_CALLBACK)(char *p);
@@ -231,8 +326,9 @@ typedef const struct
     ///   \li CFG_ECHO_ON          - initialize with echo on
     ///   \li CFG_CASE_INSENSITIVE - Command Parser is case insensitive
     /// @param maxCmdLen sizes the buffer, and is the maximum number of characters in a single
-    ///        command, including all command arguments
-    /// @param historyLen sets the number of items that can be recalled from history
+    ///        command, including all command arguments, at most CMDP_MAX_CMDLEN
+    /// @param historyLen sets the number of items that can be recalled from history,
+    ///        at most CMDP_MAX_HISTORY
     /// @param kbhit is a user provided function to detect if a character is available for the CommandProcessor,
     ///        and when using standard io, you can typically use kbhit, or _kbhit as your system provides.
     /// @param getch is a user provided function that provides a single character to the CommandProcessor
@@ -271,8 +367,12 @@ typedef const struct
     /// of the menu functions. In this case, CPU cycles spent are based on the function 
     /// being executed.
     /// 
+    /// While a command is busy, each call runs the next slice of it instead.
+    ///
     /// @returns RUNRESULT_T to indicate if the CommandProcessor should remain active or if the 
     ///            command that was executed is requesting the CommandProcessor to exit.
+    /// @returns runbusy while a command is not finished, or in machine mode while
+    ///            requests wait, call Run again soon
     ///
     RUNRESULT_T (*Run)(void);
     
@@ -290,9 +390,42 @@ typedef const struct
 
     /// End if the function to be called when you want to gracefully end the CommandProcessor.
     ///
-    ///    Calling this function causes the CommandProcessor to free any memory that was previously
-    /// allocated by the Init and Add functions.
+    ///    Calling this function returns the command table entries taken by the Init and
+    /// Add functions.
     RUNRESULT_T (*End)(void);            ///< Called to shutdown the processor
+
+    /// Write is the output of the application
+    ///
+    /// The commands, and whatever else the application shows, write through
+    /// this instead of straight to the port. On the command line it goes on
+    /// to putch unchanged; in machine mode it is framed, as the reply of
+    /// the running request, or with id 0 outside of one.
+    ///
+    /// @param s is the output
+    /// @param n is its length in bytes, it may hold any byte value
+    ///
+    void (*Write)(const char *s, int n);
+
+    /// Clock gives machine mode a time base, optional
+    ///
+    /// With it a request frame that stops short, a byte lost on the way,
+    /// is given up after CMDP_FRAME_TIMEOUT; Run then returns runbusy while
+    /// a frame is coming in, to be called again to notice. Without it the
+    /// receiver waits for the missing bytes, taking them from the next
+    /// request.
+    ///
+    /// @param ms is a user provided function that returns the time in milliseconds
+    ///
+    void (*Clock)(unsigned long (*ms)(void));
+
+    /// Machine tells if machine mode is on
+    ///
+    /// Output that bypasses Write, straight to the port, would land
+    /// between the frames then.
+    ///
+    /// @returns non-zero in machine mode
+    ///
+    int (*Machine)(void);
 } CMDP_T;
 
 
@@ -0,0 +1,40 @@
+/// @file Console.cpp what the commands and the logger show on the serial port
+///
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "Console.h"
+
+int Console::putc(int c)
+{
+    char ch = (char)c;
+    _write(&ch, 1);
+    return c;
+}
+
+int Console::puts(const char *s)
+{
+    int n = strlen(s);
+    _write(s, n);
+    return n;
+}
+
+int Console::printf(const char *format, ...)
+{
+    char line[CONSOLE_LINE];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n < 0)
+        return n;
+    if (n >= (int)sizeof(line))
+        n = sizeof(line) - 1;
+    _write(line, n);
+    return n;
+}
+
+void Console::write(const void *data, int len)
+{
+    _write((const char *)data, len);
+}
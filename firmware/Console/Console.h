@@ -0,0 +1,57 @@
+/// @file Console.h what the commands and the logger show on the serial port
+///
+/// The commands print with printf(), puts() and putc() as they would on a
+/// Serial, but the output goes through the CommandProcessor's Write(): on
+/// the command line it reaches the port unchanged, in machine mode it is
+/// framed, as the reply to the running request or, outside of one, as a
+/// frame of its own. The commands need not know which mode is on.
+///
+/// printf() formats into a buffer on the stack, CONSOLE_LINE bytes, longer
+/// output is cut there. The port itself, for input and for the raw
+/// throughput test of Bench, stays a Serial.
+///
+/// example:
+/// @code
+/// Serial port(PB_10, PB_11);
+/// Console console(GetCommandProcessor()->Write);
+///
+/// RUNRESULT_T Who(char *p)
+/// {
+///     console.printf("\r\n%d users\r\n", users);
+///     return runok;
+/// }
+/// @endcode
+///
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#ifndef CONSOLE_LINE
+#define CONSOLE_LINE    128         ///< longest output of one printf()
+#endif
+
+class Console {
+public:
+    /// @param write is the Write() of the command processor, it must be
+    ///        initialized before the first output
+    Console(void (*write)(const char *s, int n)) : _write(write) {}
+
+    /// @returns the character written
+    int putc(int c);
+
+    /// @returns the number of characters written
+    int puts(const char *s);
+
+    /// @returns the number of characters written
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    /// Write bytes of any value, binary dumps
+    ///
+    /// @param data is the output
+    /// @param len is its length
+    void write(const void *data, int len);
+
+private:
+    void (*_write)(const char *s, int n);
+};
+
+#endif // CONSOLE_H
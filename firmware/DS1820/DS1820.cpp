@@ -1,145 +1,73 @@
 #include "DS1820.h"
+#include "Metrics.h"
 
-#ifdef TARGET_STM
-//STM targets use opendrain mode since their switching between input and output is slow
-    #define ONEWIRE_INPUT(pin)  pin->write(1)
-    #define ONEWIRE_OUTPUT(pin) 
-    #define ONEWIRE_INIT(pin)   pin->output(); pin->mode(OpenDrain)
-#else
-    #define ONEWIRE_INPUT(pin)  pin->input()
-    #define ONEWIRE_OUTPUT(pin) pin->output()
-    #define ONEWIRE_INIT(pin)
-#endif
+DS1820 *DS1820::probes[DS1820_MAX_PROBES];
+int DS1820::probe_count = 0;
+ 
+ 
+DS1820::DS1820 (OneWire *bus, PinName power_pin, bool power_polarity) : _bus(bus), _parasitepin(power_pin) {
+    _power_polarity = power_polarity;
+    init(power_pin, NULL);
+}
 
-#ifdef TARGET_NORDIC
-//NORDIC targets (NRF) use software delays since their ticker uses a 32kHz clock
-    static uint32_t loops_per_us = 0;
-    
-    #define INIT_DELAY      init_soft_delay()
-    #define ONEWIRE_DELAY_US(value) for(int cnt = 0; cnt < (value * loops_per_us) >> 5; cnt++) {__NOP(); __NOP(); __NOP();}
-    
-void init_soft_delay( void ) {
-    if (loops_per_us == 0) {
-        loops_per_us = 1;
-        Timer timey; 
-        timey.start();
-        ONEWIRE_DELAY_US(320000);                     
-        timey.stop();
-        loops_per_us = (320000 + timey.read_us() / 2) / timey.read_us();  
-    }
+DS1820::DS1820 (OneWire *bus, const char *ROM_address, PinName power_pin, bool power_polarity) : _bus(bus), _parasitepin(power_pin) {
+    _power_polarity = power_polarity;
+    init(power_pin, ROM_address);
 }
-#else
-    #define INIT_DELAY
-    #define ONEWIRE_DELAY_US(value) wait_us(value)
-#endif
 
-LinkedList<node> DS1820::probes;
- 
- 
-DS1820::DS1820 (PinName data_pin, PinName power_pin, bool power_polarity) : _datapin(data_pin), _parasitepin(power_pin) {
+void DS1820::init(PinName power_pin, const char *ROM_address) {
     int byte_counter;
-    _power_polarity = power_polarity;
 
     _power_mosfet = power_pin != NC;
+    _conv_state = conv_idle;
     
     for(byte_counter=0;byte_counter<9;byte_counter++)
         RAM[byte_counter] = 0x00;
     
-    ONEWIRE_INIT((&_datapin));
-    INIT_DELAY;
-    
-    if (!unassignedProbe(&_datapin, _ROM))
+    if (probe_count == DS1820_MAX_PROBES)
+        error("Too many DS1820 probes!\n");
+    else if (ROM_address != NULL) {
+        memcpy(_ROM, ROM_address, 8);   // known id, no search
+        probes[probe_count++] = this;
+        _parasite_power = !read_power_supply();
+    } else if (!search_ROM_routine(_bus, 0xF0, _ROM))
         error("No unassigned DS1820 found!\n");
     else {
-        _datapin.input();
-        probes.append(this);
+        probes[probe_count++] = this;
         _parasite_power = !read_power_supply();
     }
 }
 
 DS1820::~DS1820 (void) {
-    node *tmp;
-    for(int i=1; i<=probes.length(); i++)
-    {
-        tmp = probes.pop(i);
-        if (tmp->data == this)
-            probes.remove(i);
+    for(int i=0; i<probe_count; i++) {
+        if (probes[i] == this) {
+            probes[i] = probes[--probe_count];   // order does not matter, fill the hole with the last one
+            probes[probe_count] = NULL;
+            break;
+        }
     }
 }
 
- 
-bool DS1820::onewire_reset(DigitalInOut *pin) {
-// This will return false if no devices are present on the data bus
-    bool presence=false;
-    ONEWIRE_OUTPUT(pin);
-    pin->write(0);          // bring low for 500 us
-    ONEWIRE_DELAY_US(500);
-    ONEWIRE_INPUT(pin);       // let the data line float high
-    ONEWIRE_DELAY_US(90);            // wait 90us
-    if (pin->read()==0) // see if any devices are pulling the data line low
-        presence=true;
-    ONEWIRE_DELAY_US(410);
-    return presence;
-}
- 
-void DS1820::onewire_bit_out (DigitalInOut *pin, bool bit_data) {
-    ONEWIRE_OUTPUT(pin);
-    pin->write(0);
-    ONEWIRE_DELAY_US(3);                 // DXP modified from 5
-    if (bit_data) {
-        pin->write(1); // bring data line high
-        ONEWIRE_DELAY_US(55);
-    } else {
-        ONEWIRE_DELAY_US(55);            // keep data line low
-        pin->write(1);
-        ONEWIRE_DELAY_US(10);            // DXP added to allow bus to float high before next bit_out
+bool DS1820::known_ROM(const char *ROM_address) {
+    for (int i=0; i<probe_count; i++) {
+        if (memcmp(probes[i]->_ROM, ROM_address, 8) == 0)
+            return true;
     }
-}
- 
-void DS1820::onewire_byte_out(char data) { // output data character (least sig bit first).
-    int n;
-    for (n=0; n<8; n++) {
-        onewire_bit_out(&this->_datapin, data & 0x01);
-        data = data >> 1; // now the next bit is in the least sig bit position.
-    }
-}
- 
-bool DS1820::onewire_bit_in(DigitalInOut *pin) {
-    bool answer;
-    ONEWIRE_OUTPUT(pin);
-    pin->write(0);
-    ONEWIRE_DELAY_US(3);                 // DXP modofied from 5
-    ONEWIRE_INPUT(pin);
-    ONEWIRE_DELAY_US(10);                // DXP modified from 5
-    answer = pin->read();
-    ONEWIRE_DELAY_US(45);                // DXP modified from 50
-    return answer;
-}
- 
-char DS1820::onewire_byte_in() { // read byte, least sig byte first
-    char answer = 0x00;
-    int i;
-    for (i=0; i<8; i++) {
-        answer = answer >> 1; // shift over to make room for the next bit
-        if (onewire_bit_in(&this->_datapin))
-            answer = answer | 0x80; // if the data port is high, make this bit a 1
-    }
-    return answer;
+    return false;
 }
 
+ 
 bool DS1820::unassignedProbe(PinName pin) {
-    DigitalInOut _pin(pin);
-    ONEWIRE_INIT((&_pin));
-    INIT_DELAY;
-    char ROM_address[8];
-    return search_ROM_routine(&_pin, 0xF0, ROM_address);
+    OneWireGpio bus(pin);
+    return unassignedProbe(&bus);
 }
  
-bool DS1820::unassignedProbe(DigitalInOut *pin, char *ROM_address) {
-    return search_ROM_routine(pin, 0xF0, ROM_address);
+bool DS1820::unassignedProbe(OneWire *bus) {
+    char ROM_address[8];
+    return search_ROM_routine(bus, 0xF0, ROM_address);
 }
  
-bool DS1820::search_ROM_routine(DigitalInOut *pin, char command, char *ROM_address) {
+bool DS1820::search_ROM_routine(OneWire *bus, char command, char *ROM_address) {
     bool DS1820_done_flag = false;
     int DS1820_last_descrepancy = 0;
     char DS1820_search_ROM[8] = {0, 0, 0, 0, 0, 0, 0, 0};
@@ -150,21 +78,17 @@ bool DS1820::search_ROM_routine(DigitalInOut *pin, char command, char *ROM_addre
  
     return_value=false;
     while (!DS1820_done_flag) {
-        if (!onewire_reset(pin)) {
+        if (!bus->reset()) {
             return false;
         } else {
             ROM_bit_index=1;
             descrepancy_marker=0;
-            char command_shift = command;
-            for (int n=0; n<8; n++) {           // Search ROM command or Search Alarm command
-                onewire_bit_out(pin, command_shift & 0x01);
-                command_shift = command_shift >> 1; // now the next bit is in the least sig bit position.
-            } 
+            bus->byteOut(command);              // Search ROM command or Search Alarm command
             byte_counter = 0;
             bit_mask = 0x01;
             while (ROM_bit_index<=64) {
-                Bit_A = onewire_bit_in(pin);
-                Bit_B = onewire_bit_in(pin);
+                Bit_A = bus->bitIn();
+                Bit_B = bus->bitIn();
                 if (Bit_A & Bit_B) {
                     descrepancy_marker = 0; // data read error, this should never happen
                     ROM_bit_index = 0xFF;
@@ -190,7 +114,7 @@ bool DS1820::search_ROM_routine(DigitalInOut *pin, char command, char *ROM_addre
                             }
                         }
                     }
-                    onewire_bit_out (pin, DS1820_search_ROM[byte_counter] & bit_mask);
+                    bus->bitOut(DS1820_search_ROM[byte_counter] & bit_mask);
                     ROM_bit_index++;
                     if (bit_mask & 0x80) {
                         byte_counter++;
@@ -201,33 +125,13 @@ bool DS1820::search_ROM_routine(DigitalInOut *pin, char command, char *ROM_addre
                 }
             }
             DS1820_last_descrepancy = descrepancy_marker;
-            if (ROM_bit_index != 0xFF) {
-                int i = 1;
-                node *list_container;
-                while(1) {
-                    list_container = probes.pop(i);
-                    if (list_container == NULL) {                             //End of list, or empty list
-                        if (ROM_checksum_error(DS1820_search_ROM)) {          // Check the CRC
-                            return false;
-                        }
-                        for(byte_counter=0;byte_counter<8;byte_counter++)
-                            ROM_address[byte_counter] = DS1820_search_ROM[byte_counter];
-                        return true;
-                    } else {                    //Otherwise, check if ROM is already known
-                        bool equal = true;
-                        DS1820 *pointer = (DS1820*) list_container->data;
-                        char *ROM_compare = pointer->_ROM;
-                        
-                        for(byte_counter=0;byte_counter<8;byte_counter++) {
-                            if ( ROM_compare[byte_counter] != DS1820_search_ROM[byte_counter])
-                                equal = false;
-                        }
-                        if (equal)
-                            break;
-                        else
-                            i++;
-                    }
-                }                        
+            if (ROM_bit_index != 0xFF && !known_ROM(DS1820_search_ROM)) {
+                if (ROM_checksum_error(DS1820_search_ROM)) {          // Check the CRC
+                    return false;
+                }
+                for(byte_counter=0;byte_counter<8;byte_counter++)
+                    ROM_address[byte_counter] = DS1820_search_ROM[byte_counter];
+                return true;
             }
         }
         if (DS1820_last_descrepancy == 0)
@@ -239,16 +143,16 @@ bool DS1820::search_ROM_routine(DigitalInOut *pin, char command, char *ROM_addre
 void DS1820::match_ROM() {
 // Used to select a specific device
     int i;
-    onewire_reset(&this->_datapin);
-    onewire_byte_out( 0x55);  //Match ROM command
+    _bus->reset();
+    _bus->byteOut(0x55);  //Match ROM command
     for (i=0;i<8;i++) {
-        onewire_byte_out(_ROM[i]);
+        _bus->byteOut(_ROM[i]);
     }
 }
  
 void DS1820::skip_ROM() {
-    onewire_reset(&this->_datapin);
-    onewire_byte_out(0xCC);   // Skip ROM command
+    _bus->reset();
+    _bus->byteOut(0xCC);   // Skip ROM command
 }
  
 bool DS1820::ROM_checksum_error(char *_ROM_address) {
@@ -257,7 +161,11 @@ bool DS1820::ROM_checksum_error(char *_ROM_address) {
     for(i=0;i<7;i++) // Only going to shift the lower 7 bytes
         _CRC = CRC_byte(_CRC, _ROM_address[i]);
     // After 7 bytes CRC should equal the 8th byte (ROM CRC)
-    return (_CRC!=_ROM_address[7]); // will return true if there is a CRC checksum mis-match         
+    if (_CRC!=_ROM_address[7]) {
+        METRIC_INC(w1_crc_errors);
+        return true;    // CRC checksum mis-match
+    }
+    return false;
 }
  
 bool DS1820::RAM_checksum_error() {
@@ -266,7 +174,11 @@ bool DS1820::RAM_checksum_error() {
     for(i=0;i<8;i++) // Only going to shift the lower 8 bytes
         _CRC = CRC_byte(_CRC, RAM[i]);
     // After 8 bytes CRC should equal the 9th byte (RAM CRC)
-    return (_CRC!=RAM[8]); // will return true if there is a CRC checksum mis-match        
+    if (_CRC!=RAM[8]) {
+        METRIC_INC(w1_crc_errors);
+        return true;    // CRC checksum mis-match
+    }
+    return false;
 }
  
 char DS1820::CRC_byte (char _CRC, char byte ) {
@@ -301,8 +213,8 @@ char DS1820::CRC_byte (char _CRC, char byte ) {
 return _CRC;
 }
  
-int DS1820::convertTemperature(bool wait, devices device) {
-    // Convert temperature into scratchpad RAM for all devices at once
+int DS1820::begin_conversion(devices device) {
+    // Select the device(s) and issue Convert T, returns the conversion time in ms
     int delay_time = 750; // Default delay time
     char resolution;
     if (device==all_devices)
@@ -320,7 +232,13 @@ int DS1820::convertTemperature(bool wait, devices device) {
         }
     }
     
-    onewire_byte_out( 0x44);  // perform temperature conversion
+    _bus->byteOut(0x44);  // perform temperature conversion
+    return delay_time;
+}
+
+int DS1820::convertTemperature(bool wait, devices device) {
+    // Convert temperature into scratchpad RAM for all devices at once
+    int delay_time = begin_conversion(device);
     if (_parasite_power) {
         if (_power_mosfet) {
             _parasitepin = _power_polarity;     // Parasite power strong pullup
@@ -328,10 +246,9 @@ int DS1820::convertTemperature(bool wait, devices device) {
             _parasitepin = !_power_polarity;
             delay_time = 0;
         } else {
-            _datapin.output();
-            _datapin.write(1);
+            _bus->strongPullup(true);
             wait_ms(delay_time);
-            _datapin.input();
+            _bus->strongPullup(false);
         }
     } else {
         if (wait) {
@@ -341,21 +258,61 @@ int DS1820::convertTemperature(bool wait, devices device) {
     }
     return delay_time;
 }
+
+int DS1820::startConversion(devices device) {
+    int delay_time = begin_conversion(device);
+    _conv_state = conv_busy;
+    if (_parasite_power) {
+        // The strong pullup has to stay on for the whole conversion, a
+        // Timeout releases it and marks the result ready.
+        if (_power_mosfet)
+            _parasitepin = _power_polarity;
+        else
+            _bus->strongPullup(true);
+        _conv_timeout.attach_us(callback(this, &DS1820::conversion_timeout), delay_time * 1000);
+    }
+    return delay_time;
+}
+
+void DS1820::conversion_timeout() {
+    if (_power_mosfet)
+        _parasitepin = !_power_polarity;
+    else
+        _bus->strongPullup(false);
+    _conv_state = conv_ready;
+}
+
+DS1820::conv_state DS1820::conversionState() {
+    // Externally powered devices answer read time slots with 0 while converting
+    if (_conv_state == conv_busy && !_parasite_power && _bus->bitIn())
+        _conv_state = conv_ready;
+    return _conv_state;
+}
  
 void DS1820::read_RAM() {
     // This will copy the DS1820's 9 bytes of RAM data
     // into the objects RAM array. Functions that use
     // RAM values will automaticly call this procedure.
     int i;
+    if (_conv_state == conv_ready)
+        _conv_state = conv_idle;
     match_ROM();             // Select this device
-    onewire_byte_out( 0xBE);   //Read Scratchpad command
+    _bus->byteOut(0xBE);   //Read Scratchpad command
     for(i=0;i<9;i++) {
-        RAM[i] = onewire_byte_in();
+        RAM[i] = _bus->byteIn();
     }
 //    if (!RAM_checksum_error())
 //       crcerr = 1;
 }
 
+bool DS1820::verify() {
+    if (ROM_checksum_error(_ROM) || !_bus->reset())
+        return false;
+    read_RAM();
+    // an absent device leaves the bus high, all ones fail the CRC
+    return !RAM_checksum_error();
+}
+
 bool DS1820::setResolution(unsigned int resolution) {
     bool answer = false;
     resolution = resolution - 9;
@@ -373,46 +330,49 @@ void DS1820::write_scratchpad(int data) {
     RAM[3] = data;
     RAM[2] = data>>8;
     match_ROM();
-    onewire_byte_out(0x4E);   // Copy scratchpad into DS1820 ram memory
-    onewire_byte_out(RAM[2]); // T(H)
-    onewire_byte_out(RAM[3]); // T(L)
+    _bus->byteOut(0x4E);   // Copy scratchpad into DS1820 ram memory
+    _bus->byteOut(RAM[2]); // T(H)
+    _bus->byteOut(RAM[3]); // T(L)
     if ((FAMILY_CODE == FAMILY_CODE_DS18B20 ) || (FAMILY_CODE == FAMILY_CODE_DS1822 )) {
-        onewire_byte_out(RAM[4]); // Configuration register
+        _bus->byteOut(RAM[4]); // Configuration register
     }
 }
  
 float DS1820::temperature(char scale) {
-// The data specs state that count_per_degree should be 0x10 (16), I found my devices
-// to have a count_per_degree of 0x4B (75). With the standard resolution of 1/2 deg C
-// this allowed an expanded resolution of 1/150th of a deg C. I wouldn't rely on this
-// being super acurate, but it does allow for a smooth display in the 1/10ths of a
-// deg C or F scales.
-    float answer, remaining_count, count_per_degree;
-    int reading;
-    read_RAM();
-    if (RAM_checksum_error())
+    float answer;
+    int reading = temperature_raw();
+    if (reading == invalid_conversion)
         // Indicate we got a CRC error
         answer = invalid_conversion;
     else {
-        reading = (RAM[1] << 8) + RAM[0];
-        if (reading & 0x8000) { // negative degrees C
-            reading = 0-((reading ^ 0xffff) + 1); // 2's comp then convert to signed int
-        }
-        answer = reading +0.0; // convert to floating point
-        if ((FAMILY_CODE == FAMILY_CODE_DS18B20 ) || (FAMILY_CODE == FAMILY_CODE_DS1822 )) {
-            answer = answer / 16.0f;
-        }
-        else {
-            remaining_count = RAM[6];
-            count_per_degree = RAM[7];
-            answer = floor(answer/2.0f) - 0.25f + (count_per_degree - remaining_count) / count_per_degree;
-        }
+        answer = reading / 16.0f;
         if (scale=='F' or scale=='f')
             // Convert to deg F
             answer = answer * 9.0f / 5.0f + 32.0f;
     }
     return answer;
 }
+
+int DS1820::temperature_raw() {
+// The data specs state that count_per_degree should be 0x10 (16), I found my devices
+// to have a count_per_degree of 0x4B (75). With the standard resolution of 1/2 deg C
+// the DS1820 counts are expanded to the 1/16 deg C steps of the DS18B20, so both
+// families return the same units.
+    int reading, remaining_count, count_per_degree;
+    read_RAM();
+    if (RAM_checksum_error())
+        return invalid_conversion;
+    reading = (int16_t)((RAM[1] << 8) + RAM[0]);    // sign extend the 2's complement value
+    if ((FAMILY_CODE != FAMILY_CODE_DS18B20 ) && (FAMILY_CODE != FAMILY_CODE_DS1822 )) {
+        remaining_count = RAM[6];
+        count_per_degree = RAM[7];
+        if (count_per_degree == 0)
+            return invalid_conversion;
+        // floor(reading/2) - 0.25 + (count_per_degree - remaining_count) / count_per_degree
+        reading = (reading >> 1) * 16 - 4 + ((count_per_degree - remaining_count) * 16) / count_per_degree;
+    }
+    return reading;
+}
  
 bool DS1820::read_power_supply(devices device) {
 // This will return true if the device (or all devices) are Vcc powered
@@ -421,8 +381,8 @@ bool DS1820::read_power_supply(devices device) {
         skip_ROM();          // Skip ROM command, will poll for any device using parasite power
     else
         match_ROM();
-    onewire_byte_out(0xB4);   // Read power supply command
-    return onewire_bit_in(&this->_datapin);
+    _bus->byteOut(0xB4);   // Read power supply command
+    return _bus->bitIn();
 }
 
 
@@ -24,7 +24,11 @@
 #define MBED_DS1820_H
 
 #include "mbed.h"
-#include "LinkedList.h"
+#include "OneWire.h"
+
+#ifndef DS1820_MAX_PROBES
+#define DS1820_MAX_PROBES 32    // size of the static probe registry
+#endif
 
 #define FAMILY_CODE _ROM[0]
 #define FAMILY_CODE_DS1820 0x10
@@ -38,7 +42,8 @@
  * #include "mbed.h"
  * #include "DS1820.h"
  *
- * DS1820 probe(DATA_PIN);
+ * OneWireGpio bus(DATA_PIN);
+ * DS1820 probe(&bus);
  *  
  * int main() {
  *     while(1) {
@@ -59,19 +64,36 @@ public:
         invalid_conversion = -1000
     };
 
-    /** Create a probe object connected to the specified pins
-    *
+    enum conv_state {
+        conv_idle,       // no conversion started, or the result was read
+        conv_busy,       // Convert T issued, not finished yet
+        conv_ready };    // conversion finished, scratchpad holds the new reading
+
+    /** Create a probe object on a 1-Wire bus, OneWireGpio on a pin or another
+     * transport (see OneWireUart.h), that may be shared with other probes
+     *
     * The probe might either by regular powered or parasite powered. If it is parasite
     * powered and power_pin is set, that pin will be used to switch an external mosfet connecting
     * data to Vdd. If it is parasite powered and the pin is not set, the regular data pin
     * is used to supply extra power when required. This will be sufficient as long as the 
     * number of probes is limitted.
      *
-     * @param data_pin DigitalInOut pin for the data bus
+     * @param bus the 1-Wire transport, must outlive the probe
+     * @param power_pin DigitalOut (optional) pin to control the power MOSFET
+     * @param power_polarity bool (optional) which sets active state (0 for active low (default), 1 for active high)
+     */
+    DS1820(OneWire *bus, PinName power_pin = NC, bool power_polarity = 0);
+
+    /** Create a probe object for a known ROM id, without searching the bus,
+     * e.g. from a table saved at an earlier boot. Call verify() to find out
+     * whether the probe is really there.
+     *
+     * @param bus the 1-Wire transport, must outlive the probe
+     * @param ROM_address the 8 byte ROM id, family code first
      * @param power_pin DigitalOut (optional) pin to control the power MOSFET
      * @param power_polarity bool (optional) which sets active state (0 for active low (default), 1 for active high)
      */
-    DS1820(PinName data_pin, PinName power_pin = NC, bool power_polarity = 0); // Constructor with parasite power pin
+    DS1820(OneWire *bus, const char *ROM_address, PinName power_pin = NC, bool power_polarity = 0);
     ~DS1820();
 
     /** Function to see if there are DS1820 devices left on a pin which do not have a corresponding DS1820 object
@@ -80,6 +102,12 @@ public:
       */
     static bool unassignedProbe(PinName pin);
 
+    /** Same as above, for a probe on a OneWire transport
+    *
+    * @return - true if there are one or more unassigned devices, otherwise false
+      */
+    static bool unassignedProbe(OneWire *bus);
+
     /** This routine will initiate the temperature conversion within
       * one or all DS1820 probes. 
       *
@@ -91,6 +119,25 @@ public:
       */
     int convertTemperature(bool wait, devices device=all_devices);
 
+    /** Non-blocking version of convertTemperature(). Issues Convert T and
+      * returns immediately, conversionState() tells when the result is there.
+      * With parasite power the strong pullup is released by a Timeout.
+      *
+      * @param device allows the function to apply to a specific device or
+      * to all devices on the 1-Wire bus.
+      * @returns milliseconds untill conversion will complete.
+      */
+    int startConversion(devices device=all_devices);
+
+    /** Poll the conversion started by startConversion(). Externally powered
+      * probes are asked with a single read time slot (about 60 us), so this
+      * is cheap enough to call from every tick. Reading the temperature
+      * returns the state to conv_idle.
+      *
+      * @returns conv_idle, conv_busy or conv_ready
+      */
+    conv_state conversionState();
+
     /** This function will return the probe temperature. Approximately 10ms per
       * probe to read its RAM, do CRC check and convert temperature on the LPC1768.
       *
@@ -99,6 +146,13 @@ public:
       */
     float temperature(char scale='c');
 
+    /** This function will return the probe temperature as raw counts, without
+      * any floating point math. Same RAM read and CRC check as temperature().
+      *
+      * @returns temperature in 1/16 degree C, or DS1820::invalid_conversion (-1000) if CRC error detected.
+      */
+    int temperature_raw();
+
     /** This function sets the temperature resolution for the DS18B20
       * in the configuration register.
       *
@@ -107,34 +161,55 @@ public:
       */ 
     bool setResolution(unsigned int resolution);       
 
+    /** Check that this probe answers on the bus: one match-ROM scratchpad
+      * read with CRC check, about 10 ms instead of a Search ROM of the bus.
+      *
+      * @returns true if the probe answered with a valid scratchpad
+      */
+    bool verify();
+
+    /** Function to see if a ROM id already has a DS1820 object
+      *
+      * @param ROM_address the 8 byte ROM id
+      * @returns true if a probe object with this id exists
+      */
+    static bool known_ROM(const char *ROM_address);
+
+    /** The 64 bit ROM id of this probe, family code first
+      *
+      * @returns pointer to the 8 ROM bytes
+      */
+    const char *rom() const { return _ROM; }
+
 private:
     bool _parasite_power;
     bool _power_mosfet;
     bool _power_polarity;
     
+    void init(PinName power_pin, const char *ROM_address);
     static char CRC_byte(char _CRC, char byte );
-    static bool onewire_reset(DigitalInOut *pin);
     void match_ROM();
     void skip_ROM();
-    static bool search_ROM_routine(DigitalInOut *pin, char command, char *ROM_address);
-    static void onewire_bit_out (DigitalInOut *pin, bool bit_data);
-    void onewire_byte_out(char data);
-    static bool onewire_bit_in(DigitalInOut *pin);
-    char onewire_byte_in();
+    static bool search_ROM_routine(OneWire *bus, char command, char *ROM_address);
     static bool ROM_checksum_error(char *_ROM_address);
     bool RAM_checksum_error();
     void read_RAM();
-    static bool unassignedProbe(DigitalInOut *pin, char *ROM_address);
     void write_scratchpad(int data);
+    int begin_conversion(devices device);
+    void conversion_timeout();
     bool read_power_supply(devices device=this_device);
 
-    DigitalInOut _datapin;
+    OneWire *_bus;
     DigitalOut _parasitepin;
+    Timeout _conv_timeout;
+    volatile conv_state _conv_state;
     
     char _ROM[8];
     char RAM[9];
-    
-    static LinkedList<node> probes;
+
+
+    static DS1820 *probes[DS1820_MAX_PROBES];
+    static int probe_count;
 };
 
 
@@ -0,0 +1,78 @@
+/// @file FixedPoint.h integer sensor arithmetic for the gauge
+///
+/// The STM32F103 has no FPU, so every float operation is a soft-float
+/// library call. The sample path therefore stays in integers:
+/// \li temperature is carried as raw DS18B20 counts of 1/16 degree C
+/// \li pressure is carried as the raw 16 bit ADC reading (AnalogIn::read_u16)
+/// \li calibration is a Q16 linear transfer function
+/// \li conversion to milli-units and to text happens only at output time
+///
+/// This file has no mbed dependency so the host tools can share it.
+///
+#ifndef FIXEDPOINT_H
+#define FIXEDPOINT_H
+
+#include <stdint.h>
+
+/// Linear calibration: milli = offset + raw * gain / 65536
+///
+/// gain is therefore the reading in milli-units that a full scale (65536)
+/// raw value would give. The default {0, 1000} reproduces AnalogIn::read()
+/// (0.000 .. 1.000) printed with 3 decimals.
+typedef struct {
+    int32_t offset;         ///< milli-units at raw == 0
+    int32_t gain;           ///< milli-units per 65536 raw counts
+} LINCAL_T;
+
+#define LINCAL_DEFAULT { 0, 1000 }
+
+/// Apply a calibration to a raw 16 bit reading
+///
+/// @param cal is the calibration
+/// @param raw is the reading, e.g. from AnalogIn::read_u16()
+/// @returns the calibrated value in milli-units
+static inline int32_t fx_calibrate(const LINCAL_T *cal, uint16_t raw)
+{
+    return cal->offset + (int32_t)(((int64_t)raw * cal->gain + 0x8000) >> 16);
+}
+
+/// Convert 1/16 degree counts to milli-degrees
+///
+/// @param t16 is the temperature in 1/16 degree C
+/// @returns the temperature in milli-degrees C (exact, 1/16 = 62.5 m, rounded)
+static inline int32_t fx_t16_to_milli(int32_t t16)
+{
+    int32_t m = t16 * 125;          // t16 * 1000 / 16 == t16 * 125 / 2
+    return (m >= 0) ? (m + 1) / 2 : -((1 - m) / 2);
+}
+
+/// Format a milli-unit value as text with three decimals (same as "%.3f")
+///
+/// @param buf receives the text, at least 13 bytes
+/// @param v is the value in milli-units
+/// @returns buf
+static inline char *fx_format_milli(char *buf, int32_t v)
+{
+    char tmp[12];
+    char *p = buf;
+    uint32_t u;
+    int n = 0;
+
+    if (v < 0) {
+        *p++ = '-';
+        u = (uint32_t)0 - (uint32_t)v;
+    } else
+        u = (uint32_t)v;
+    do {                            // at least "0.000"
+        tmp[n++] = '0' + u % 10;
+        u /= 10;
+        if (n == 3)
+            tmp[n++] = '.';
+    } while (u || n < 5);
+    while (n)
+        *p++ = tmp[--n];
+    *p = '\0';
+    return buf;
+}
+
+#endif // FIXEDPOINT_H
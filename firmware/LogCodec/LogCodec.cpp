@@ -0,0 +1,149 @@
+/// @file LogCodec.cpp compressed block encoding for the on-card sample log
+///
+/// See LogCodec.h for the block layout.
+///
+#include <string.h>
+#include "LogCodec.h"
+
+#define MAGIC0  'G'
+#define MAGIC1  'L'
+
+static inline uint32_t zigzag(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+bool LogCodec_IsBlock(const uint8_t *buf, size_t len)
+{
+    return len >= LOGCODEC_HEADER_SIZE
+           && buf[0] == MAGIC0 && buf[1] == MAGIC1
+           && buf[2] == LOGCODEC_VERSION;
+}
+
+LogEncoder::LogEncoder(uint8_t *block) : _block(block)
+{
+    reset();
+}
+
+void LogEncoder::attach(uint8_t *block)
+{
+    _block = block;
+    reset();
+}
+
+void LogEncoder::reset()
+{
+    _count = 0;
+    _pos = LOGCODEC_HEADER_SIZE;
+    _prev_delta = 0;
+    if (_block == NULL)
+        return;
+    memset(_block, 0, LOGCODEC_BLOCK_SIZE);
+    _block[0] = MAGIC0;
+    _block[1] = MAGIC1;
+    _block[2] = LOGCODEC_VERSION;
+}
+
+void LogEncoder::put_varint(uint32_t v)
+{
+    while (v >= 0x80) {
+        _block[_pos++] = (v & 0x7F) | 0x80;
+        v >>= 7;
+    }
+    _block[_pos++] = v;
+}
+
+bool LogEncoder::add(const LogSample &s)
+{
+    if (_count == 0) {
+        put_varint(s.ms);
+        put_varint(zigzag(s.temp));
+        put_varint(zigzag(s.pres));
+    } else {
+        int32_t delta = (int32_t)(s.ms - _prev.ms);
+        if (_count == 1)
+            put_varint(zigzag(delta));
+        else
+            put_varint(zigzag(delta - _prev_delta));
+        _prev_delta = delta;
+        put_varint(zigzag(s.temp - _prev.temp));
+        put_varint(zigzag(s.pres - _prev.pres));
+    }
+    _prev = s;
+    _count++;
+    put_u16(&_block[4], _count);
+    put_u16(&_block[6], _pos - LOGCODEC_HEADER_SIZE);
+    return LOGCODEC_BLOCK_SIZE - _pos < LOGCODEC_MAX_SAMPLE;
+}
+
+LogDecoder::LogDecoder(const uint8_t *block) : _block(block)
+{
+    _valid = LogCodec_IsBlock(block, LOGCODEC_BLOCK_SIZE);
+    _count = _valid ? get_u16(&block[4]) : 0;
+    _end = _valid ? LOGCODEC_HEADER_SIZE + get_u16(&block[6]) : 0;
+    if (_end > LOGCODEC_BLOCK_SIZE) {
+        _valid = false;
+        _count = 0;
+    }
+    _index = 0;
+    _pos = LOGCODEC_HEADER_SIZE;
+    _prev_delta = 0;
+}
+
+bool LogDecoder::get_varint(uint32_t &v)
+{
+    int shift = 0;
+    v = 0;
+    while (_pos < _end && shift < 35) {
+        uint8_t b = _block[_pos++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+        shift += 7;
+    }
+    return false;
+}
+
+bool LogDecoder::next(LogSample &s)
+{
+    uint32_t a, b, c;
+
+    if (_index >= _count)
+        return false;
+    if (!get_varint(a) || !get_varint(b) || !get_varint(c)) {
+        _count = _index;        // corrupt payload, stop here
+        return false;
+    }
+    if (_index == 0) {
+        s.ms = a;
+        s.temp = unzigzag(b);
+        s.pres = unzigzag(c);
+    } else {
+        int32_t delta = unzigzag(a);
+        if (_index > 1)
+            delta += _prev_delta;
+        _prev_delta = delta;
+        s.ms = _prev.ms + delta;
+        s.temp = _prev.temp + unzigzag(b);
+        s.pres = _prev.pres + unzigzag(c);
+    }
+    _prev = s;
+    _index++;
+    return true;
+}
@@ -0,0 +1,156 @@
+/// @file LogCodec.h compressed block encoding for the on-card sample log
+///
+/// The log is written as a sequence of 512-byte blocks, one per SD sector.
+/// Every block starts from scratch, so any sector of the file can be decoded
+/// on its own - a damaged sector only loses the samples it holds.
+///
+/// Block layout (all multi-byte fields little endian):
+/// @verbatim
+/// offset  size  field
+///   0      2    magic 'G','L'
+///   2      1    version (LOGCODEC_VERSION)
+///   3      1    flags (reserved, 0)
+///   4      2    number of samples in the block
+///   6      2    number of payload bytes used
+///   8    504    payload, zero filled after the last sample
+/// @endverbatim
+///
+/// Sample encoding inside the payload:
+/// \li sample 0: varint(ms), zigzag(temp), zigzag(pres)
+/// \li sample 1: zigzag(ms delta), zigzag(temp delta), zigzag(pres delta)
+/// \li sample n: zigzag(ms delta-of-delta), zigzag(temp delta), zigzag(pres delta)
+///
+/// Temperature and pressure are carried as integers in milli-units, which is
+/// exactly the resolution printed to the CSV log (%.3f).
+///
+/// This file has no mbed dependency so the host tools can share it.
+///
+#ifndef LOGCODEC_H
+#define LOGCODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOGCODEC_BLOCK_SIZE     512     ///< one SD sector
+#define LOGCODEC_HEADER_SIZE    8
+#define LOGCODEC_VERSION        1
+#define LOGCODEC_MAX_SAMPLE     15      ///< worst case: three 5 byte varints
+
+/// One logged sample
+struct LogSample {
+    uint32_t ms;        ///< timestamp, milliseconds
+    int32_t  temp;      ///< temperature, milli-degrees C
+    int32_t  pres;      ///< pressure, milli-units of the calibrated reading
+};
+
+/// Builds one compressed block in RAM
+///
+/// The block is built in memory the caller provides, so the logger can
+/// take it from a shared pool only while it logs compressed.
+///
+/// example:
+/// @code
+/// uint8_t block[LOGCODEC_BLOCK_SIZE];
+/// LogEncoder enc(block);
+/// ...
+/// if (enc.add(sample)) {          // block is full
+///     fwrite(enc.data(), 1, LOGCODEC_BLOCK_SIZE, fp);
+///     enc.reset();
+/// }
+/// @endcode
+class LogEncoder {
+public:
+    /// @param block is the LOGCODEC_BLOCK_SIZE bytes to build the block in,
+    ///        NULL to attach() them later
+    LogEncoder(uint8_t *block = NULL);
+
+    /// Build the blocks in other memory, starting a new, empty block
+    ///
+    /// @param block is LOGCODEC_BLOCK_SIZE bytes, or NULL to detach; nothing
+    ///        may be added while detached
+    void attach(uint8_t *block);
+
+    /// Start a new, empty block
+    void reset();
+
+    /// Append a sample to the block
+    ///
+    /// There is always room for at least one more sample when this is called.
+    ///
+    /// @param s is the sample to add
+    /// @returns true if the block is now full and has to be written out and reset
+    bool add(const LogSample &s);
+
+    /// @returns true if no samples have been added since the last reset
+    bool empty() const {
+        return _count == 0;
+    }
+
+    /// @returns number of samples in the block
+    uint16_t count() const {
+        return _count;
+    }
+
+    /// @returns the block, always LOGCODEC_BLOCK_SIZE bytes, valid at any time
+    ///          while attached
+    const uint8_t *data() const {
+        return _block;
+    }
+
+private:
+    void put_varint(uint32_t v);
+
+    uint8_t *_block;
+    uint16_t _count;
+    uint16_t _pos;
+    LogSample _prev;
+    int32_t  _prev_delta;
+};
+
+/// Walks the samples of one block
+///
+/// example:
+/// @code
+/// LogDecoder dec(sector);
+/// LogSample s;
+/// while (dec.next(s))
+///     printf("%u\n", s.ms);
+/// @endcode
+class LogDecoder {
+public:
+    /// @param block points to LOGCODEC_BLOCK_SIZE bytes
+    LogDecoder(const uint8_t *block);
+
+    /// @returns true if the block header is valid
+    bool valid() const {
+        return _valid;
+    }
+
+    /// @returns number of samples the header claims
+    uint16_t count() const {
+        return _count;
+    }
+
+    /// Decode the next sample
+    ///
+    /// @param s receives the sample
+    /// @returns false at the end of the block or on a corrupt payload
+    bool next(LogSample &s);
+
+private:
+    bool get_varint(uint32_t &v);
+
+    const uint8_t *_block;
+    bool     _valid;
+    uint16_t _count;
+    uint16_t _index;
+    uint16_t _pos;
+    uint16_t _end;
+    LogSample _prev;
+    int32_t  _prev_delta;
+};
+
+/// @returns true if the buffer starts with a LogCodec block header
+bool LogCodec_IsBlock(const uint8_t *buf, size_t len);
+
+#endif // LOGCODEC_H
@@ -0,0 +1,192 @@
+/// @file MemStats.cpp heap and stack usage
+///
+#include <string.h>
+#include "mbed.h"
+#include "MemStats.h"
+
+#define PAINT           0xC5C5C5C5UL
+#define PAINT_GAP       64          // left alone below the stack pointer, MemStats_Paint() runs there
+
+#if defined(TARGET_HOST)
+
+#define HOST_STACK      0x10000     // painted below the caller of MemStats_Paint()
+
+static uintptr_t top;
+
+static inline uintptr_t stackTop(void)
+{
+    return top;
+}
+
+static inline uintptr_t heapEnd(void)
+{
+    return top - HOST_STACK;
+}
+
+static inline uintptr_t stackPointer(void)
+{
+    return (uintptr_t)__builtin_frame_address(0);
+}
+
+void mbed_stats_heap_get(mbed_stats_heap_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+#else
+
+#include <malloc.h>
+#include <reent.h>
+
+extern uint32_t __end__[], __StackTop[];    // the linker script's
+extern "C" void *sbrk(ptrdiff_t incr);      // not from unistd.h, its sleep() is not mbed's
+
+static inline uintptr_t stackTop(void)
+{
+    return (uintptr_t)__StackTop;
+}
+
+static inline uintptr_t heapEnd(void)
+{
+    return (uintptr_t)sbrk(0);
+}
+
+static inline uintptr_t stackPointer(void)
+{
+    return __get_MSP();
+}
+
+static mbed_stats_heap_t heap;
+static bool nested;                 // inside realloc, calloc or memalign, their own mallocs are not counted
+
+extern "C" {
+
+void *__real__malloc_r(struct _reent *r, size_t size);
+void __real__free_r(struct _reent *r, void *ptr);
+void *__real__realloc_r(struct _reent *r, void *ptr, size_t size);
+void *__real__memalign_r(struct _reent *r, size_t alignment, size_t bytes);
+void *__real__calloc_r(struct _reent *r, size_t nmemb, size_t size);
+
+// the sizes are the blocks' usable sizes, what the allocator really gave
+static void *counted(struct _reent *r, void *ptr)
+{
+    if (ptr == NULL) {
+        heap.alloc_fail_cnt++;
+        return NULL;
+    }
+    uint32_t n = _malloc_usable_size_r(r, ptr);
+    heap.current_size += n;
+    heap.total_size += n;
+    heap.alloc_cnt++;
+    if (heap.current_size > heap.max_size)
+        heap.max_size = heap.current_size;
+    return ptr;
+}
+
+static void uncounted(struct _reent *r, void *ptr)
+{
+    if (ptr == NULL)
+        return;
+    heap.current_size -= _malloc_usable_size_r(r, ptr);
+    heap.alloc_cnt--;
+}
+
+void *__wrap__malloc_r(struct _reent *r, size_t size)
+{
+    void *ptr = __real__malloc_r(r, size);
+    return nested ? ptr : counted(r, ptr);
+}
+
+void __wrap__free_r(struct _reent *r, void *ptr)
+{
+    if (!nested)
+        uncounted(r, ptr);
+    __real__free_r(r, ptr);
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *ptr, size_t size)
+{
+    uint32_t old = ptr ? _malloc_usable_size_r(r, ptr) : 0;
+    nested = true;
+    void *p = __real__realloc_r(r, ptr, size);
+    nested = false;
+    if (p == NULL && size) {
+        heap.alloc_fail_cnt++;      // the old block stays
+        return NULL;
+    }
+    if (ptr) {
+        heap.current_size -= old;
+        heap.alloc_cnt--;
+    }
+    return p ? counted(r, p) : NULL;
+}
+
+void *__wrap__memalign_r(struct _reent *r, size_t alignment, size_t bytes)
+{
+    nested = true;
+    void *ptr = __real__memalign_r(r, alignment, bytes);
+    nested = false;
+    return counted(r, ptr);
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t nmemb, size_t size)
+{
+    nested = true;
+    void *ptr = __real__calloc_r(r, nmemb, size);
+    nested = false;
+    return counted(r, ptr);
+}
+
+} // extern "C"
+
+void mbed_stats_heap_get(mbed_stats_heap_t *stats)
+{
+    core_util_critical_section_enter();
+    *stats = heap;
+    core_util_critical_section_exit();
+    stats->reserved_size = heapEnd() - (uintptr_t)__end__;
+}
+
+#endif
+
+static uint32_t *painted;           // lowest painted word
+static volatile uintptr_t isrlow;   // lowest stack pointer an interrupt handler came in on
+
+static uint32_t *aligned(uintptr_t a)
+{
+    return (uint32_t *)((a + 3) & ~(uintptr_t)3);
+}
+
+void MemStats_Paint(void)
+{
+#if defined(TARGET_HOST)
+    top = stackPointer();
+#endif
+    uint32_t *p = aligned(heapEnd());
+    uint32_t *end = (uint32_t *)(stackPointer() - PAINT_GAP);
+    painted = p;
+    while (p < end)
+        *p++ = PAINT;
+}
+
+void MemStats_IsrMark(void)
+{
+    uintptr_t sp = stackPointer();
+    if (isrlow == 0 || sp < isrlow)
+        isrlow = sp;
+}
+
+// memory the heap has grown into and given back counts as stack used
+void MemStats_Stack(MEMSTATS_STACK_T *s)
+{
+    uintptr_t t = stackTop(), h = heapEnd();
+    const uint32_t *p = aligned(h);
+    if (p < painted)
+        p = painted;
+    while ((uintptr_t)p < t && *p == PAINT)
+        p++;
+    s->size = t - h;
+    s->peak = t - (uintptr_t)p;
+    s->now = t - stackPointer();
+    s->isr = isrlow ? t - isrlow : 0;
+}
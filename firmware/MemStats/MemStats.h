@@ -0,0 +1,60 @@
+/// @file MemStats.h heap and stack usage
+///
+/// The heap: mbed_stats_heap_get() of mbed/platform/mbed_stats.h reports
+/// it, but libmbed is built without MBED_HEAP_STATS_ENABLED, its allocator
+/// wrappers only pass the calls on. The firmware links with --wrap for
+/// _malloc_r and the rest of newlib's allocator, so MemStats supplies the
+/// wrappers itself, with the accounting, and mbed_stats_heap_get() next to
+/// them; the library's do not get linked. The firmware takes nothing from
+/// the heap itself, what the statistics show is newlib's own: FILE
+/// structures, number conversion.
+///
+/// The stack: main and the interrupt handlers share the one MSP stack at
+/// the top of RAM, it grows down towards the heap. MemStats_Paint() fills
+/// the space between the heap and the stack pointer with a pattern at
+/// boot, the deepest the stack has been is where the pattern ends.
+/// Interrupt handlers call MemStats_IsrMark() on entry, it keeps the
+/// deepest stack an interrupt came in on: the task level's share of the
+/// high-water mark, the handlers' own frames go on top of it.
+///
+/// In the host build the heap is the Linux process's and is not counted,
+/// the stack is painted below the caller of MemStats_Paint().
+///
+/// example:
+/// @code
+/// int main()
+/// {
+///     MemStats_Paint();
+///     ...
+///     MEMSTATS_STACK_T s;
+///     MemStats_Stack(&s);
+///     printf("stack %lu of %lu\r\n", s.peak, s.size);
+/// }
+/// @endcode
+///
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <stdint.h>
+#include "platform/mbed_stats.h"
+
+/// The stack, in bytes below its top
+typedef struct {
+    uint32_t size;          ///< room from the top down to the heap
+    uint32_t peak;          ///< deepest since MemStats_Paint()
+    uint32_t now;           ///< in use by the caller
+    uint32_t isr;           ///< deepest an interrupt handler was entered at, 0 if none was
+} MEMSTATS_STACK_T;
+
+/// Paint the free stack, first thing in main()
+void MemStats_Paint(void);
+
+/// Note the stack depth, first thing in an interrupt handler
+void MemStats_IsrMark(void);
+
+/// Measure the stack
+///
+/// @param s receives the sizes
+void MemStats_Stack(MEMSTATS_STACK_T *s);
+
+#endif // MEMSTATS_H
@@ -0,0 +1,38 @@
+/// @file Metrics.cpp counters and gauges of the whole firmware in one table
+///
+#include "Metrics.h"
+
+volatile uint32_t metrics[METRIC_COUNT];
+
+#define METRIC_NAME(m) #m,
+static const char *const names[METRIC_COUNT] = {
+    METRICS(METRIC_NAME, METRIC_NAME)
+};
+#undef METRIC_NAME
+
+#define METRIC_COUNTER(m) false,
+#define METRIC_GAUGE(m) true,
+static const bool gauge[METRIC_COUNT] = {
+    METRICS(METRIC_COUNTER, METRIC_GAUGE)
+};
+#undef METRIC_COUNTER
+#undef METRIC_GAUGE
+
+const char *Metric_Name(int id)
+{
+    return names[id];
+}
+
+bool Metric_IsGauge(int id)
+{
+    return gauge[id];
+}
+
+// each counter is cleared on its own, an interrupt may count in between
+void Metrics_Reset(void)
+{
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        if (!gauge[i])
+            metrics[i] = 0;
+    }
+}
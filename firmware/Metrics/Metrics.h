@@ -0,0 +1,83 @@
+/// @file Metrics.h counters and gauges of the whole firmware in one table
+///
+/// Each subsystem counts what goes wrong, or right, where it happens:
+/// METRIC_INC() and METRIC_ADD() add to a counter, METRIC_SET() sets a
+/// gauge. The metrics are listed once in METRICS, the list order is the
+/// order the Stats command and the log's status records show them in, so
+/// new ones go at the end of their group and the names stay as they are:
+/// host tools read them by name.
+///
+/// Counters only grow, from power up or the last Metrics_Reset(), and
+/// wrap at 2^32. Gauges hold the latest value their owner set, 0 until it
+/// does, a reset leaves them alone. Updates are single atomic operations,
+/// safe from interrupt handlers.
+///
+/// example:
+/// @code
+/// void onSerialRx()
+/// {
+///     if (rxbuf.full())
+///         METRIC_INC(rx_overruns);
+///     ...
+/// }
+/// for (int i = 0; i < METRIC_COUNT; i++)
+///     printf("%s=%lu\r\n", Metric_Name(i), Metric_Read(i));
+/// @endcode
+///
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+/// The metrics, C(name) for a counter, G(name) for a gauge
+#define METRICS(C, G) \
+    C(samples)          /* samples taken                                     */ \
+    C(samples_bad)      /* samples not logged: no reading in time, bad range */ \
+    C(ticks_skipped)    /* sample triggers lost, no sample at all            */ \
+    C(records)          /* samples written or batched for the log            */ \
+    C(log_bytes)        /* bytes handed to the log file                      */ \
+    C(syncs)            /* log file closes, data and directory on the card   */ \
+    C(log_errors)       /* log writes that failed                            */ \
+    C(sd_retries)       /* card commands and blocks tried again              */ \
+    C(sd_errors)        /* card block reads and writes given up              */ \
+    C(rx_bytes)         /* serial characters received                        */ \
+    C(rx_overruns)      /* serial characters lost, the input queue was full  */ \
+    C(w1_crc_errors)    /* 1-Wire ROM and scratchpad CRC mismatches          */ \
+    C(wdt_near_misses)  /* late heartbeats that caught up before the reset   */ \
+    C(samples_dropped)  /* samples the logger fell too far behind to write   */ \
+    G(uptime_s)         /* seconds since power up, set as the table is read  */ \
+    G(mode)             /* logging mode, 0 idle                              */ \
+    G(interval_ms)      /* sample period of the logging mode                 */ \
+    G(probes)           /* temperature probes on the buses                   */
+
+#define METRIC_ENUM(m) METRIC_##m,
+enum {
+    METRICS(METRIC_ENUM, METRIC_ENUM)
+    METRIC_COUNT
+};
+#undef METRIC_ENUM
+
+extern volatile uint32_t metrics[METRIC_COUNT];
+
+#define METRIC_INC(m)       __sync_fetch_and_add(&metrics[METRIC_##m], 1)
+#define METRIC_ADD(m, n)    __sync_fetch_and_add(&metrics[METRIC_##m], (uint32_t)(n))
+#define METRIC_SET(m, v)    (metrics[METRIC_##m] = (uint32_t)(v))
+
+/// @returns the value of a metric
+///
+/// @param id is a METRIC_ id
+static inline uint32_t Metric_Read(int id)
+{
+    return metrics[id];
+}
+
+/// @returns the name of a metric
+const char *Metric_Name(int id);
+
+/// @returns true for a gauge, false for a counter
+bool Metric_IsGauge(int id);
+
+/// Clear the counters, the gauges keep their values
+void Metrics_Reset(void);
+
+#endif // METRICS_H
@@ -0,0 +1,130 @@
+/// @file OneWire.cpp 1-Wire bus transports for the DS1820 driver
+///
+/// The GPIO slot timing is the one the DS1820 library used to carry.
+///
+#include "OneWire.h"
+#include "Profiler.h"
+
+#ifdef TARGET_STM
+//STM targets use opendrain mode since their switching between input and output is slow
+    #define ONEWIRE_INPUT(pin)  pin->write(1)
+    #define ONEWIRE_OUTPUT(pin) (void)(pin)
+    #define ONEWIRE_INIT(pin)   pin->output(); pin->mode(OpenDrain)
+#else
+    #define ONEWIRE_INPUT(pin)  pin->input()
+    #define ONEWIRE_OUTPUT(pin) pin->output()
+    #define ONEWIRE_INIT(pin)   (void)(pin)
+#endif
+
+#ifdef TARGET_NORDIC
+//NORDIC targets (NRF) use software delays since their ticker uses a 32kHz clock
+    static uint32_t loops_per_us = 0;
+
+    #define INIT_DELAY      init_soft_delay()
+    #define ONEWIRE_DELAY_US(value) for(int cnt = 0; cnt < (value * loops_per_us) >> 5; cnt++) {__NOP(); __NOP(); __NOP();}
+
+static void init_soft_delay( void ) {
+    if (loops_per_us == 0) {
+        loops_per_us = 1;
+        Timer timey;
+        timey.start();
+        ONEWIRE_DELAY_US(320000);
+        timey.stop();
+        loops_per_us = (320000 + timey.read_us() / 2) / timey.read_us();
+    }
+}
+#else
+    #define INIT_DELAY
+    #define ONEWIRE_DELAY_US(value) wait_us(value)
+#endif
+
+void OneWire::byteOut(char data)
+{
+    PROF_ZONE(ow_byte);
+    for (int n = 0; n < 8; n++) {
+        bitOut(data & 0x01);
+        data = data >> 1;       // now the next bit is in the least sig bit position.
+    }
+}
+
+char OneWire::byteIn()
+{
+    PROF_ZONE(ow_byte);
+    char answer = 0x00;
+    for (int i = 0; i < 8; i++) {
+        answer = answer >> 1;   // shift over to make room for the next bit
+        if (bitIn())
+            answer = answer | 0x80;
+    }
+    return answer;
+}
+
+OneWireGpio::OneWireGpio(PinName data_pin) : _datapin(data_pin)
+{
+    if (data_pin != NC) {
+        DigitalInOut *pin = &_datapin;
+        ONEWIRE_INIT(pin);
+        INIT_DELAY;
+    }
+}
+
+bool OneWireGpio::reset()
+{
+// This will return false if no devices are present on the data bus
+    PROF_ZONE(ow_reset);
+    DigitalInOut *pin = &_datapin;
+    bool presence = false;
+    ONEWIRE_OUTPUT(pin);
+    pin->write(0);          // bring low for 500 us
+    ONEWIRE_DELAY_US(500);
+    ONEWIRE_INPUT(pin);     // let the data line float high
+    ONEWIRE_DELAY_US(90);   // wait 90us
+    if (pin->read() == 0)   // see if any devices are pulling the data line low
+        presence = true;
+    ONEWIRE_DELAY_US(410);
+    return presence;
+}
+
+void OneWireGpio::bitOut(bool bit_data)
+{
+    PROF_ZONE(ow_bit);
+    DigitalInOut *pin = &_datapin;
+    ONEWIRE_OUTPUT(pin);
+    pin->write(0);
+    ONEWIRE_DELAY_US(3);                 // DXP modified from 5
+    if (bit_data) {
+        pin->write(1); // bring data line high
+        ONEWIRE_DELAY_US(55);
+    } else {
+        ONEWIRE_DELAY_US(55);            // keep data line low
+        pin->write(1);
+        ONEWIRE_DELAY_US(10);            // DXP added to allow bus to float high before next bit_out
+    }
+}
+
+bool OneWireGpio::bitIn()
+{
+    PROF_ZONE(ow_bit);
+    DigitalInOut *pin = &_datapin;
+    bool answer;
+    ONEWIRE_OUTPUT(pin);
+    pin->write(0);
+    ONEWIRE_DELAY_US(3);                 // DXP modofied from 5
+    ONEWIRE_INPUT(pin);
+    ONEWIRE_DELAY_US(10);                // DXP modified from 5
+    answer = pin->read();
+    ONEWIRE_DELAY_US(45);                // DXP modified from 50
+    return answer;
+}
+
+void OneWireGpio::strongPullup(bool on)
+{
+    DigitalInOut *pin = &_datapin;
+    if (on) {
+        _datapin.output();
+        _datapin.write(1);
+    } else {
+        ONEWIRE_INIT(pin);      // back to the idle, released bus
+        ONEWIRE_INPUT(pin);
+    }
+}
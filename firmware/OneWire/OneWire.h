@@ -0,0 +1,77 @@
+/// @file OneWire.h 1-Wire bus transports for the DS1820 driver
+///
+/// The DS1820 driver talks to the bus only through the primitives of the
+/// OneWire interface: reset/presence, single time slots and bytes, and the
+/// strong pullup for parasite powered probes. Two transports exist:
+/// \li OneWireGpio bit-bangs the slots on any DigitalInOut with wait_us().
+///     Any interrupt can stretch a slot, and a byte costs ~500 us of CPU.
+/// \li OneWireUart (OneWireUart.h) lets a USART in half-duplex mode shape
+///     the slots, see there.
+///
+/// example:
+/// @code
+/// OneWireGpio bus(PB_9);
+///
+/// if (bus.reset()) {
+///     bus.byteOut(0xCC);      // skip ROM
+///     bus.byteOut(0x44);      // convert T
+/// }
+/// @endcode
+///
+#ifndef ONEWIRE_H
+#define ONEWIRE_H
+
+#include "mbed.h"
+
+/// The bus primitives used by the DS1820 driver
+class OneWire {
+public:
+    virtual ~OneWire() {}
+
+    /// Reset pulse and presence detect
+    ///
+    /// @returns false if no devices are present on the data bus
+    virtual bool reset() = 0;
+
+    /// Write one time slot
+    ///
+    /// @param bit_data is the bit to write
+    virtual void bitOut(bool bit_data) = 0;
+
+    /// Read one time slot
+    ///
+    /// @returns the bit the devices put on the bus
+    virtual bool bitIn() = 0;
+
+    /// Write a byte, least significant bit first
+    ///
+    /// @param data is the byte to write
+    virtual void byteOut(char data);
+
+    /// Read a byte, least significant bit first
+    ///
+    /// @returns the byte read
+    virtual char byteIn();
+
+    /// Drive the data line hard high, to power parasite probes while they convert
+    ///
+    /// @param on is true to apply the strong pullup, false to release the line
+    virtual void strongPullup(bool on) = 0;
+};
+
+/// 1-Wire master bit-banged on a GPIO pin
+class OneWireGpio : public OneWire {
+public:
+    /// @param data_pin is the bus data pin, NC for an unused placeholder
+    OneWireGpio(PinName data_pin);
+
+    virtual bool reset();
+    virtual void bitOut(bool bit_data);
+    virtual bool bitIn();
+    virtual void strongPullup(bool on);
+
+private:
+    DigitalInOut _datapin;
+};
+
+#endif // ONEWIRE_H
@@ -0,0 +1,205 @@
+/// @file OneWireUart.cpp 1-Wire master on a USART in half-duplex mode
+///
+#include "OneWireUart.h"
+#include "Profiler.h"
+
+#if defined(TARGET_STM32F1)
+
+#include "pinmap.h"
+#include "PeripheralPins.h"
+
+#define BAUD_RESET  9600
+#define BAUD_SLOT   115200
+#define FRAME_RESET 0xF0
+#define FRAME_ONE   0xFF        // also the read slot
+#define FRAME_ZERO  0x00
+
+static OneWireUart *instance[3];
+
+OneWireUart::OneWireUart(PinName tx_pin) : _uart(NULL), _pin(tx_pin), _count(0)
+{
+    uint32_t periph = pinmap_find_peripheral(tx_pin, PinMap_UART_TX);
+    IRQn_Type irqn;
+    void (*vector)(void);
+
+    switch (periph) {
+        case UART_1:
+            __HAL_RCC_USART1_CLK_ENABLE();
+            _pclk = HAL_RCC_GetPCLK2Freq();
+            _index = 0;
+            irqn = USART1_IRQn;
+            vector = &OneWireUart::irq1;
+            break;
+        case UART_2:
+            __HAL_RCC_USART2_CLK_ENABLE();
+            _pclk = HAL_RCC_GetPCLK1Freq();
+            _index = 1;
+            irqn = USART2_IRQn;
+            vector = &OneWireUart::irq2;
+            break;
+        case UART_3:
+            __HAL_RCC_USART3_CLK_ENABLE();
+            _pclk = HAL_RCC_GetPCLK1Freq();
+            _index = 2;
+            irqn = USART3_IRQn;
+            vector = &OneWireUart::irq3;
+            break;
+        default:
+            return;                     // not a USART TX pin, valid() tells
+    }
+    _uart = (USART_TypeDef *)periph;
+    instance[_index] = this;
+
+    // TX pin as open drain alternate function, the bus pullup makes the high level
+    _func = STM_PIN_DATA(STM_MODE_AF_OD, GPIO_NOPULL,
+                         STM_PIN_AFNUM(pinmap_function(tx_pin, PinMap_UART_TX)));
+    pin_function(tx_pin, _func);
+
+    _uart->CR1 = 0;
+    _uart->CR2 = 0;                     // 1 stop bit
+    _uart->CR3 = USART_CR3_HDSEL;       // RX listens on the TX pin
+    setBaud(BAUD_SLOT);
+    _uart->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
+
+    NVIC_SetVector(irqn, (uint32_t)vector);
+    NVIC_EnableIRQ(irqn);
+}
+
+OneWireUart::~OneWireUart()
+{
+    if (_uart) {
+        _uart->CR1 = 0;
+        instance[_index] = NULL;
+    }
+}
+
+void OneWireUart::setBaud(uint32_t baud)
+{
+    while (!(_uart->SR & USART_SR_TC))
+        ;                               // never change the rate in the middle of a frame
+    _uart->BRR = (_pclk + baud / 2) / baud;
+}
+
+// Send the first frame and chain the others from the echo interrupt.
+// _out holds the remaining slots LSB first, _count the number of frames.
+// Returns the slots read back, MSB aligned (bit 7 is the last slot).
+uint8_t OneWireUart::transfer(uint8_t first)
+{
+    (void)_uart->SR;
+    (void)_uart->DR;                    // drop a stale echo and error flags
+    _in = 0;
+    _fe = false;
+    if (__get_IPSR() != 0) {
+        // Called from an interrupt handler, our own interrupt might not be
+        // able to preempt it. Chain the frames by polling the echo instead.
+        _uart->DR = first;
+        while (_count) {
+            while (!(_uart->SR & USART_SR_RXNE))
+                ;
+            irq();
+        }
+    } else {
+        _uart->CR1 |= USART_CR1_RXNEIE;
+        _uart->DR = first;
+        for (;;) {                      // sleep until the last echo is in
+            __disable_irq();
+            if (_count == 0)
+                break;
+            __WFI();                    // wakes on the pending interrupt even with PRIMASK set
+            __enable_irq();
+        }
+        __enable_irq();
+    }
+    return _in;
+}
+
+void OneWireUart::irq()
+{
+    uint32_t sr = _uart->SR;
+    if (!(sr & USART_SR_RXNE))
+        return;
+    uint8_t echo = _uart->DR;           // reading DR also clears FE
+    _echo = echo;
+    if (sr & USART_SR_FE)
+        _fe = true;
+    _in = (_in >> 1) | ((echo == FRAME_ONE) ? 0x80 : 0x00);
+    if (--_count) {
+        _uart->DR = (_out & 0x01) ? FRAME_ONE : FRAME_ZERO;
+        _out = _out >> 1;
+    } else
+        _uart->CR1 &= ~USART_CR1_RXNEIE;
+}
+
+void OneWireUart::irq1()
+{
+    if (instance[0])
+        instance[0]->irq();
+}
+
+void OneWireUart::irq2()
+{
+    if (instance[1])
+        instance[1]->irq();
+}
+
+void OneWireUart::irq3()
+{
+    if (instance[2])
+        instance[2]->irq();
+}
+
+bool OneWireUart::reset()
+{
+// This will return false if no devices are present on the data bus
+    PROF_ZONE(ow_reset);
+    if (!_uart)
+        return false;
+    setBaud(BAUD_RESET);
+    _count = 1;
+    transfer(FRAME_RESET);
+    setBaud(BAUD_SLOT);
+    // a presence pulse pulls some of the high data bits low, a shorted bus
+    // holds the stop bit low as well and shows up as a framing error
+    return _echo != FRAME_RESET && !_fe;
+}
+
+void OneWireUart::bitOut(bool bit_data)
+{
+    PROF_ZONE(ow_bit);
+    _count = 1;
+    transfer(bit_data ? FRAME_ONE : FRAME_ZERO);
+}
+
+bool OneWireUart::bitIn()
+{
+    PROF_ZONE(ow_bit);
+    _count = 1;
+    return transfer(FRAME_ONE) & 0x80;
+}
+
+void OneWireUart::byteOut(char data)
+{
+    PROF_ZONE(ow_byte);
+    _out = (uint8_t)data >> 1;
+    _count = 8;
+    transfer((data & 0x01) ? FRAME_ONE : FRAME_ZERO);
+}
+
+char OneWireUart::byteIn()
+{
+    PROF_ZONE(ow_byte);
+    _out = 0xFF;                        // read slots are write 1 slots
+    _count = 8;
+    return transfer(FRAME_ONE);
+}
+
+void OneWireUart::strongPullup(bool on)
+{
+    // the idle USART drives TX high, as push-pull that powers parasite probes
+    if (on)
+        pin_function(_pin, STM_PIN_DATA(STM_MODE_AF_PP, GPIO_NOPULL, STM_PIN_AFNUM(_func)));
+    else
+        pin_function(_pin, _func);
+}
+
+#endif // TARGET_STM32F1
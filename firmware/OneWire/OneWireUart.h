@@ -0,0 +1,77 @@
+/// @file OneWireUart.h 1-Wire master on a USART in half-duplex mode
+///
+/// The USART TX pin is the bus data line, configured open drain with the
+/// usual 4k7 pullup. The USART receiver hears its own transmission plus
+/// whatever the devices pull low, so every 1-Wire slot is one UART frame:
+/// \li reset: 0xF0 at 9600 baud gives a 520 us low pulse; any echo other
+///     than 0xF0 means a device answered with a presence pulse
+/// \li write 1 / read slot: 0xFF at 115200 baud, only the 8.7 us start bit
+///     is low; an echo other than 0xFF means a device held the line low
+/// \li write 0: 0x00 at 115200 baud, 78 us low
+///
+/// The slot timing is shaped by the USART, so interrupts no longer stretch
+/// it. A byte is sent as 8 frames chained from the RXNE interrupt; the
+/// caller sleeps until the last echo is in. When called from an interrupt
+/// handler (the measurement Ticker) the frames are chained by polling,
+/// which keeps the timing exact but costs the ~700 us of byte time.
+///
+/// Supports:
+/// \li TARGET_STM32F1 (USART1..3, any TX pin of the pinmap)
+///
+/// example:
+/// @code
+/// OneWireUart bus(PA_9);      // USART1 TX
+/// DS1820 probe(&bus);
+/// @endcode
+///
+#ifndef ONEWIREUART_H
+#define ONEWIREUART_H
+
+#include "mbed.h"
+#include "OneWire.h"
+
+#if defined(TARGET_STM32F1)
+
+class OneWireUart : public OneWire {
+public:
+    /// @param tx_pin is a USART TX pin, used as the bus data line
+    OneWireUart(PinName tx_pin);
+    virtual ~OneWireUart();
+
+    virtual bool reset();
+    virtual void bitOut(bool bit_data);
+    virtual bool bitIn();
+    virtual void byteOut(char data);
+    virtual char byteIn();
+    virtual void strongPullup(bool on);
+
+    /// @returns false if the pin is no USART TX pin
+    bool valid() const {
+        return _uart != NULL;
+    }
+
+private:
+    void setBaud(uint32_t baud);
+    uint8_t transfer(uint8_t first);
+    void irq();
+    static void irq1();
+    static void irq2();
+    static void irq3();
+
+    USART_TypeDef *_uart;
+    PinName  _pin;
+    int      _func;             // pin function of the TX pin, open drain
+    int      _index;            // 0..2 for USART1..3
+    uint32_t _pclk;
+
+    // state of the running byte transfer, owned by irq()
+    volatile uint8_t _out;      // slots still to send, LSB first
+    volatile uint8_t _in;       // bits collected so far
+    volatile uint8_t _count;    // slots left to receive
+    volatile uint8_t _echo;     // last frame received, raw
+    volatile bool    _fe;       // framing error during the transfer
+};
+
+#endif // TARGET_STM32F1
+
+#endif // ONEWIREUART_H
@@ -0,0 +1,227 @@
+/// @file PowerManager.cpp Stop mode between samples, RTC alarm wakeup and power gating
+///
+#include <string.h>
+#include "PowerManager.h"
+#include "us_ticker_api.h"
+#include "millis.h"
+#include "Trace.h"
+
+PowerManager::PowerManager(PinName sensors, PinName sd, int on) : _sensors(sensors), _sd(sd),
+    _on(on), _clk(0), _div(1), _alarm(0), _cycle(0)
+{
+    this->sensors(true);
+    this->sd(true);
+    resetStats();
+}
+
+void PowerManager::sensors(bool on)
+{
+    if (_sensors.is_connected())
+        _sensors = on ? _on : !_on;
+}
+
+void PowerManager::sd(bool on)
+{
+    if (_sd.is_connected())
+        _sd = on ? _on : !_on;
+}
+
+void PowerManager::resetStats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void PowerManager::stats(POWER_T *stats)
+{
+    memcpy(stats, &_stats, sizeof(*stats));
+}
+
+void PowerManager::beginCycle()
+{
+    _cycle = _alarm ? _alarm : micros64();
+    _alarm = 0;
+    _stats.cycles++;
+}
+
+void PowerManager::mark(int step)
+{
+    uint32_t t = (uint32_t)(micros64() - _cycle);
+    if (step < 0 || step >= PWR_MARKS)
+        return;
+    _stats.last[step] = t;
+    if (t > _stats.max[step])
+        _stats.max[step] = t;
+}
+
+#if defined(TARGET_STM32F1)
+
+bool PowerManager::begin()
+{
+    __HAL_RCC_PWR_CLK_ENABLE();
+    __HAL_RCC_BKP_CLK_ENABLE();
+    PWR->CR |= PWR_CR_DBP;              // backup domain writable
+
+    // the RTC survives a reset, keep it running if it was started before
+    if (!(RCC->BDCR & RCC_BDCR_RTCEN)) {
+        RCC->BDCR |= RCC_BDCR_LSEON;
+        for (int i = 0; i < 200 && !(RCC->BDCR & RCC_BDCR_LSERDY); i++)
+            wait_ms(10);                // the crystal takes up to 2 s to start
+        if (RCC->BDCR & RCC_BDCR_LSERDY)
+            RCC->BDCR |= RCC_BDCR_RTCSEL_LSE;
+        else {
+            RCC->BDCR &= ~RCC_BDCR_LSEON;
+            RCC->BDCR |= RCC_BDCR_RTCSEL_LSI;
+        }
+        RCC->BDCR |= RCC_BDCR_RTCEN;
+    }
+    if ((RCC->BDCR & RCC_BDCR_RTCSEL) == RCC_BDCR_RTCSEL_LSI) {
+        RCC->CSR |= RCC_CSR_LSION;      // also the watchdog clock, it is on already when that runs
+        for (int i = 0; i < 100 && !(RCC->CSR & RCC_CSR_LSIRDY); i++)
+            wait_us(10);
+        if (!(RCC->CSR & RCC_CSR_LSIRDY))
+            return false;
+        _clk = 40000;                   // nominal, the LSI is +-50% over temperature
+    } else if (RCC->BDCR & RCC_BDCR_LSERDY)
+        _clk = 32768;
+    else
+        return false;
+    _div = _clk / PWR_RTC_HZ;
+
+    // prescaler to PWR_RTC_HZ, alarm interrupt on EXTI line 17 so it ends Stop mode
+    RTC->CRL &= ~RTC_CRL_RSF;
+    while (!(RTC->CRL & RTC_CRL_RSF))
+        ;
+    while (!(RTC->CRL & RTC_CRL_RTOFF))
+        ;
+    RTC->CRL |= RTC_CRL_CNF;
+    RTC->PRLH = 0;
+    RTC->PRLL = _div - 1;
+    RTC->CRL &= ~(RTC_CRL_CNF | RTC_CRL_ALRF);
+    while (!(RTC->CRL & RTC_CRL_RTOFF))
+        ;
+    RTC->CRH = RTC_CRH_ALRIE;
+    EXTI->IMR |= EXTI_IMR_MR17;
+    EXTI->RTSR |= EXTI_RTSR_TR17;
+    EXTI->PR = EXTI_PR_PR17;
+    NVIC_SetVector(RTC_Alarm_IRQn, (uint32_t)&PowerManager::alarm_irq);
+    NVIC_EnableIRQ(RTC_Alarm_IRQn);
+    return true;
+}
+
+// RTC time in input clock cycles, the divider counts down within a count
+uint64_t PowerManager::rtcCycles()
+{
+    uint32_t cnt, div;
+    do {
+        cnt = ((uint32_t)RTC->CNTH << 16) | RTC->CNTL;
+        div = ((RTC->DIVH & 0x000F) << 16) | RTC->DIVL;
+    } while (cnt != (((uint32_t)RTC->CNTH << 16) | RTC->CNTL));
+    return (uint64_t)cnt * _div + (_div - 1 - div);
+}
+
+void PowerManager::setAlarm(uint32_t count)
+{
+    while (!(RTC->CRL & RTC_CRL_RTOFF))
+        ;
+    RTC->CRL |= RTC_CRL_CNF;
+    RTC->ALRH = count >> 16;
+    RTC->ALRL = count & 0xFFFF;
+    RTC->CRL &= ~(RTC_CRL_CNF | RTC_CRL_ALRF);
+    while (!(RTC->CRL & RTC_CRL_RTOFF))
+        ;
+}
+
+void PowerManager::setCounter(uint32_t count)
+{
+    while (!(RTC->CRL & RTC_CRL_RTOFF))
+        ;
+    RTC->CRL |= RTC_CRL_CNF;
+    RTC->CNTH = count >> 16;
+    RTC->CNTL = count & 0xFFFF;
+    RTC->CRL &= ~RTC_CRL_CNF;
+    while (!(RTC->CRL & RTC_CRL_RTOFF))
+        ;
+}
+
+bool PowerManager::stop(uint64_t us)
+{
+    _alarm = 0;
+    if (!_clk || (us && us < PWR_MIN_STOP_US))
+        return false;
+    if (!us || us > PWR_MAX_STOP_MS * 1000ULL)
+        us = PWR_MAX_STOP_MS * 1000ULL;
+
+    // wake one RTC count early rather than late, the scheduler sleeps the rest
+    uint64_t start = rtcCycles();
+    if (start / _div > 0xF0000000UL) {  // only time differences matter, never let it wrap
+        setCounter(0);
+        start = rtcCycles();
+    }
+    uint32_t due = (uint32_t)(start / _div + us * _clk / _div / 1000000);
+    setAlarm(due);
+    EXTI->PR = EXTI_PR_PR17;
+    uint32_t before = us_ticker_read();
+    TRACE(stop, us / 1000);
+
+    deepsleep();                        // Stop, low power regulator, back on the PLL
+
+    uint32_t ran = us_ticker_read() - before;
+    RTC->CRL &= ~RTC_CRL_RSF;           // registers are stale until the first RTC clock after Stop
+    while (!(RTC->CRL & RTC_CRL_RSF))
+        ;
+    uint64_t end = rtcCycles();
+    uint64_t slept = (end - start) * 1000000 / _clk;
+    if (slept > ran)
+        microsSkip(slept - ran);        // the us_ticker stood still meanwhile
+    TRACE_END(stop, slept / 1000);      // so does the cycle counter, the decoder adds this
+
+    _stats.stops++;
+    _stats.stopped += slept;
+    if (end >= (uint64_t)due * _div) {  // the alarm ended it, measure the wakeup
+        uint32_t wake = (uint32_t)((end - (uint64_t)due * _div) * 1000000 / _clk);
+        _alarm = micros64() - wake;
+        _stats.alarms++;
+        _stats.last[pwr_clock] = wake;
+        if (wake > _stats.max[pwr_clock])
+            _stats.max[pwr_clock] = wake;
+    }
+    return true;
+}
+
+void PowerManager::alarm_irq()
+{
+    RTC->CRL &= ~RTC_CRL_ALRF;
+    EXTI->PR = EXTI_PR_PR17;
+}
+
+#else
+
+// no Stop mode driver for this target: the caller takes the normal sleep
+bool PowerManager::begin()
+{
+    return false;
+}
+
+uint64_t PowerManager::rtcCycles()
+{
+    return 0;
+}
+
+void PowerManager::setAlarm(uint32_t count)
+{
+}
+
+void PowerManager::setCounter(uint32_t count)
+{
+}
+
+bool PowerManager::stop(uint64_t us)
+{
+    return false;
+}
+
+void PowerManager::alarm_irq()
+{
+}
+
+#endif
@@ -0,0 +1,142 @@
+/// @file PowerManager.h Stop mode between samples, RTC alarm wakeup and power gating
+///
+/// At one sample per minute the logger is idle for more than 99% of the
+/// time. Sleep (WFI) keeps the clocks and the regulator running, Stop mode
+/// turns off every clock but the 32 kHz one and keeps RAM and registers.
+/// The us_ticker stops there, so the wakeup comes from the RTC alarm, and
+/// the time slept is measured on the RTC and added to the micros64()
+/// timebase afterwards.
+///
+/// The RTC counts at PWR_RTC_HZ from the LSE crystal, or from the LSI when
+/// no crystal is fitted. Its prescaler divider gives the time between the
+/// alarm and the first instruction after the wakeup to 1/32768 s, which is
+/// the start of the wake-to-sample latency budget: mark() stores the time
+/// of every later step of a wake cycle relative to that alarm.
+///
+/// The independent watchdog keeps running in Stop mode, one stop() never
+/// lasts longer than PWR_MAX_STOP_MS.
+///
+/// The RTC is set up here, not by the mbed rtc_api: time() and set_time()
+/// must not be used together with this class.
+///
+/// Supports:
+/// \li TARGET_STM32F1; other targets take the normal sleep and report no wakeups
+///
+/// example:
+/// @code
+/// PowerManager pm(PB_0, PB_1);            // sensor and SD card supply switches
+///
+/// bool onIdle(uint64_t us) {              // Scheduler idle hook
+///     return pm.stop(us);
+/// }
+/// void wakeTask() {
+///     pm.beginCycle();
+///     pm.sensors(true);
+///     ...
+///     pm.mark(pwr_sample);
+/// }
+/// @endcode
+///
+#ifndef POWERMANAGER_H
+#define POWERMANAGER_H
+
+#include "mbed.h"
+
+#ifndef PWR_RTC_HZ
+#define PWR_RTC_HZ      1024    ///< RTC counter rate, resolution of the alarm
+#endif
+#ifndef PWR_MAX_STOP_MS
+#define PWR_MAX_STOP_MS 4000    ///< longest single stop, below the watchdog timeout on a fast LSI
+#endif
+#define PWR_MIN_STOP_US 5000    ///< shorter idle times are not worth the clock restart
+
+/// Steps of a wake cycle, mark() records the time since the RTC alarm
+enum PWR_MARK {
+    pwr_clock,          ///< core running on the PLL again
+    pwr_sensors,        ///< sensor supply on and settled
+    pwr_temp,           ///< temperature conversion read back
+    pwr_pressure,       ///< pressure reading available
+    pwr_sample,         ///< sample complete, sensors off
+    pwr_write,          ///< batch written to the card, card off
+    PWR_MARKS
+};
+
+/// Power statistics, times in microseconds
+typedef struct {
+    uint32_t stops;             ///< times Stop mode was entered
+    uint32_t alarms;            ///< stops ended by the RTC alarm
+    uint64_t stopped;           ///< total time in Stop mode
+    uint32_t cycles;            ///< wake cycles begun
+    uint32_t last[PWR_MARKS];   ///< latest time of each step after the alarm
+    uint32_t max[PWR_MARKS];    ///< longest time of each step after the alarm
+} POWER_T;
+
+class PowerManager {
+public:
+    /// Both supplies start switched on
+    ///
+    /// @param sensors switches the sensor supply, NC if not fitted
+    /// @param sd switches the SD card supply, NC if not fitted
+    /// @param on is the level that turns a supply on
+    PowerManager(PinName sensors = NC, PinName sd = NC, int on = 1);
+
+    /// Start the RTC, the LSE if it oscillates, else the LSI
+    ///
+    /// @returns false if neither 32 kHz clock started
+    bool begin();
+
+    /// @returns the RTC clock in Hz, 0 before begin()
+    uint32_t rtcClock() const {
+        return _clk;
+    }
+
+    /// Enter Stop mode, call with interrupts masked
+    ///
+    /// Returns after the RTC alarm or any other EXTI interrupt, the clock
+    /// is restored and micros64() has been advanced by the time slept.
+    /// Idle times below PWR_MIN_STOP_US are left to the normal sleep.
+    ///
+    /// @param us is the time to the next event, 0 for PWR_MAX_STOP_MS
+    /// @returns false if it only slept, the caller must arm its own wakeup
+    bool stop(uint64_t us);
+
+    /// Switch the sensor supply
+    void sensors(bool on);
+
+    /// Switch the SD card supply
+    void sd(bool on);
+
+    /// Start a wake cycle: the marks that follow count from the RTC alarm
+    /// that ended the latest stop, or from now if something else ended it
+    void beginCycle();
+
+    /// Record the time of a step of the current wake cycle
+    ///
+    /// @param step is the PWR_MARK
+    void mark(int step);
+
+    /// Read the statistics since begin() or resetStats()
+    ///
+    /// @param stats receives the statistics
+    void stats(POWER_T *stats);
+
+    /// Restart the statistics
+    void resetStats();
+
+private:
+    uint64_t rtcCycles();
+    void setAlarm(uint32_t count);
+    void setCounter(uint32_t count);
+    static void alarm_irq();
+
+    DigitalOut _sensors;
+    DigitalOut _sd;
+    int      _on;
+    uint32_t _clk;              // RTC input clock, Hz
+    uint32_t _div;              // RTC input cycles per count
+    uint64_t _alarm;            // micros64() time of the alarm that ended the last stop, 0 if none
+    uint64_t _cycle;            // micros64() time the current wake cycle counts from
+    POWER_T  _stats;
+};
+
+#endif // POWERMANAGER_H
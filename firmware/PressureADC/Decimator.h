@@ -0,0 +1,102 @@
+/// @file Decimator.h oversample-and-decimate filter for 12 bit ADC streams
+///
+/// A cascaded integrator-comb (CIC) decimator of order 1..3 and decimation
+/// ratio 2^log2ratio. Order 1 is the plain boxcar average. Each doubling of
+/// the ratio adds half a bit of resolution on white noise, so 256x gives
+/// the 16 bits the output is scaled to; higher orders roll off more of the
+/// noise above the output rate (mains hum, pump vibration) at the cost of
+/// a longer settling time (order x ratio input samples).
+///
+/// The integrators run modulo 2^32, which is exact as long as
+/// 12 + order * log2ratio <= 32.
+///
+/// The output is scaled to the range of AnalogIn::read_u16(), so the
+/// FixedPoint calibration applies unchanged.
+///
+/// This file has no mbed dependency so the host tools can share it.
+///
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>
+
+#define DECIMATOR_MAX_ORDER 3
+
+class Decimator {
+public:
+    /// @param order is the number of integrator/comb stages, 1 (boxcar) .. 3
+    /// @param log2ratio gives the decimation ratio 2^log2ratio
+    Decimator(int order = 1, int log2ratio = 8) {
+        configure(order, log2ratio);
+    }
+
+    /// Change the filter, restarts it
+    ///
+    /// @param order is the number of integrator/comb stages, 1 (boxcar) .. 3
+    /// @param log2ratio gives the decimation ratio 2^log2ratio
+    /// @returns false if the bit growth does not fit, the filter is unchanged then
+    bool configure(int order, int log2ratio) {
+        if (order < 1 || order > DECIMATOR_MAX_ORDER || log2ratio < 0
+                || 12 + order * log2ratio > 32)
+            return false;
+        _order = order;
+        _log2ratio = log2ratio;
+        reset();
+        return true;
+    }
+
+    /// Restart the filter, the next outputs need order x ratio inputs to settle
+    void reset() {
+        for (int i = 0; i < DECIMATOR_MAX_ORDER; i++)
+            _integ[i] = _comb[i] = 0;
+        _phase = 0;
+    }
+
+    /// Feed one ADC sample
+    ///
+    /// @param x is the 12 bit, right aligned ADC sample
+    /// @param out receives the 16 bit output when one is produced
+    /// @returns true if out was written
+    bool add(uint16_t x, uint16_t *out) {
+        uint32_t v = x;
+        for (int i = 0; i < _order; i++) {
+            _integ[i] += v;
+            v = _integ[i];
+        }
+        if (++_phase < (1UL << _log2ratio))
+            return false;
+        _phase = 0;
+        for (int i = 0; i < _order; i++) {
+            uint32_t prev = _comb[i];
+            _comb[i] = v;
+            v -= prev;
+        }
+        // v now holds sum * ratio^(order - 1), 12 + order * log2ratio bits
+        int shift = _order * _log2ratio - 4;
+        if (shift >= 0)
+            v = (v + ((1UL << shift) >> 1)) >> shift;
+        else
+            v <<= -shift;
+        *out = (v > 0xFFFF) ? 0xFFFF : v;
+        return true;
+    }
+
+    /// @returns the decimation ratio
+    uint32_t ratio() const {
+        return 1UL << _log2ratio;
+    }
+
+    /// @returns the number of stages
+    int order() const {
+        return _order;
+    }
+
+private:
+    uint32_t _integ[DECIMATOR_MAX_ORDER];
+    uint32_t _comb[DECIMATOR_MAX_ORDER];
+    uint32_t _phase;
+    int _order;
+    int _log2ratio;
+};
+
+#endif // DECIMATOR_H
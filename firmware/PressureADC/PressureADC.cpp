@@ -0,0 +1,183 @@
+/// @file PressureADC.cpp continuous, timer triggered pressure acquisition
+///
+#include "PressureADC.h"
+#include "Profiler.h"
+#include "Trace.h"
+
+static PressureADC *instance = NULL;
+
+PressureADC::PressureADC(PinName pin) : _pin(pin), _dec(1, 10), _last(0), _readings(0),
+    _samples(0), _overruns(0), _head(0), _tail(0)
+{
+}
+
+bool PressureADC::configure(int order, int log2ratio)
+{
+    bool ok;
+    __disable_irq();                    // the DMA interrupt runs the filter
+    ok = _dec.configure(order, log2ratio);
+    __enable_irq();
+    return ok;
+}
+
+void PressureADC::push(uint16_t v)
+{
+    uint8_t next = (_head + 1) % PRESSADC_FIFO;
+    _last = v;
+    _readings++;
+    if (next == _tail) {
+        _overruns++;                    // keep the newest, drop the oldest
+        _tail = (_tail + 1) % PRESSADC_FIFO;
+    }
+    _fifo[_head] = v;
+    _head = next;
+}
+
+bool PressureADC::get(uint16_t *v)
+{
+    bool ok = false;
+#if !defined(TARGET_STM32F1)
+    if (_tail == _head)
+        read_u16();                     // no DMA driver: convert on demand
+#endif
+    __disable_irq();
+    if (_tail != _head) {
+        *v = _fifo[_tail];
+        _tail = (_tail + 1) % PRESSADC_FIFO;
+        ok = true;
+    }
+    __enable_irq();
+    return ok;
+}
+
+void PressureADC::process(const uint16_t *half)
+{
+    PROF_ZONE(adc);
+    TRACE_SCOPE(adc, 0);
+    uint16_t v;
+    _samples += PRESSADC_HALF;
+    for (int i = 0; i < PRESSADC_HALF; i++) {
+        if (_dec.add(half[i], &v))
+            push(v);
+    }
+}
+
+#if defined(TARGET_STM32F1)
+
+#include "pinmap.h"
+#include "PeripheralPins.h"
+
+bool PressureADC::start()
+{
+    uint32_t function = pinmap_find_function(_pin, PinMap_ADC);
+    uint32_t timclk;
+
+    if (pinmap_find_peripheral(_pin, PinMap_ADC) != ADC_1 || function == (uint32_t)NC)
+        return false;
+    int channel = STM_PIN_CHANNEL(function);
+    instance = this;
+    _dec.reset();
+    _head = _tail = 0;
+    pin_function(_pin, STM_PIN_DATA(STM_MODE_ANALOG, GPIO_NOPULL, 0));
+
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_ADCPRE) | RCC_CFGR_ADCPRE_DIV6;     // 12 MHz, max is 14
+
+    // ADC1: one channel, longest sample time (21 us per conversion), TIM3 TRGO starts it
+    ADC1->CR1 = 0;
+    ADC1->CR2 = ADC_CR2_ADON;
+    wait_us(2);                         // tSTAB before calibration
+    ADC1->CR2 |= ADC_CR2_RSTCAL;
+    while (ADC1->CR2 & ADC_CR2_RSTCAL)
+        ;
+    ADC1->CR2 |= ADC_CR2_CAL;
+    while (ADC1->CR2 & ADC_CR2_CAL)
+        ;
+    if (channel < 10)
+        ADC1->SMPR2 = (ADC1->SMPR2 & ~(7UL << (3 * channel))) | (7UL << (3 * channel));
+    else
+        ADC1->SMPR1 = (ADC1->SMPR1 & ~(7UL << (3 * (channel - 10)))) | (7UL << (3 * (channel - 10)));
+    ADC1->SQR1 = 0;                     // sequence of one
+    ADC1->SQR3 = channel;
+    ADC1->CR2 = ADC_CR2_ADON | ADC_CR2_DMA | ADC_CR2_EXTTRIG | ADC_CR2_EXTSEL_2;    // EXTSEL 100: TIM3 TRGO
+
+    // DMA1 channel 1: ADC1 DR to the ping-pong buffer, circular, interrupt at half and end
+    DMA1_Channel1->CCR = 0;
+    DMA1_Channel1->CPAR = (uint32_t)&ADC1->DR;
+    DMA1_Channel1->CMAR = (uint32_t)_buf;
+    DMA1_Channel1->CNDTR = 2 * PRESSADC_HALF;
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+    DMA1_Channel1->CCR = DMA_CCR_MINC | DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 | DMA_CCR_CIRC
+                         | DMA_CCR_HTIE | DMA_CCR_TCIE | DMA_CCR_EN;
+    NVIC_SetVector(DMA1_Channel1_IRQn, (uint32_t)&PressureADC::dma_irq);
+    NVIC_EnableIRQ(DMA1_Channel1_IRQn);
+
+    // TIM3: 1 MHz count, update event every 1/PRESSADC_RATE s is the trigger output
+    timclk = HAL_RCC_GetPCLK1Freq();
+    if (RCC->CFGR & RCC_CFGR_PPRE1_2)
+        timclk *= 2;                    // APB1 divided, the timers run at twice PCLK1
+    TIM3->CR1 = 0;
+    TIM3->PSC = timclk / 1000000 - 1;
+    TIM3->ARR = 1000000 / PRESSADC_RATE - 1;
+    TIM3->CR2 = TIM_CR2_MMS_1;          // MMS 010: update is TRGO
+    TIM3->EGR = TIM_EGR_UG;
+    TIM3->CR1 = TIM_CR1_CEN;
+    return true;
+}
+
+void PressureADC::stop()
+{
+    TIM3->CR1 = 0;
+    DMA1_Channel1->CCR = 0;
+    NVIC_DisableIRQ(DMA1_Channel1_IRQn);
+    ADC1->CR2 = 0;                      // ADON off: power down until the next start()
+}
+
+uint16_t PressureADC::read_u16()
+{
+    return _last;
+}
+
+void PressureADC::dma_irq()
+{
+    uint32_t isr = DMA1->ISR;
+    DMA1->IFCR = isr & (DMA_ISR_HTIF1 | DMA_ISR_TCIF1 | DMA_ISR_GIF1);
+    if (!instance)
+        return;
+    if (isr & DMA_ISR_HTIF1)
+        instance->process(&instance->_buf[0]);              // DMA now fills the second half
+    if (isr & DMA_ISR_TCIF1)
+        instance->process(&instance->_buf[PRESSADC_HALF]);  // and now the first again
+}
+
+#else
+
+// no DMA driver for this target: one conversion per call, no filtering
+bool PressureADC::start()
+{
+    instance = this;
+    _dec.reset();
+    _head = _tail = 0;
+    return true;
+}
+
+void PressureADC::stop()
+{
+}
+
+uint16_t PressureADC::read_u16()
+{
+    PROF_ZONE(adc);
+    AnalogIn ain(_pin);
+    _samples++;
+    push(ain.read_u16());
+    return _last;
+}
+
+void PressureADC::dma_irq()
+{
+}
+
+#endif
@@ -0,0 +1,116 @@
+/// @file PressureADC.h continuous, timer triggered pressure acquisition
+///
+/// TIM3 triggers ADC1 at a fixed rate, DMA1 channel 1 moves every result
+/// into a circular buffer. The half and full transfer interrupts hand the
+/// finished half to a Decimator while the DMA fills the other half, so no
+/// sample is lost and the CPU only runs once per half buffer. The decimated
+/// 16 bit readings go to a small FIFO for high rate logging, and the latest
+/// one is always available through read_u16().
+///
+/// With the defaults (4096 Hz, boxcar of 1024) the output rate is 4 Hz with
+/// about 16 effective bits instead of the 12 noisy bits of one conversion.
+/// configure(2, 5) gives 128 Hz for descent profiles.
+///
+/// Uses TIM3, ADC1 and DMA1 channel 1 on TARGET_STM32F1. On other targets
+/// it falls back to one AnalogIn conversion per read_u16() call, and per
+/// get() call that finds the FIFO empty.
+///
+/// example:
+/// @code
+/// PressureADC pressin(PA_1);
+///
+/// main() {
+///     pressin.start();
+///     ...
+///     uint16_t raw = pressin.read_u16();
+/// }
+/// @endcode
+///
+#ifndef PRESSUREADC_H
+#define PRESSUREADC_H
+
+#include "mbed.h"
+#include "Decimator.h"
+
+#ifndef PRESSADC_RATE
+#define PRESSADC_RATE       4096    ///< ADC conversions per second
+#endif
+#ifndef PRESSADC_HALF
+#define PRESSADC_HALF       64      ///< samples per DMA half buffer
+#endif
+#define PRESSADC_FIFO       32      ///< decimated readings kept for get()
+
+class PressureADC {
+public:
+    /// @param pin is the analog input, an ADC1 channel
+    PressureADC(PinName pin);
+
+    /// Set up timer, ADC and DMA and start the acquisition, restarts the filter
+    /// and empties the FIFO
+    ///
+    /// @returns false if the pin has no ADC1 channel
+    bool start();
+
+    /// Stop the timer and power down the ADC, the last reading stays available
+    void stop();
+
+    /// Change the decimation filter, restarts it
+    ///
+    /// @param order is 1 (boxcar) .. 3
+    /// @param log2ratio gives the decimation ratio 2^log2ratio
+    /// @returns false if the combination is not supported
+    bool configure(int order, int log2ratio);
+
+    /// @returns the latest decimated reading, 0..65535 like AnalogIn::read_u16()
+    uint16_t read_u16();
+
+    /// Take the oldest decimated reading from the FIFO
+    ///
+    /// @param v receives the reading
+    /// @returns false if the FIFO is empty
+    bool get(uint16_t *v);
+
+    /// @returns decimated readings per second
+    uint32_t outputRate() const {
+        return PRESSADC_RATE / _dec.ratio();
+    }
+
+    /// @returns the decimation filter
+    const Decimator &decimator() const {
+        return _dec;
+    }
+
+    /// @returns number of decimated readings since start
+    uint32_t readings() const {
+        return _readings;
+    }
+
+    /// @returns number of ADC samples the DMA handed over since power up,
+    /// or the conversions read_u16() made without a DMA driver
+    uint32_t samples() const {
+        return _samples;
+    }
+
+    /// @returns number of readings lost because the FIFO was full
+    uint32_t overruns() const {
+        return _overruns;
+    }
+
+private:
+    void push(uint16_t v);
+    void process(const uint16_t *half);
+    static void dma_irq();
+
+    PinName  _pin;
+    Decimator _dec;
+    volatile uint16_t _last;
+    volatile uint32_t _readings;
+    volatile uint32_t _samples;
+    volatile uint32_t _overruns;
+    uint16_t _fifo[PRESSADC_FIFO];
+    volatile uint8_t _head;
+    volatile uint8_t _tail;
+    uint16_t _buf[2 * PRESSADC_HALF];   // DMA ping-pong buffer
+};
+
+#endif // PRESSUREADC_H
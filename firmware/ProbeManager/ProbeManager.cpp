@@ -0,0 +1,145 @@
+/// @file ProbeManager.cpp temperature chain manager for DS18B20 probes on several 1-Wire buses
+///
+#include <new>
+#include "ProbeManager.h"
+#include "Trace.h"
+#include "Metrics.h"
+
+// Storage for the probe objects, constructed in place by discover().
+// Shared by all managers, DS1820 keeps one registry of known ROMs anyway.
+static union {
+    char bytes[sizeof(DS1820)];
+    long long align;
+} pool[PROBEMGR_MAX_PROBES];
+static int pool_used = 0;
+
+// Bit-bang transports for the buses registered by pin
+static union {
+    char bytes[sizeof(OneWireGpio)];
+    long long align;
+} gpio_pool[PROBEMGR_MAX_BUSES];
+static int gpio_used = 0;
+
+ProbeManager::ProbeManager() : _buses(0), _count(0), _busy(false), _readings(0)
+{
+    for (int b = 0; b < PROBEMGR_MAX_BUSES; b++)
+        _leader[b] = -1;
+}
+
+bool ProbeManager::addBus(PinName pin)
+{
+    if (_buses == PROBEMGR_MAX_BUSES || gpio_used == PROBEMGR_MAX_BUSES)
+        return false;
+    return addBus(new (&gpio_pool[gpio_used++]) OneWireGpio(pin));
+}
+
+bool ProbeManager::addBus(OneWire *bus)
+{
+    if (_buses == PROBEMGR_MAX_BUSES)
+        return false;
+    _bus[_buses++] = bus;
+    return true;
+}
+
+int ProbeManager::discover()
+{
+    for (int b = 0; b < _buses; b++) {
+        while (_count < PROBEMGR_MAX_PROBES && pool_used < PROBEMGR_MAX_PROBES
+                && DS1820::unassignedProbe(_bus[b])) {
+            enlist(new (&pool[pool_used++]) DS1820(_bus[b]), b);
+        }
+    }
+    return _count;
+}
+
+bool ProbeManager::adopt(int bus, const char *rom)
+{
+    if (bus < 0 || bus >= _buses || _count == PROBEMGR_MAX_PROBES
+            || pool_used == PROBEMGR_MAX_PROBES || DS1820::known_ROM(rom))
+        return false;
+    DS1820 *probe = new (&pool[pool_used]) DS1820(_bus[bus], rom);
+    if (!probe->verify()) {
+        probe->~DS1820();               // gives the slot and the ROM back
+        return false;
+    }
+    pool_used++;
+    enlist(probe, bus);
+    return true;
+}
+
+void ProbeManager::enlist(DS1820 *probe, int bus)
+{
+    _probe[_count] = probe;
+    _busof[_count] = bus;
+    _t16[_count] = DS1820::invalid_conversion;
+    if (_leader[bus] < 0)
+        _leader[bus] = _count;
+    _count++;
+    METRIC_SET(probes, _count);
+}
+
+void ProbeManager::startConversions()
+{
+    for (int b = 0; b < _buses; b++) {
+        if (_leader[b] >= 0)
+            _probe[_leader[b]]->startConversion(DS1820::all_devices);    // skip ROM, whole bus
+    }
+    TRACE(conv, _buses);
+    _busy = true;
+}
+
+void ProbeManager::readAll()
+{
+    for (int i = 0; i < _count; i++)
+        _t16[i] = _probe[i]->temperature_raw();
+    TRACE(conv_done, _count);
+}
+
+ProbeManager::result ProbeManager::poll()
+{
+    if (!_busy) {
+        if (_count == 0)
+            return idle;
+        startConversions();
+        return converting;
+    }
+    // a bus reports done only when its slowest probe is done (wired-AND)
+    for (int b = 0; b < _buses; b++) {
+        if (_leader[b] >= 0 && _probe[_leader[b]]->conversionState() == DS1820::conv_busy)
+            return converting;
+    }
+    readAll();
+    _readings++;
+    startConversions();
+    return updated;
+}
+
+ProbeManager::result ProbeManager::collect()
+{
+    if (!_busy)
+        return idle;
+    for (int b = 0; b < _buses; b++) {
+        if (_leader[b] >= 0 && _probe[_leader[b]]->conversionState() == DS1820::conv_busy)
+            return converting;
+    }
+    readAll();
+    _readings++;
+    _busy = false;
+    return updated;
+}
+
+bool ProbeManager::convertAll(int timeout_ms)
+{
+    Timer t;
+
+    if (_count == 0)
+        return false;
+    t.start();
+    startConversions();
+    while (t.read_ms() < timeout_ms) {
+        if (poll() == updated)
+            return true;
+        wait_ms(10);
+    }
+    return false;
+}
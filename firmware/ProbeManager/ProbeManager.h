@@ -0,0 +1,148 @@
+/// @file ProbeManager.h temperature chain manager for DS18B20 probes on several 1-Wire buses
+///
+/// A thermistor-chain style deployment hangs dozens of probes on a few GPIO
+/// buses. Converting them one by one would cost N x 750 ms. The manager
+/// instead issues one skip-ROM Convert T per bus, so all probes on all buses
+/// convert in parallel, and then reads the scratchpads back to back.
+/// A complete chain reading costs one conversion time plus the bus reads.
+///
+/// A bus is either a GPIO pin, bit-banged, or any other OneWire transport
+/// such as OneWireUart. The probe and bus objects live in static pools,
+/// nothing is taken from the heap.
+///
+/// example:
+/// @code
+/// ProbeManager chain;
+///
+/// main() {
+///     chain.addBus(PB_9);
+///     chain.addBus(PB_8);
+///     chain.discover();
+///     for (;;) {
+///         if (chain.poll() == ProbeManager::updated)
+///             printf("%d\r\n", chain.temperature(0));  // 1/16 degree C
+///         ...
+///     }
+/// }
+/// @endcode
+///
+#ifndef PROBEMANAGER_H
+#define PROBEMANAGER_H
+
+#include "mbed.h"
+#include "DS1820.h"
+
+#ifndef PROBEMGR_MAX_BUSES
+#define PROBEMGR_MAX_BUSES  4
+#endif
+#define PROBEMGR_MAX_PROBES DS1820_MAX_PROBES
+
+class ProbeManager {
+public:
+    enum result {
+        idle,           // nothing in progress
+        converting,     // Convert T running on at least one bus
+        updated         // a complete chain reading was just stored
+    };
+
+    ProbeManager();
+
+    /// Register a 1-Wire bus
+    ///
+    /// @param pin is the data pin of the bus
+    /// @returns false if PROBEMGR_MAX_BUSES buses are registered already
+    bool addBus(PinName pin);
+
+    /// Register a 1-Wire bus driven by another transport
+    ///
+    /// @param bus is the transport, it must outlive the manager
+    /// @returns false if PROBEMGR_MAX_BUSES buses are registered already
+    bool addBus(OneWire *bus);
+
+    /// Search all registered buses and create a DS1820 for every probe found
+    ///
+    /// @returns number of probes known after the search
+    int discover();
+
+    /// Take over a probe with a known ROM id, without searching the bus
+    ///
+    /// The probe is checked with one match-ROM scratchpad read. Probes not
+    /// adopted are picked up by a later discover().
+    ///
+    /// @param bus is the bus index
+    /// @param rom is the 8 byte ROM id
+    /// @returns true if the probe answered and was added
+    bool adopt(int bus, const char *rom);
+
+    /// @returns number of probes
+    int count() const {
+        return _count;
+    }
+
+    /// @returns number of registered buses
+    int buses() const {
+        return _buses;
+    }
+
+    /// @returns the probe at index i, in the order they were adopted or found
+    DS1820 *probe(int i) {
+        return _probe[i];
+    }
+
+    /// @returns the bus index of probe i
+    int busOf(int i) const {
+        return _busof[i];
+    }
+
+    /// Start one skip-ROM conversion on every bus, without waiting
+    void startConversions();
+
+    /// Advance the chain reading, call this periodically
+    ///
+    /// When every bus reports its conversion done, all scratchpads are
+    /// read back to back and the next conversion is started at once.
+    ///
+    /// @returns idle, converting or updated
+    result poll();
+
+    /// Finish the running chain reading without starting the next one
+    ///
+    /// For duty cycled operation: the probes are idle afterwards and can be
+    /// powered down until the next startConversions().
+    ///
+    /// @returns idle if no conversion was started, converting or updated
+    result collect();
+
+    /// Run a complete chain reading and wait for it
+    ///
+    /// @param timeout_ms gives up after this long
+    /// @returns true if all probes were read
+    bool convertAll(int timeout_ms = 1000);
+
+    /// @returns latest temperature of probe i in 1/16 degree C,
+    ///          DS1820::invalid_conversion if there was none or the CRC failed
+    int temperature(int i) const {
+        return _t16[i];
+    }
+
+    /// @returns number of completed chain readings
+    uint32_t readings() const {
+        return _readings;
+    }
+
+private:
+    void enlist(DS1820 *probe, int bus);
+    void readAll();
+
+    OneWire *_bus[PROBEMGR_MAX_BUSES];
+    int      _leader[PROBEMGR_MAX_BUSES];     // probe that starts and polls the conversion on each bus
+    int      _buses;
+    DS1820  *_probe[PROBEMGR_MAX_PROBES];
+    uint8_t  _busof[PROBEMGR_MAX_PROBES];
+    int16_t  _t16[PROBEMGR_MAX_PROBES];
+    int      _count;
+    bool     _busy;
+    uint32_t _readings;
+};
+
+#endif // PROBEMANAGER_H
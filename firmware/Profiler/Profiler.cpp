@@ -0,0 +1,67 @@
+/// @file Profiler.cpp scope based cycle profiling of named zones
+///
+#include <string.h>
+#include "Profiler.h"
+
+#define PROF_NAME(z) #z,
+static const char *const names[PROF_COUNT] = {
+    PROF_ZONES(PROF_NAME)
+};
+#undef PROF_NAME
+
+static PROF_T table[PROF_COUNT];
+
+void Prof_Init(void)
+{
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    Prof_Reset();
+}
+
+void Prof_Reset(void)
+{
+    core_util_critical_section_enter();
+    memset(table, 0, sizeof(table));
+    for (int i = 0; i < PROF_COUNT; i++)
+        table[i].min = UINT32_MAX;
+    core_util_critical_section_exit();
+}
+
+void Prof_Add(int zone, uint32_t cycles)
+{
+    PROF_T *z = &table[zone];
+    core_util_critical_section_enter();
+    z->count++;
+    z->total += cycles;
+    if (cycles < z->min)
+        z->min = cycles;
+    if (cycles > z->max)
+        z->max = cycles;
+    core_util_critical_section_exit();
+}
+
+void Prof_Read(int zone, PROF_T *stats)
+{
+    core_util_critical_section_enter();
+    memcpy(stats, &table[zone], sizeof(*stats));
+    core_util_critical_section_exit();
+    if (!stats->count)
+        stats->min = 0;
+}
+
+const char *Prof_Name(int zone)
+{
+    return names[zone];
+}
+
+uint32_t Prof_Hz(void)
+{
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3)
+    return SystemCoreClock;
+#else
+    return 1000000000UL;
+#endif
+}
@@ -0,0 +1,130 @@
+/// @file Profiler.h scope based cycle profiling of named zones
+///
+/// A zone is a block of code that is timed every time it runs. PROF_ZONE()
+/// at the top of a block reads the cycle counter, and again when the block
+/// is left, and adds the difference to the zone's count, total, minimum
+/// and maximum. The table is static, Prof_Read() and Prof_Reset() serve
+/// the Prof command.
+///
+/// On the Cortex-M3 the counter is the DWT cycle counter, one count per
+/// core clock at a cost of a few cycles per zone. Elsewhere, the host
+/// build included, it is clock_gettime(CLOCK_MONOTONIC) in nanoseconds, so
+/// a zone holds the CPU time of the code, not the virtual time the
+/// simulated board lets pass. Prof_Hz() tells which unit the table holds.
+///
+/// Zones nest, the time of an inner zone is part of the outer one. The
+/// zones are listed once in PROF_ZONES, build with PROF_ENABLE 0 to
+/// compile them out.
+///
+/// example:
+/// @code
+/// bool SDFileSystem::readData(char* buffer, int length)
+/// {
+///     PROF_ZONE(sd_read);
+///     ...
+/// }
+/// @endcode
+///
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "mbed.h"
+
+#ifndef PROF_ENABLE
+#define PROF_ENABLE 1
+#endif
+
+/// The zones, X(name) for each instrumented place
+#define PROF_ZONES(X) \
+    X(sd_wait)      \
+    X(sd_read)      \
+    X(sd_write)     \
+    X(sd_crc)       \
+    X(f_write)      \
+    X(move_window)  \
+    X(adc)          \
+    X(ow_reset)     \
+    X(ow_bit)       \
+    X(ow_byte)      \
+    X(format)
+
+#define PROF_ENUM(z) PROF_##z,
+enum {
+    PROF_ZONES(PROF_ENUM)
+    PROF_COUNT
+};
+#undef PROF_ENUM
+
+/// Statistics of one zone, in counter units
+typedef struct {
+    uint32_t count;         ///< times the zone ran
+    uint64_t total;         ///< sum of all runs
+    uint32_t min;           ///< shortest run
+    uint32_t max;           ///< longest run
+} PROF_T;
+
+/// Start the cycle counter and clear the table
+void Prof_Init(void);
+
+/// Clear the table
+void Prof_Reset(void);
+
+/// Add one run to a zone, safe from interrupt handlers
+///
+/// @param zone is a PROF_ zone
+/// @param cycles is the length of the run
+void Prof_Add(int zone, uint32_t cycles);
+
+/// Read the statistics of a zone
+///
+/// @param zone is a PROF_ zone
+/// @param stats receives the statistics
+void Prof_Read(int zone, PROF_T *stats);
+
+/// @returns the name of a zone
+const char *Prof_Name(int zone);
+
+/// @returns counter units per second
+uint32_t Prof_Hz(void);
+
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3)
+
+/// @returns the free running cycle counter
+static inline uint32_t Prof_Cycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+#else
+
+#include <time.h>
+
+static inline uint32_t Prof_Cycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+#endif
+
+/// Times the enclosing scope, use PROF_ZONE()
+class ProfScope {
+public:
+    ProfScope(int zone) : _zone(zone), _start(Prof_Cycles()) {
+    }
+    ~ProfScope() {
+        Prof_Add(_zone, Prof_Cycles() - _start);
+    }
+private:
+    int      _zone;
+    uint32_t _start;
+};
+
+#if PROF_ENABLE
+#define PROF_ZONE(z)    ProfScope prof_scope_##z(PROF_##z)
+#else
+#define PROF_ZONE(z)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,109 @@
+/// @file RomCache.cpp persistent table of the 1-Wire ROM ids found at the last search
+///
+#include <string.h>
+#include "mbed.h"
+#include "RomCache.h"
+
+#define ROMCACHE_MAGIC  0x31304352      // "RC01", bump when ROMCACHE_T changes
+
+typedef struct {
+    uint32_t magic;
+    uint16_t check;                     // Fletcher-16 of the table
+    uint16_t size;                      // sizeof(ROMCACHE_T) when written
+    ROMCACHE_T table;
+} RECORD_T;
+
+static uint16_t fletcher16(const uint8_t *p, size_t len)
+{
+    uint16_t a = 0, b = 0;
+    while (len--) {
+        a = (a + *p++) % 255;
+        b = (b + a) % 255;
+    }
+    return (b << 8) | a;
+}
+
+#if defined(TARGET_STM32F1)
+
+// last page of the 128 KiB part, excluded from FLASH in STM32F103XB.ld
+#define ROMCACHE_ADDR   0x0801FC00
+
+static const RECORD_T *stored(void)
+{
+    return (const RECORD_T *)ROMCACHE_ADDR;
+}
+
+static bool program(const RECORD_T *rec)
+{
+    FLASH_EraseInitTypeDef erase;
+    uint32_t pageerr;
+    const uint16_t *src = (const uint16_t *)rec;
+    bool ok;
+
+    HAL_FLASH_Unlock();
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks = FLASH_BANK_1;
+    erase.PageAddress = ROMCACHE_ADDR;
+    erase.NbPages = 1;
+    ok = HAL_FLASHEx_Erase(&erase, &pageerr) == HAL_OK;
+    for (unsigned i = 0; ok && rec && i < sizeof(RECORD_T) / 2; i++)
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, ROMCACHE_ADDR + 2 * i, src[i]) == HAL_OK;
+    HAL_FLASH_Lock();
+    return ok;
+}
+
+#else
+
+// no flash driver for this target, the table lives until the next reset
+static RECORD_T ram;
+
+static const RECORD_T *stored(void)
+{
+    return &ram;
+}
+
+static bool program(const RECORD_T *rec)
+{
+    if (rec)
+        ram = *rec;
+    else
+        memset(&ram, 0xFF, sizeof(ram));
+    return true;
+}
+
+#endif
+
+bool RomCache_Load(ROMCACHE_T *cache)
+{
+    const RECORD_T *rec = stored();
+
+    if (rec->magic != ROMCACHE_MAGIC || rec->size != sizeof(ROMCACHE_T)
+            || rec->table.count > ROMCACHE_MAX
+            || rec->check != fletcher16((const uint8_t *)&rec->table, sizeof(ROMCACHE_T)))
+        return false;
+    *cache = rec->table;
+    return true;
+}
+
+bool RomCache_Save(const ROMCACHE_T *cache)
+{
+    RECORD_T rec;
+
+    memset(&rec, 0, sizeof(rec));       // defined padding, so the checksum is stable
+    rec.magic = ROMCACHE_MAGIC;
+    rec.size = sizeof(ROMCACHE_T);
+    rec.table.count = cache->count;
+    rec.table.buses = cache->buses;
+    memcpy(rec.table.bus, cache->bus, cache->count);
+    memcpy(rec.table.rom, cache->rom, cache->count * 8);
+    rec.check = fletcher16((const uint8_t *)&rec.table, sizeof(ROMCACHE_T));
+    if (memcmp(stored(), &rec, sizeof(rec)) == 0)
+        return true;                    // unchanged, spare the flash
+    return program(&rec);
+}
+
+void RomCache_Erase(void)
+{
+    if (stored()->magic == ROMCACHE_MAGIC)
+        program(NULL);
+}
@@ -0,0 +1,57 @@
+/// @file RomCache.h persistent table of the 1-Wire ROM ids found at the last search
+///
+/// A full Search ROM walks the binary tree of all ids on a bus, 64 bits with
+/// three time slots each per device, plus a reset pulse per device. With a
+/// chain of probes that delays the first sample after every restart,
+/// including watchdog restarts in the water.
+///
+/// The table is kept in the last 1 KiB page of the internal flash, which the
+/// linker script keeps free of code. At boot the cached probes are checked
+/// with one match-ROM scratchpad read each (ProbeManager::adopt), the full
+/// search only runs when that fails.
+///
+/// Flash is only written when the table changed, so the page sees one erase
+/// per change of the hardware, not one per boot.
+///
+/// example:
+/// @code
+/// ROMCACHE_T cache;
+///
+/// if (RomCache_Load(&cache)) {
+///     for (int i = 0; i < cache.count; i++)
+///         chain.adopt(cache.bus[i], cache.rom[i]);
+/// }
+/// @endcode
+///
+#ifndef ROMCACHE_H
+#define ROMCACHE_H
+
+#include <stdint.h>
+#include "DS1820.h"
+
+#define ROMCACHE_MAX    DS1820_MAX_PROBES
+
+/// The cached table, in probe order
+typedef struct {
+    uint16_t count;                     ///< number of valid entries
+    uint16_t buses;                     ///< number of buses when the table was written
+    uint8_t  bus[ROMCACHE_MAX];         ///< bus index of each probe
+    char     rom[ROMCACHE_MAX][8];      ///< ROM id of each probe, family code first
+} ROMCACHE_T;
+
+/// Read the table from flash
+///
+/// @param cache receives the table
+/// @returns false if there is no valid table (blank page, old layout, bad checksum)
+bool RomCache_Load(ROMCACHE_T *cache);
+
+/// Write the table to flash, unless flash holds the same table already
+///
+/// @param cache is the table to store
+/// @returns false if programming failed
+bool RomCache_Save(const ROMCACHE_T *cache);
+
+/// Invalidate the table, the next boot runs the full search
+void RomCache_Erase(void);
+
+#endif // ROMCACHE_H
@@ -18,6 +18,8 @@
 
 #include "ff.h"			/* Declarations of FatFs API */
 #include "diskio.h"		/* Declarations of disk I/O functions */
+#include "Profiler.h"
+#include "Trace.h"
 
 
 /*--------------------------------------------------------------------------
@@ -731,6 +733,7 @@ FRESULT move_window (	/* FR_OK(0):succeeded, !=0:error */
 	DWORD sector	/* Sector number to make appearance in the fs->win[] */
 )
 {
+	PROF_ZONE(move_window);
 	FRESULT res = FR_OK;
 
 
@@ -2691,6 +2694,7 @@ FRESULT f_write (
 	UINT* bw			/* Pointer to number of bytes written */
 )
 {
+	PROF_ZONE(f_write);
 	FRESULT res;
 	DWORD clst, sect;
 	UINT wcnt, cc;
@@ -2827,6 +2831,7 @@ FRESULT f_sync (
 	FRESULT res;
 	DWORD tm;
 	BYTE *dir;
+	TRACE_SCOPE(sync, 0);
 
 
 	res = validate(fp);					/* Check validity of the object */
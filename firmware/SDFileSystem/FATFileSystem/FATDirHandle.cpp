@@ -25,6 +25,30 @@
 
 using namespace mbed;
 
+// Storage for the open directories
+static union {
+    char bytes[sizeof(FATDirHandle)];
+    long long align;
+} pool[FAT_MAX_OPEN_DIRS];
+static bool pool_used[FAT_MAX_OPEN_DIRS];
+
+void *FATDirHandle::operator new(size_t size) throw() {
+    for (int i = 0; i < FAT_MAX_OPEN_DIRS; i++) {
+        if (!pool_used[i]) {
+            pool_used[i] = true;
+            return &pool[i];
+        }
+    }
+    return NULL;
+}
+
+void FATDirHandle::operator delete(void *p) {
+    for (int i = 0; i < FAT_MAX_OPEN_DIRS; i++) {
+        if (p == &pool[i])
+            pool_used[i] = false;
+    }
+}
+
 FATDirHandle::FATDirHandle(const FATFS_DIR &the_dir, PlatformMutex * mutex): _mutex(mutex) {
     dir = the_dir;
 }
@@ -22,15 +22,26 @@
 #ifndef MBED_FATDIRHANDLE_H
 #define MBED_FATDIRHANDLE_H
 
+#include <stddef.h>
 #include "DirHandle.h"
 #include "PlatformMutex.h"
 
+/** Directories open at the same time, the handles come from a fixed pool */
+#ifndef FAT_MAX_OPEN_DIRS
+#define FAT_MAX_OPEN_DIRS 1
+#endif
+
 using namespace mbed;
 
 class FATDirHandle : public DirHandle {
 
  public:
     FATDirHandle(const FATFS_DIR &the_dir, PlatformMutex * mutex);
+
+    /** Take a handle from the pool, NULL if all are open */
+    static void *operator new(size_t size) throw();
+    /** Return a handle to the pool, closedir() does */
+    static void operator delete(void *p);
     virtual int closedir();
     virtual struct dirent *readdir();
     virtual void rewinddir();
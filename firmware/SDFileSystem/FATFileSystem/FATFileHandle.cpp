@@ -25,6 +25,30 @@
 
 #include "FATFileHandle.h"
 
+// Storage for the open files, no heap on the path that opens the log every sync
+static union {
+    char bytes[sizeof(FATFileHandle)];
+    long long align;
+} pool[FAT_MAX_OPEN_FILES];
+static bool pool_used[FAT_MAX_OPEN_FILES];
+
+void *FATFileHandle::operator new(size_t size) throw() {
+    for (int i = 0; i < FAT_MAX_OPEN_FILES; i++) {
+        if (!pool_used[i]) {
+            pool_used[i] = true;
+            return &pool[i];
+        }
+    }
+    return NULL;
+}
+
+void FATFileHandle::operator delete(void *p) {
+    for (int i = 0; i < FAT_MAX_OPEN_FILES; i++) {
+        if (p == &pool[i])
+            pool_used[i] = false;
+    }
+}
+
 FATFileHandle::FATFileHandle(FIL fh, PlatformMutex * mutex): _mutex(mutex) {
     _fh = fh;
 }
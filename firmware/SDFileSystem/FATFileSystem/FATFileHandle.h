@@ -22,15 +22,27 @@
 #ifndef MBED_FATFILEHANDLE_H
 #define MBED_FATFILEHANDLE_H
 
+#include <stddef.h>
 #include "FileHandle.h"
 #include "PlatformMutex.h"
 
+/** Files open at the same time, the handles come from a fixed pool */
+#ifndef FAT_MAX_OPEN_FILES
+#define FAT_MAX_OPEN_FILES 2
+#endif
+
 using namespace mbed;
 
 class FATFileHandle : public FileHandle {
 public:
 
     FATFileHandle(FIL fh, PlatformMutex * mutex);
+
+    /** Take a handle from the pool, NULL if all are open */
+    static void *operator new(size_t size) throw();
+    /** Return a handle to the pool, close() does */
+    static void operator delete(void *p);
+
     virtual int close();
     virtual ssize_t write(const void* buffer, size_t length);
     virtual ssize_t read(void* buffer, size_t length);
@@ -19,6 +19,7 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
  * SOFTWARE.
  */
+#include <new>
 #include "mbed.h"
 
 #include "ffconf.h"
@@ -43,19 +44,17 @@ DWORD get_fattime(void) {
 
 FATFileSystem *FATFileSystem::_ffs[_VOLUMES] = {0};
 static PlatformMutex * mutex = NULL;
+static union {
+    char bytes[sizeof(PlatformMutex)];
+    long long align;
+} mutex_storage;
 
 PlatformMutex * get_fat_mutex() {
-    PlatformMutex * new_mutex = new PlatformMutex;
-
     core_util_critical_section_enter();
     if (NULL == mutex) {
-        mutex = new_mutex;
+        mutex = new (&mutex_storage) PlatformMutex;
     }
     core_util_critical_section_exit();
-
-    if (mutex != new_mutex) {
-        delete new_mutex;
-    }
     return mutex;
 }
 
@@ -122,6 +121,10 @@ FileHandle *FATFileSystem::open(const char* name, int flags) {
         f_lseek(&fh, fh.fsize);
     }
     FATFileHandle * handle = new FATFileHandle(fh, _mutex);
+    if (handle == NULL) {
+        debug_if(FFS_DBG, "open(%s): all %d file handles in use\n", name, FAT_MAX_OPEN_FILES);
+        f_close(&fh);
+    }
     unlock();
     return handle;
 }
@@ -171,6 +174,9 @@ DirHandle *FATFileSystem::opendir(const char *name) {
         return NULL;
     }
     FATDirHandle *handle = new FATDirHandle(dir, _mutex);
+    if (handle == NULL) {
+        f_closedir(&dir);
+    }
     unlock();
     return handle;
 }
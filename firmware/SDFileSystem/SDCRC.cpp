@@ -15,6 +15,7 @@
  */
 
 #include "SDCRC.h"
+#include "Profiler.h"
 
 namespace SDCRC
 {
@@ -106,6 +107,7 @@ char crc7(const char* data, int length)
 
 unsigned short crc16(const char* data, int length)
 {
+    PROF_ZONE(sd_crc);
     //Calculate the CRC16 checksum for the specified data block
     unsigned short crc = 0;
     for (int i = 0; i < length; i++) {
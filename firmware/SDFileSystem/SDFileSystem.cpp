@@ -18,6 +18,9 @@
 #include "diskio.h"
 #include "pinmap.h"
 #include "SDCRC.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include "Metrics.h"
 
 SDFileSystem::SDFileSystem(PinName mosi, PinName miso, PinName sclk, PinName cs, const char* name, PinName cd, SwitchType cdtype, int hz)
     : FATFileSystem(name),
@@ -342,6 +345,8 @@ int SDFileSystem::disk_status()
 
 int SDFileSystem::disk_read(uint8_t* buffer, uint32_t sector, uint32_t count)
 {
+    TRACE_SCOPE_WIDE(sd_read, sector);
+
     //Make sure the card is initialized before proceeding
     if (m_Status & STA_NOINIT)
         return RES_NOTRDY;
@@ -356,6 +361,8 @@ int SDFileSystem::disk_read(uint8_t* buffer, uint32_t sector, uint32_t count)
 
 int SDFileSystem::disk_write(const uint8_t* buffer, uint32_t sector, uint32_t count)
 {
+    TRACE_SCOPE_WIDE(sd_write, sector);
+
     //Make sure the card is initialized before proceeding
     if (m_Status & STA_NOINIT)
         return RES_NOTRDY;
@@ -454,6 +461,8 @@ inline void SDFileSystem::checkSocket()
 
 inline bool SDFileSystem::waitReady(int timeout)
 {
+    PROF_ZONE(sd_wait);
+    TRACE_SCOPE(sd_busy, 0);
     char resp;
 
     //Keep sending dummy clocks with DI held high until the card releases the DO line
@@ -515,6 +524,10 @@ char SDFileSystem::writeCommand(char cmd, unsigned int arg, unsigned int* resp)
 
     //Try to send the command up to 3 times
     for (int f = 0; f < 3; f++) {
+        //Count the attempts after the first
+        if (f)
+            METRIC_INC(sd_retries);
+
         //Send CMD55(0x00000000) prior to an application specific command
         if (cmd == ACMD22 || cmd == ACMD23 || cmd == ACMD41 || cmd == ACMD42) {
             token = writeCommand(CMD55, 0x00000000);
@@ -588,6 +601,7 @@ char SDFileSystem::writeCommand(char cmd, unsigned int arg, unsigned int* resp)
 
 bool SDFileSystem::readData(char* buffer, int length)
 {
+    PROF_ZONE(sd_read);
     char token;
     unsigned short crc;
 
@@ -637,6 +651,7 @@ bool SDFileSystem::readData(char* buffer, int length)
 
 char SDFileSystem::writeData(const char* buffer, char token)
 {
+    PROF_ZONE(sd_write);
     //Calculate the CRC16 checksum for the data block (if enabled)
     unsigned short crc = (m_Crc) ? SDCRC::crc16(buffer, 512) : 0xFFFF;
 
@@ -679,6 +694,10 @@ inline bool SDFileSystem::readBlock(char* buffer, unsigned int lba)
 {
     //Try to read the block up to 3 times
     for (int f = 0; f < 3; f++) {
+        //Count the attempts after the first
+        if (f)
+            METRIC_INC(sd_retries);
+
         //Select the card, and wait for ready
         if(!select())
             break;
@@ -699,6 +718,7 @@ inline bool SDFileSystem::readBlock(char* buffer, unsigned int lba)
     }
 
     //The single block read failed
+    METRIC_INC(sd_errors);
     deselect();
     return false;
 }
@@ -707,6 +727,10 @@ inline bool SDFileSystem::readBlocks(char* buffer, unsigned int lba, unsigned in
 {
     //Try to read each block up to 3 times
     for (int f = 0; f < 3;) {
+        //Count the attempts after the first
+        if (f)
+            METRIC_INC(sd_retries);
+
         //Select the card, and wait for ready
         if(!select())
             break;
@@ -744,6 +768,7 @@ inline bool SDFileSystem::readBlocks(char* buffer, unsigned int lba, unsigned in
     }
 
     //The multiple block read failed
+    METRIC_INC(sd_errors);
     deselect();
     return false;
 }
@@ -752,6 +777,10 @@ inline bool SDFileSystem::writeBlock(const char* buffer, unsigned int lba)
 {
     //Try to write the block up to 3 times
     for (int f = 0; f < 3; f++) {
+        //Count the attempts after the first
+        if (f)
+            METRIC_INC(sd_retries);
+
         //Select the card, and wait for ready
         if(!select())
             break;
@@ -789,6 +818,7 @@ inline bool SDFileSystem::writeBlock(const char* buffer, unsigned int lba)
     }
 
     //The single block write failed
+    METRIC_INC(sd_errors);
     deselect();
     return false;
 }
@@ -802,6 +832,10 @@ inline bool SDFileSystem::writeBlocks(const char* buffer, unsigned int lba, unsi
 
     //Try to write each block up to 3 times
     for (int f = 0; f < 3;) {
+        //Count the attempts after the first
+        if (f)
+            METRIC_INC(sd_retries);
+
         //If this is an SD card, send ACMD23(count) to set the number of blocks to pre-erase
         if (m_CardType != CARD_MMC) {
             if (commandTransaction(ACMD23, currentCount) != 0x00) {
@@ -900,6 +934,7 @@ inline bool SDFileSystem::writeBlocks(const char* buffer, unsigned int lba, unsi
     }
 
     //The multiple block write failed
+    METRIC_INC(sd_errors);
     deselect();
     return false;
 }
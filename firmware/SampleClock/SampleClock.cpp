@@ -0,0 +1,253 @@
+/// @file SampleClock.cpp hardware timed sample trigger with hardware timestamps
+///
+#include <string.h>
+#include "SampleClock.h"
+#include "millis.h"
+#include "Metrics.h"
+
+static SampleClock *instance = NULL;
+
+static uint32_t isqrt(uint64_t v)
+{
+    uint64_t r = 0, bit = (uint64_t)1 << 62;
+    while (bit > v)
+        bit >>= 2;
+    while (bit) {
+        if (v >= r + bit) {
+            v -= r + bit;
+            r = (r >> 1) + bit;
+        } else
+            r >>= 1;
+        bit >>= 2;
+    }
+    return (uint32_t)r;
+}
+
+SampleClock::SampleClock() : _period(0), _stamp(0), _prev(0), _limit(0)
+{
+    resetStats();
+}
+
+void SampleClock::resetStats()
+{
+    __disable_irq();
+    _n = 0;
+    _sum = 0;
+    _sumsq = 0;
+    _intmin = INT32_MAX;
+    _intmax = INT32_MIN;
+    _latmin = UINT32_MAX;
+    _latmax = 0;
+    _prev = 0;
+    __enable_irq();
+    memset(&_dl, 0, sizeof(_dl));
+    _started = 0;
+    _done = 0;
+    _overran = false;
+    _execn = 0;
+    _exectotal = 0;
+}
+
+void SampleClock::deadlines(DEADLINE_T *stats)
+{
+    memcpy(stats, &_dl, sizeof(*stats));
+    stats->limit = _limit ? _limit : _period / 10;
+    stats->execavg = _execn ? (uint32_t)(_exectotal / _execn) : 0;
+}
+
+void SampleClock::stats(JITTER_T *stats)
+{
+    __disable_irq();
+    uint32_t n = _n;
+    int64_t sum = _sum;
+    uint64_t sumsq = _sumsq;
+    stats->samples = n;
+    stats->period = _period;
+    stats->intmin = _intmin;
+    stats->intmax = _intmax;
+    stats->latmin = _latmin;
+    stats->latmax = _latmax;
+    __enable_irq();
+    stats->intstd = 0;
+    if (n > 1) {                        // first sample has no interval
+        int64_t mean = sum / (n - 1);
+        uint64_t var = sumsq / (n - 1);
+        uint64_t m2 = (uint64_t)(mean * mean);
+        stats->intstd = (var > m2) ? isqrt(var - m2) : 0;
+    }
+}
+
+// account one trigger, stamp is the trigger time, now the time the callback runs
+void SampleClock::trigger(uint64_t stamp, uint64_t now)
+{
+    uint32_t lat = (uint32_t)(now - stamp);
+
+    _stamp = stamp;
+    if (_prev) {
+        int32_t d = (int32_t)(stamp - _prev) - (int32_t)_period;
+        _sum += d;
+        _sumsq += (int64_t)d * d;
+        if (d < _intmin)
+            _intmin = d;
+        if (d > _intmax)
+            _intmax = d;
+    }
+    _prev = stamp;
+    _n++;
+    if (lat < _latmin)
+        _latmin = lat;
+    if (lat > _latmax)
+        _latmax = lat;
+
+    if (_func)
+        _func();
+}
+
+void SampleClock::start(SAMPLETIME_T *t, uint64_t stamp)
+{
+    uint64_t now = micros64();
+    uint32_t limit = _limit ? _limit : _period / 10;
+
+    t->stamp = stamp;
+    t->latency = (uint32_t)(now - stamp);
+    t->status = 0;
+    if (t->latency > limit) {
+        t->status |= SAMPLE_LATE;
+        _dl.late++;
+    }
+    if (_started) {
+        // the previous sample is still in the works, or was done after this trigger
+        if (_done != _started || _overran)
+            t->status |= SAMPLE_OVERRUN;
+        int32_t d = (int32_t)(stamp - _started) - (int32_t)_period;
+        if (d > (int32_t)(_period / 2)) {
+            t->status |= SAMPLE_SKIPPED;    // whole periods passed without a sample
+            uint32_t lost = (d + _period / 2) / _period;
+            _dl.skipped += lost;
+            METRIC_ADD(ticks_skipped, lost);
+        }
+    }
+    _started = stamp;
+    _dl.ticks++;
+}
+
+void SampleClock::done(const SAMPLETIME_T *t)
+{
+    // deadline of a sample is the next trigger
+    uint64_t end = micros64();
+    uint32_t exec = (uint32_t)(end - t->stamp) - t->latency;
+    _execn++;
+    _exectotal += exec;
+    if (exec > _dl.execmax)
+        _dl.execmax = exec;
+    _done = t->stamp;
+    _overran = end > t->stamp + _period;
+    if (_overran)
+        _dl.overruns++;
+    if ((t->status & (SAMPLE_LATE | SAMPLE_SKIPPED)) || _overran) {
+        _dl.misses++;
+        if (++_dl.streak > _dl.maxstreak)
+            _dl.maxstreak = _dl.streak;
+    } else
+        _dl.streak = 0;
+}
+
+#if defined(TARGET_STM32F1)
+
+bool SampleClock::attach(Callback<void()> func, uint32_t period_us)
+{
+    uint32_t timclk = HAL_RCC_GetPCLK1Freq();
+    uint32_t prescale = period_us / 65536 + 1;
+
+    if (RCC->CFGR & RCC_CFGR_PPRE1_2)
+        timclk *= 2;                    // APB1 divided, the timers run at twice PCLK1
+    if (period_us == 0 || period_us > SAMPLECLOCK_MAX_US || (timclk / 1000000) * prescale > 65536)
+        return false;                   // PSC would wrap, the period would be wrong
+    detach();
+    _func = func;
+    _period = period_us;
+    resetStats();
+    instance = this;
+
+    // TIM4 is the us_ticker (CC1 and CC2 taken by mbed): capture on CC3 from
+    // the trigger input, ITR1 is TIM2 TRGO. Slave mode stays disabled.
+    TIM4->SMCR = (TIM4->SMCR & ~TIM_SMCR_TS) | TIM_SMCR_TS_0;                  // TS 001: ITR1
+    TIM4->CCER &= ~TIM_CCER_CC3E;
+    TIM4->CCMR2 = (TIM4->CCMR2 & ~(TIM_CCMR2_CC3S | TIM_CCMR2_IC3F | TIM_CCMR2_IC3PSC))
+                  | TIM_CCMR2_CC3S;     // CC3S 11: IC3 mapped on TRC
+    TIM4->CCER |= TIM_CCER_CC3E;
+
+    // TIM2: whole microseconds per count, as fine as the 16 bit counter allows
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    TIM2->CR1 = 0;
+    TIM2->PSC = (timclk / 1000000) * prescale - 1;
+    TIM2->ARR = period_us / prescale - 1;
+    _period = (period_us / prescale) * prescale;   // what the timer really does
+    TIM2->CR2 = TIM_CR2_MMS_1;          // MMS 010: update is TRGO
+    TIM2->EGR = TIM_EGR_UG;             // load PSC, the TIM4 capture this causes is never read
+    TIM2->SR = 0;
+    TIM2->DIER = TIM_DIER_UIE;
+    NVIC_SetVector(TIM2_IRQn, (uint32_t)&SampleClock::irq);
+    NVIC_EnableIRQ(TIM2_IRQn);
+    TIM2->CR1 = TIM_CR1_CEN;
+    return true;
+}
+
+void SampleClock::detach()
+{
+    TIM2->CR1 = 0;
+    TIM2->DIER = 0;
+    NVIC_DisableIRQ(TIM2_IRQn);
+    _func = NULL;
+}
+
+void SampleClock::tick()
+{
+    uint64_t now = micros64();
+    uint16_t now16 = (uint16_t)(now - microsSkipped());     // raw us_ticker low half is the TIM4 counter
+    uint16_t cap = TIM4->CCR3;
+    trigger(now - (uint16_t)(now16 - cap), now);
+}
+
+void SampleClock::irq()
+{
+    if (TIM2->SR & TIM_SR_UIF) {
+        TIM2->SR = ~TIM_SR_UIF;
+        if (instance)
+            instance->tick();
+    }
+}
+
+#else
+
+// no timer driver for this target: Ticker trigger, stamped when the callback runs
+bool SampleClock::attach(Callback<void()> func, uint32_t period_us)
+{
+    if (period_us == 0 || period_us > SAMPLECLOCK_MAX_US)
+        return false;                   // as the TIM2 driver
+    detach();
+    _func = func;
+    _period = period_us;
+    resetStats();
+    instance = this;
+    _ticker.attach_us(callback(this, &SampleClock::tick), period_us);
+    return true;
+}
+
+void SampleClock::detach()
+{
+    _ticker.detach();
+    _func = NULL;
+}
+
+void SampleClock::tick()
+{
+    uint64_t now = micros64();
+    trigger(now, now);
+}
+
+void SampleClock::irq()
+{
+}
+
+#endif
@@ -0,0 +1,168 @@
+/// @file SampleClock.h hardware timed sample trigger with hardware timestamps
+///
+/// TIM2 generates the sample period from the crystal, independent of any
+/// interrupt latency. Its update event is routed to the us_ticker timer
+/// (TIM4, ITR1) and latches the microsecond counter into TIM4 CCR3 at the
+/// same clock edge. The TIM2 interrupt then runs the sample callback, which
+/// may start late, but stamp() returns the latched, exact sample time on
+/// the micros64() timebase.
+///
+/// The statistics record the interval between consecutive stamps (the
+/// sample jitter, which the hardware keeps at 0..1 us) and the latency from
+/// the trigger to the callback (what a Ticker based sample time would have
+/// suffered).
+///
+/// Every sample is also checked against its deadline, the next trigger.
+/// The work on a sample need not run in the callback: whoever takes the
+/// sample calls start() with its stamp, whoever finishes it calls done().
+/// Work that starts late, runs past the next trigger or lets triggers pass
+/// unserved is counted, and flagged in the SAMPLE_ flags start() gives the
+/// sample. This proves whether a configured sample rate is achieved.
+///
+/// Supports:
+/// \li TARGET_STM32F1 (TIM2 trigger, TIM4 CC3 capture); other targets fall
+///     back to a Ticker and a software stamp
+///
+/// example:
+/// @code
+/// SampleClock sampler;
+///
+/// void onSample() {
+///     SAMPLETIME_T t;
+///     sampler.start(&t, sampler.stamp()); // us, hardware captured
+///     ...
+///     sampler.done(&t);
+/// }
+/// main() {
+///     sampler.attach(&onSample, 330000);  // every 330 ms
+///     ...
+/// }
+/// @endcode
+///
+#ifndef SAMPLECLOCK_H
+#define SAMPLECLOCK_H
+
+#include "mbed.h"
+
+/// Statistics of one run of the sample clock, all times in microseconds
+typedef struct {
+    uint32_t samples;       ///< number of samples triggered
+    uint32_t period;        ///< nominal interval
+    int32_t  intmin;        ///< shortest interval - period
+    int32_t  intmax;        ///< longest interval - period
+    uint32_t intstd;        ///< standard deviation of the interval
+    uint32_t latmin;        ///< shortest trigger to callback latency
+    uint32_t latmax;        ///< longest trigger to callback latency
+} JITTER_T;
+
+/// Longest sample period: TIM2 prescaler and counter, 16 bits each, at 72 MHz
+#define SAMPLECLOCK_MAX_US  59000000
+
+/// SAMPLE_ flags of a sample, set by start()
+#define SAMPLE_LATE     0x01    ///< work started later than the late limit after the trigger
+#define SAMPLE_SKIPPED  0x02    ///< triggers were lost since the previous sample
+#define SAMPLE_OVERRUN  0x04    ///< the work on the previous sample ran past this trigger
+
+/// Timing of the work on one sample, from start() to done()
+typedef struct {
+    uint64_t stamp;         ///< trigger time, micros64() timebase
+    uint32_t latency;       ///< trigger to start of the work, us
+    uint8_t  status;        ///< SAMPLE_ flags
+} SAMPLETIME_T;
+
+/// Deadline statistics, times in microseconds
+typedef struct {
+    uint32_t ticks;         ///< samples started
+    uint32_t late;          ///< samples started after the late limit
+    uint32_t skipped;       ///< triggers lost, no sample at all
+    uint32_t overruns;      ///< samples done after the next trigger
+    uint32_t misses;        ///< samples with any of the above
+    uint32_t streak;        ///< consecutive misses up to now
+    uint32_t maxstreak;     ///< longest run of consecutive misses
+    uint32_t limit;         ///< late limit
+    uint32_t execavg;       ///< average start to done time
+    uint32_t execmax;       ///< longest start to done time
+} DEADLINE_T;
+
+class SampleClock {
+public:
+    SampleClock();
+
+    /// Start sampling
+    ///
+    /// @param func is called from the timer interrupt at every sample
+    /// @param period_us is the sample interval in microseconds, 1 to SAMPLECLOCK_MAX_US
+    /// @returns false if the timer cannot make the period, nothing is started then
+    bool attach(Callback<void()> func, uint32_t period_us);
+
+    /// Stop sampling
+    void detach();
+
+    /// @returns the hardware captured time of the current sample, micros64() timebase
+    uint64_t stamp() const {
+        return _stamp;
+    }
+
+    /// Read the statistics since attach() or resetStats()
+    ///
+    /// @param stats receives the statistics
+    void stats(JITTER_T *stats);
+
+    /// Read the deadline statistics since attach() or resetStats()
+    ///
+    /// @param stats receives the statistics
+    void deadlines(DEADLINE_T *stats);
+
+    /// Start the work on a sample, from the task that takes it
+    ///
+    /// @param t receives the timing and the SAMPLE_ flags of the sample
+    /// @param stamp is the trigger time of the sample, stamp() in the callback
+    void start(SAMPLETIME_T *t, uint64_t stamp);
+
+    /// End the work on a sample started by start(), from the task that
+    /// finishes it; samples are done in the order they were started
+    ///
+    /// @param t is the timing start() filled
+    void done(const SAMPLETIME_T *t);
+
+    /// Set the start latency above which a tick counts as late
+    ///
+    /// @param limit_us is the limit, 0 for the default of 1/10 of the period
+    void setLateLimit(uint32_t limit_us) {
+        _limit = limit_us;
+    }
+
+    /// Restart the statistics
+    void resetStats();
+
+private:
+    void trigger(uint64_t stamp, uint64_t now);
+    void tick();
+    static void irq();
+
+    Callback<void()> _func;
+    uint32_t _period;
+    volatile uint64_t _stamp;
+    uint64_t _prev;
+    // interval deviation statistics, accumulated as integers
+    volatile uint32_t _n;
+    volatile int64_t  _sum;
+    volatile uint64_t _sumsq;
+    volatile int32_t  _intmin;
+    volatile int32_t  _intmax;
+    volatile uint32_t _latmin;
+    volatile uint32_t _latmax;
+    // deadline statistics, kept by start() and done() outside the interrupt
+    uint32_t _limit;
+    uint64_t _started;          // stamp of the latest sample started
+    uint64_t _done;             // stamp of the latest sample done
+    bool     _overran;          // that one was done after its deadline
+    DEADLINE_T _dl;
+    uint32_t _execn;
+    uint64_t _exectotal;
+#if !defined(TARGET_STM32F1)
+    Ticker _ticker;
+#endif
+};
+
+#endif // SAMPLECLOCK_H
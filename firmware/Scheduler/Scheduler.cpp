@@ -0,0 +1,126 @@
+/// @file Scheduler.cpp run-to-completion cooperative scheduler
+///
+#include "Scheduler.h"
+#include "millis.h"
+#include "Trace.h"
+
+Scheduler::Scheduler() : _count(0), _current(-1), _previous(-1), _ready(0), _stop(false), _start(0), _idle(0)
+{
+}
+
+int Scheduler::add(Callback<void()> func, uint8_t priority, const char *name)
+{
+    if (_count == SCHED_MAX_TASKS)
+        return -1;
+    task *t = &_task[_count];
+    t->func = func;
+    t->name = name;
+    t->priority = priority;
+    t->period = 0;
+    t->next = 0;
+    t->runs = 0;
+    t->longest = 0;
+    return _count++;
+}
+
+void Scheduler::post(int id)
+{
+    if (id < 0 || id >= _count)
+        return;
+    core_util_critical_section_enter();
+    _ready |= 1UL << id;
+    core_util_critical_section_exit();
+}
+
+void Scheduler::every(int id, uint32_t period_ms)
+{
+    if (id < 0 || id >= _count)
+        return;
+    _task[id].period = period_ms * 1000;
+    _task[id].next = period_ms ? micros64() + _task[id].period : 0;
+}
+
+void Scheduler::after(int id, uint32_t delay_ms)
+{
+    if (id < 0 || id >= _count)
+        return;
+    _task[id].period = 0;
+    _task[id].next = micros64() + (uint64_t)delay_ms * 1000;
+}
+
+uint64_t Scheduler::uptime() const
+{
+    return micros64() - _start;
+}
+
+void Scheduler::wake()
+{
+    // nothing to do, the interrupt alone ends the sleep
+}
+
+void Scheduler::run()
+{
+    _start = micros64();
+    _stop = false;
+    while (!_stop) {
+        uint64_t now = micros64();
+        uint64_t nearest = 0;
+        int pick = -1;
+
+        // timer events become ready tasks
+        for (int i = 0; i < _count; i++) {
+            task *t = &_task[i];
+            if (!t->next)
+                continue;
+            if (t->next <= now) {
+                post(i);
+                if (!t->period) {       // one shot
+                    t->next = 0;
+                    continue;
+                }
+                t->next += t->period;
+                if (t->next <= now)     // fell behind, do not try to catch up
+                    t->next = now + t->period;
+            }
+            if (!nearest || t->next < nearest)
+                nearest = t->next;
+        }
+
+        uint32_t ready = _ready;
+        for (int i = 0; i < _count; i++) {
+            if ((ready & (1UL << i)) && (pick < 0 || _task[i].priority < _task[pick].priority))
+                pick = i;
+        }
+
+        if (pick >= 0) {
+            task *t = &_task[pick];
+            core_util_critical_section_enter();
+            _ready &= ~(1UL << pick);
+            core_util_critical_section_exit();
+            _current = pick;
+            TRACE(task, pick);
+            t->func();
+            TRACE_END(task, pick);
+            _previous = pick;
+            _current = -1;
+            uint32_t took = (uint32_t)(micros64() - now);
+            t->runs++;
+            if (took > t->longest)
+                t->longest = took;
+            continue;
+        }
+
+        // nothing ready: sleep until an interrupt or the nearest timer event
+        core_util_critical_section_enter();
+        if (!_ready) {
+            if (!_idlehook || !_idlehook(nearest ? nearest - now : 0)) {
+                if (nearest)
+                    _wake.attach_us(callback(this, &Scheduler::wake), (timestamp_t)(nearest - now));
+                sleep();                // WFI, wakes on a pending interrupt even when masked
+            }
+            core_util_critical_section_exit();
+            _idle += micros64() - now;
+        } else
+            core_util_critical_section_exit();
+    }
+}
@@ -0,0 +1,152 @@
+/// @file Scheduler.h run-to-completion cooperative scheduler
+///
+/// Work is split into tasks: plain functions that do one piece of work and
+/// return. A task runs when it has been posted, either by an interrupt
+/// handler (post() is safe there) or by its own timer (every()). When more
+/// than one task is ready the one with the lowest priority number runs
+/// first, every task runs to completion before the next one is picked.
+///
+/// When nothing is ready the scheduler arms one Timeout for the nearest
+/// timer event and sleeps (WFI) until an interrupt arrives, so the core
+/// idles instead of spinning. An idle hook can replace that sleep, e.g.
+/// with Stop mode and a wakeup source that still runs there.
+///
+/// example:
+/// @code
+/// Scheduler sched;
+/// int blink;
+///
+/// void onBlink() { led = !led; }
+/// void onRx() { sched.post(blink); }      // from an interrupt
+///
+/// main() {
+///     blink = sched.add(&onBlink, 5);
+///     sched.every(blink, 500);
+///     sched.run();                        // until stop()
+/// }
+/// @endcode
+///
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "mbed.h"
+
+#ifndef SCHED_MAX_TASKS
+#define SCHED_MAX_TASKS 16
+#endif
+
+class Scheduler {
+public:
+    Scheduler();
+
+    /// Register a task
+    ///
+    /// @param func is the task body, it must return when its work is done
+    /// @param priority orders ready tasks, 0 runs first
+    /// @param name (optional) for the statistics
+    /// @returns the task id, or -1 if SCHED_MAX_TASKS are registered already
+    int add(Callback<void()> func, uint8_t priority, const char *name = "");
+
+    /// Mark a task ready, safe from interrupt handlers
+    ///
+    /// Posting a task that is ready already does nothing, it runs once.
+    ///
+    /// @param id is the task id
+    void post(int id);
+
+    /// Run a task periodically
+    ///
+    /// @param id is the task id
+    /// @param period_ms is the period, 0 stops the timer
+    void every(int id, uint32_t period_ms);
+
+    /// Run a task once after a delay, replaces a periodic timer of the task
+    ///
+    /// @param id is the task id
+    /// @param delay_ms is the delay
+    void after(int id, uint32_t delay_ms);
+
+    /// Replace the sleep between events
+    ///
+    /// The hook is called with interrupts masked when no task is ready. If
+    /// it sleeps it must return once an interrupt is pending, like sleep()
+    /// does, and wake by itself for the next timer event.
+    ///
+    /// @param hook gets the microseconds until the next timer event, 0 if
+    ///        none, and returns false to take the normal sleep instead
+    void onIdle(Callback<bool(uint64_t)> hook) {
+        _idlehook = hook;
+    }
+
+    /// Dispatch tasks and sleep in between until stop() is called
+    void run();
+
+    /// Make run() return after the running task
+    void stop() {
+        _stop = true;
+    }
+
+    /// @returns number of registered tasks
+    int count() const {
+        return _count;
+    }
+
+    /// @returns the name of task id
+    const char *name(int id) const {
+        return _task[id].name;
+    }
+
+    /// @returns id of the running task, -1 between tasks
+    int current() const {
+        return _current;
+    }
+
+    /// @returns id of the task that completed last, -1 if none did
+    int previous() const {
+        return _previous;
+    }
+
+    /// @returns number of times task id ran
+    uint32_t runs(int id) const {
+        return _task[id].runs;
+    }
+
+    /// @returns the longest run of task id in microseconds
+    uint32_t longest(int id) const {
+        return _task[id].longest;
+    }
+
+    /// @returns microseconds spent asleep since run() started
+    uint64_t idle() const {
+        return _idle;
+    }
+
+    /// @returns microseconds since run() started
+    uint64_t uptime() const;
+
+private:
+    void wake();
+
+    struct task {
+        Callback<void()> func;
+        const char *name;
+        uint8_t  priority;
+        uint32_t period;        // us, 0 if not periodic
+        uint64_t next;          // us, next timer event, 0 if none
+        uint32_t runs;
+        uint32_t longest;       // us
+    };
+
+    task _task[SCHED_MAX_TASKS];
+    int  _count;
+    volatile int _current;
+    volatile int _previous;
+    volatile uint32_t _ready;   // one bit per task id
+    volatile bool _stop;
+    uint64_t _start;
+    uint64_t _idle;
+    Timeout  _wake;
+    Callback<bool(uint64_t)> _idlehook;
+};
+
+#endif // SCHEDULER_H
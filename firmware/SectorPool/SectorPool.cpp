@@ -0,0 +1,75 @@
+/// @file SectorPool.cpp shared sector buffers
+///
+#include <stddef.h>
+#include "SectorPool.h"
+
+static union {
+    char bytes[SECTORPOOL_SECTORS * SECTORPOOL_SECTOR];
+    uint32_t align;
+} pool;
+static uint8_t run[SECTORPOOL_SECTORS];     // length of the run starting at a sector, 0 if none
+static uint8_t refs[SECTORPOOL_SECTORS];    // holders of that run
+static bool    busy[SECTORPOOL_SECTORS];    // sector belongs to a run
+static int     nfree = SECTORPOOL_SECTORS;
+static int     lowwater = SECTORPOOL_SECTORS;
+
+// the run starting at buf, -1 if buf is not the start of one
+static int find(const char *buf)
+{
+    if (buf < pool.bytes || buf >= pool.bytes + sizeof(pool.bytes))
+        return -1;
+    int i = (buf - pool.bytes) / SECTORPOOL_SECTOR;
+    return run[i] && buf == pool.bytes + i * SECTORPOOL_SECTOR ? i : -1;
+}
+
+char *SectorPool_Get(int sectors)
+{
+    if (sectors <= 0)
+        return NULL;
+    for (int i = 0; i + sectors <= SECTORPOOL_SECTORS; i++) {
+        int n = 0;
+        while (n < sectors && !busy[i + n])
+            n++;
+        if (n < sectors) {
+            i += n;                 // the sector after it is busy
+            continue;
+        }
+        for (n = 0; n < sectors; n++)
+            busy[i + n] = true;
+        run[i] = sectors;
+        refs[i] = 1;
+        nfree -= sectors;
+        if (nfree < lowwater)
+            lowwater = nfree;
+        return pool.bytes + i * SECTORPOOL_SECTOR;
+    }
+    return NULL;
+}
+
+void SectorPool_Hold(char *buf)
+{
+    int i = find(buf);
+    if (i >= 0)
+        refs[i]++;
+}
+
+void SectorPool_Release(char *buf)
+{
+    int i = find(buf);
+    if (i < 0 || --refs[i])
+        return;
+    for (int n = 0; n < run[i]; n++)
+        busy[i + n] = false;
+    nfree += run[i];
+    run[i] = 0;
+}
+
+int SectorPool_Free(void)
+{
+    return nfree;
+}
+
+int SectorPool_LowWater(void)
+{
+    return lowwater;
+}
@@ -0,0 +1,62 @@
+/// @file SectorPool.h shared sector buffers
+///
+/// Several parts of the logger need a sector sized buffer, but only some of
+/// the time and not all at once: the stdio buffer of an open file, the
+/// compressed block and the low power batch of the logger, the transfer
+/// buffer of Bench. Which of them are in use depends on the mode, so they
+/// share SECTORPOOL_SECTORS buffers instead of each keeping its own.
+///
+/// Buffers are handed out as runs of contiguous sectors and are reference
+/// counted: SectorPool_Get() returns a run held once, SectorPool_Hold()
+/// adds a holder and SectorPool_Release() drops one, the sectors return to
+/// the pool with the last holder. The pool is for the task level, not for
+/// interrupt handlers.
+///
+/// The card itself needs no buffer from the pool: FatFs runs with _FS_TINY,
+/// its files share the sector window of the volume.
+///
+/// example:
+/// @code
+/// FILE *fp = fopen("/sd/x.csv", "r");
+/// char *iob = SectorPool_Get(1);
+/// setvbuf(fp, iob, iob ? _IOFBF : _IONBF, SECTORPOOL_SECTOR);
+/// ...
+/// fclose(fp);
+/// SectorPool_Release(iob);
+/// @endcode
+///
+#ifndef SECTORPOOL_H
+#define SECTORPOOL_H
+
+#include <stdint.h>
+
+#define SECTORPOOL_SECTOR       512     ///< bytes per sector, as the card's
+
+#ifndef SECTORPOOL_SECTORS
+#define SECTORPOOL_SECTORS      3       ///< two for a low power batch and one for a command's file
+#endif
+
+/// Take a run of sectors
+///
+/// @param sectors is the run length
+/// @returns the buffer, 4 byte aligned and held once, or NULL if no run
+///          that long is free
+char *SectorPool_Get(int sectors);
+
+/// Add a holder to a buffer from SectorPool_Get()
+///
+/// @param buf is the buffer
+void SectorPool_Hold(char *buf);
+
+/// Drop a holder, the last returns the sectors to the pool
+///
+/// @param buf is the buffer, NULL is ignored
+void SectorPool_Release(char *buf);
+
+/// @returns sectors free now
+int SectorPool_Free(void);
+
+/// @returns fewest sectors free since power up
+int SectorPool_LowWater(void);
+
+#endif // SECTORPOOL_H
@@ -0,0 +1,232 @@
+/// @file Supervisor.cpp task heartbeats in front of the watchdog, with crash breadcrumbs
+///
+#include <string.h>
+#include "Supervisor.h"
+#include "millis.h"
+#include "Metrics.h"
+
+static Supervisor *instance = NULL;
+
+int Supervisor::watch(const char *name, uint32_t deadline_ms)
+{
+    if (_count == SUPV_MAX_WATCH)
+        return -1;
+    heartbeat *h = &_hb[_count];
+    h->name = name;
+    h->deadline = deadline_ms;
+    h->last = millis();
+    h->worst = 0;
+    h->misses = 0;
+    h->active = true;
+    return _count++;
+}
+
+void Supervisor::beat(int id)
+{
+    if (id < 0 || id >= _count)
+        return;
+    uint32_t now = millis();
+    uint32_t gap = now - _hb[id].last;
+    if (_hb[id].active && gap > _hb[id].worst)
+        _hb[id].worst = gap;
+    _hb[id].last = now;
+}
+
+void Supervisor::pause(int id)
+{
+    if (id >= 0 && id < _count)
+        _hb[id].active = false;
+}
+
+void Supervisor::resume(int id, uint32_t deadline_ms)
+{
+    if (id < 0 || id >= _count)
+        return;
+    if (deadline_ms)
+        _hb[id].deadline = deadline_ms;
+    _hb[id].last = millis();
+    _hb[id].active = true;
+}
+
+uint32_t Supervisor::age(int id) const
+{
+    return millis() - _hb[id].last;
+}
+
+bool Supervisor::lastCrash(CRUMB_T *crumb)
+{
+    memcpy(crumb, &_crumb, sizeof(*crumb));
+    return _crashed;
+}
+
+// Runs every SUPV_TICK_MS above all other interrupts, frame is the
+// exception stack frame of whatever it interrupted
+void Supervisor::check(const uint32_t *frame)
+{
+    uint32_t now = millis();
+    uint16_t late = 0;
+
+    for (int i = 0; i < _count; i++) {
+        heartbeat *h = &_hb[i];
+        if (h->active && now - h->last > h->deadline)
+            late |= 1 << i;
+    }
+    if (late) {
+        if (late & ~_late) {            // a new stall, the first look is the one that matters
+            for (int i = 0; i < _count; i++) {
+                if (late & ~_late & (1 << i))
+                    _hb[i].misses++;
+            }
+            record(late, frame);
+        } else
+            record(late, NULL);
+        _late = late;
+        return;                         // no food: the watchdog resets unless they catch up
+    }
+    record(0, NULL);
+    if (_late) {
+        _recovered++;
+        METRIC_INC(wdt_near_misses);
+    }
+    _late = 0;
+    _wdt.Service();
+}
+
+#if defined(TARGET_STM32F1)
+
+// Backup registers, 16 bit each, kept over a reset while VDD or VBAT holds
+#define CRUMB_MAGIC     0x5356
+#define BKP_MAGIC       BKP->DR1
+#define BKP_REASON      BKP->DR2        // reason | exception << 8
+#define BKP_LATE        BKP->DR3
+#define BKP_TASKS       BKP->DR4        // task | previous task << 8
+#define BKP_PC_LO       BKP->DR5
+#define BKP_PC_HI       BKP->DR6
+#define BKP_UP_LO       BKP->DR7
+#define BKP_UP_HI       BKP->DR8
+#define BKP_RESETS      BKP->DR9
+#define BKP_RECOVERED   BKP->DR10
+
+extern "C" void supervisor_check(const uint32_t *frame)
+{
+    if (instance)
+        instance->check(frame);
+}
+
+// SysTick: hand the stack frame of the interrupted code to the check
+extern "C" __attribute__((naked)) void supervisor_irq(void)
+{
+    __asm volatile(
+        "tst   lr, #4           \n"     // EXC_RETURN bit 2: which stack was in use
+        "ite   eq               \n"
+        "mrseq r0, msp          \n"
+        "mrsne r0, psp          \n"
+        "b     supervisor_check \n");
+}
+
+Supervisor::Supervisor(Watchdog &wdt) : _wdt(wdt), _count(0), _sched(NULL), _late(0), _recovered(0)
+{
+    __HAL_RCC_PWR_CLK_ENABLE();
+    __HAL_RCC_BKP_CLK_ENABLE();
+    PWR->CR |= PWR_CR_DBP;              // backup domain writable
+
+    memset(&_crumb, 0, sizeof(_crumb));
+    _crashed = wdt.WatchdogCausedReset();
+    if (BKP_MAGIC != CRUMB_MAGIC) {     // backup domain lost its power
+        BKP_RESETS = 0;
+        BKP_RECOVERED = 0;
+        BKP_MAGIC = CRUMB_MAGIC;
+    } else {
+        _crumb.reason = BKP_REASON & 0xFF;
+        _crumb.exception = BKP_REASON >> 8;
+        _crumb.late = BKP_LATE;
+        _crumb.task = BKP_TASKS & 0xFF;
+        _crumb.prevtask = BKP_TASKS >> 8;
+        _crumb.pc = ((uint32_t)BKP_PC_HI << 16) | BKP_PC_LO;
+        _crumb.uptime = ((uint32_t)BKP_UP_HI << 16) | BKP_UP_LO;
+    }
+    if (_crashed)
+        BKP_RESETS = BKP_RESETS + 1;
+    _crumb.resets = BKP_RESETS;
+    _crumb.recovered = BKP_RECOVERED;
+    BKP_REASON = CRUMB_NONE;
+    BKP_LATE = 0;
+    BKP_TASKS = (CRUMB_NO_TASK << 8) | CRUMB_NO_TASK;
+    BKP_PC_LO = 0;
+    BKP_PC_HI = 0;
+}
+
+// keep the breadcrumb current, frame is given when a new stall is recorded
+void Supervisor::record(uint16_t late, const uint32_t *frame)
+{
+    uint32_t up = millis() / 1000;
+    uint8_t task = CRUMB_NO_TASK, prev = CRUMB_NO_TASK;
+    if (_sched) {
+        if (_sched->current() >= 0)
+            task = _sched->current();
+        if (_sched->previous() >= 0)
+            prev = _sched->previous();
+    }
+    BKP_TASKS = (prev << 8) | task;
+    BKP_UP_LO = up & 0xFFFF;
+    BKP_UP_HI = up >> 16;
+    if (frame) {
+        BKP_PC_LO = frame[6] & 0xFFFF;  // r0 r1 r2 r3 r12 lr pc xpsr
+        BKP_PC_HI = frame[6] >> 16;
+        BKP_REASON = CRUMB_STALL | ((frame[7] & 0xFF) << 8);    // IPSR of the interrupted code
+        BKP_LATE = late;
+    } else if (!late && _late) {        // caught up in time
+        BKP_RECOVERED = BKP_RECOVERED + 1;
+        BKP_REASON = CRUMB_NONE;
+        BKP_LATE = 0;
+    }
+}
+
+void Supervisor::begin(float timeout)
+{
+    instance = this;
+    _wdt.Configure(timeout);
+
+    // the check must be able to interrupt every other handler
+    for (int irq = WWDG_IRQn; irq <= USBWakeUp_IRQn; irq++)
+        NVIC_SetPriority((IRQn_Type)irq, 1);
+    NVIC_SetPriority(SysTick_IRQn, 0);
+    NVIC_SetVector(SysTick_IRQn, (uint32_t)&supervisor_irq);
+    SysTick->LOAD = SystemCoreClock / 8 / 1000 * SUPV_TICK_MS - 1;     // HCLK/8, 24 bit: up to 1.8 s at 72 MHz
+    SysTick->VAL = 0;
+    SysTick->CTRL = SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+}
+
+#else
+
+// no backup registers or SysTick hook for this target: the breadcrumb lives in RAM
+Supervisor::Supervisor(Watchdog &wdt) : _wdt(wdt), _count(0), _sched(NULL), _late(0), _recovered(0)
+{
+    memset(&_crumb, 0, sizeof(_crumb));
+    _crashed = wdt.WatchdogCausedReset();
+}
+
+void Supervisor::record(uint16_t late, const uint32_t *frame)
+{
+    _crumb.uptime = millis() / 1000;
+    _crumb.task = _sched && _sched->current() >= 0 ? _sched->current() : CRUMB_NO_TASK;
+    _crumb.prevtask = _sched && _sched->previous() >= 0 ? _sched->previous() : CRUMB_NO_TASK;
+    if (late) {
+        _crumb.reason = CRUMB_STALL;
+        _crumb.late = late;
+    }
+}
+
+void Supervisor::tick()
+{
+    check(NULL);
+}
+
+void Supervisor::begin(float timeout)
+{
+    instance = this;
+    _wdt.Configure(timeout);
+    _ticker.attach_us(callback(this, &Supervisor::tick), SUPV_TICK_MS * 1000);
+}
+
+#endif
@@ -0,0 +1,191 @@
+/// @file Supervisor.h task heartbeats in front of the watchdog, with crash breadcrumbs
+///
+/// Feeding the watchdog from one place only proves that this one place
+/// still runs. The supervisor instead watches a heartbeat per task, each
+/// with its own deadline, and feeds the independent watchdog only while
+/// every active heartbeat is on time. A task that hangs, or never gets its
+/// turn, therefore ends in a watchdog reset even if the rest still runs.
+///
+/// The check runs in the SysTick interrupt, at a priority above all other
+/// interrupts, so a stall inside a task or an interrupt handler is caught
+/// as well. When a heartbeat misses its deadline the supervisor writes a
+/// breadcrumb to the backup registers: the late heartbeats, the scheduler
+/// task that was running, the PC and exception number the SysTick
+/// interrupted, and the uptime. The registers keep their contents over the
+/// reset, lastCrash() reports them at the next boot. If the late task
+/// catches up before the watchdog expires, feeding resumes and the event is
+/// counted as recovered.
+///
+/// A hang with interrupts disabled stops the check itself. The watchdog
+/// still resets, the breadcrumb then holds the task and uptime of the last
+/// check but no stall record.
+///
+/// Supports:
+/// \li TARGET_STM32F1 (SysTick check, BKP_DR1..10 breadcrumbs); other
+///     targets check from a Ticker and keep the breadcrumb in RAM only
+///
+/// example:
+/// @code
+/// Watchdog wdt;
+/// Supervisor sup(wdt);
+/// int hbSampler;
+///
+/// void samplerTask() {
+///     sup.beat(hbSampler);
+///     ...
+/// }
+/// main() {
+///     CRUMB_T c;
+///     if (sup.lastCrash(&c))
+///         printf("stalled: %04X pc %08lX\r\n", c.late, c.pc);
+///     hbSampler = sup.watch("sampler", 2000);
+///     sup.begin(10.0);
+///     ...
+/// }
+/// @endcode
+///
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "mbed.h"
+#include "Watchdog.h"
+#include "Scheduler.h"
+
+#ifndef SUPV_MAX_WATCH
+#define SUPV_MAX_WATCH  8
+#endif
+#define SUPV_TICK_MS    250     ///< heartbeat check interval
+
+/// Breadcrumb reasons
+#define CRUMB_NONE      0       ///< nothing was late at the last check
+#define CRUMB_STALL     1       ///< heartbeats missed their deadline
+
+#define CRUMB_NO_TASK   0xFF    ///< no scheduler task was running
+
+/// The breadcrumb of the previous run
+typedef struct {
+    uint8_t  reason;            ///< CRUMB_NONE or CRUMB_STALL
+    uint8_t  exception;         ///< exception number interrupted at the stall, 0 in thread mode
+    uint16_t late;              ///< one bit per heartbeat id that was late
+    uint8_t  task;              ///< scheduler task running at the last check
+    uint8_t  prevtask;          ///< scheduler task that ran before it
+    uint32_t pc;                ///< program counter interrupted at the stall
+    uint32_t uptime;            ///< seconds since boot at the last check
+    uint16_t resets;            ///< watchdog resets counted since the backup domain was powered
+    uint16_t recovered;         ///< stalls that caught up before the reset
+} CRUMB_T;
+
+class Supervisor {
+public:
+    /// @param wdt is the watchdog to feed
+    Supervisor(Watchdog &wdt);
+
+    /// Register a heartbeat, it starts active with a fresh beat
+    ///
+    /// @param name for the report
+    /// @param deadline_ms is the longest allowed time between two beats
+    /// @returns the heartbeat id, or -1 if SUPV_MAX_WATCH are registered already
+    int watch(const char *name, uint32_t deadline_ms);
+
+    /// Signal that the task is alive, safe from interrupt handlers
+    ///
+    /// @param id is the heartbeat id
+    void beat(int id);
+
+    /// Stop checking a heartbeat, for a task that is idle on purpose
+    ///
+    /// @param id is the heartbeat id
+    void pause(int id);
+
+    /// Check a heartbeat again, starting with a fresh beat
+    ///
+    /// @param id is the heartbeat id
+    /// @param deadline_ms (optional) replaces the deadline, 0 keeps it
+    void resume(int id, uint32_t deadline_ms = 0);
+
+    /// Report the running scheduler task in the breadcrumbs
+    ///
+    /// @param sched is the scheduler
+    void track(const Scheduler *sched) {
+        _sched = sched;
+    }
+
+    /// Start the watchdog and the heartbeat check
+    ///
+    /// @param timeout is the watchdog timeout in seconds
+    void begin(float timeout);
+
+    /// Read the breadcrumb left by the previous run
+    ///
+    /// @param crumb receives the breadcrumb
+    /// @returns true if the previous run ended in a watchdog reset
+    bool lastCrash(CRUMB_T *crumb);
+
+    /// @returns number of registered heartbeats
+    int count() const {
+        return _count;
+    }
+
+    /// @returns the name of heartbeat id
+    const char *name(int id) const {
+        return _hb[id].name;
+    }
+
+    /// @returns the deadline of heartbeat id in ms
+    uint32_t deadline(int id) const {
+        return _hb[id].deadline;
+    }
+
+    /// @returns true if heartbeat id is checked
+    bool active(int id) const {
+        return _hb[id].active;
+    }
+
+    /// @returns ms since the last beat of heartbeat id
+    uint32_t age(int id) const;
+
+    /// @returns the longest time between two beats of heartbeat id in ms
+    uint32_t worst(int id) const {
+        return _hb[id].worst;
+    }
+
+    /// @returns number of times heartbeat id missed its deadline
+    uint32_t misses(int id) const {
+        return _hb[id].misses;
+    }
+
+    /// @returns stalls this run that caught up before the reset
+    uint32_t recovered() const {
+        return _recovered;
+    }
+
+    /// Called by the check interrupt, not for the application
+    void check(const uint32_t *frame);
+
+private:
+    void record(uint16_t late, const uint32_t *frame);
+
+    struct heartbeat {
+        const char *name;
+        uint32_t deadline;          // ms
+        volatile uint32_t last;     // millis() of the last beat
+        volatile bool active;
+        uint32_t worst;             // ms
+        uint32_t misses;
+    };
+
+    Watchdog &_wdt;
+    heartbeat _hb[SUPV_MAX_WATCH];
+    int       _count;
+    const Scheduler *_sched;
+    uint16_t  _late;                // heartbeats late at the last check
+    uint32_t  _recovered;
+    bool      _crashed;             // the previous run ended in a watchdog reset
+    CRUMB_T   _crumb;               // what it left behind
+#if !defined(TARGET_STM32F1)
+    Ticker _ticker;
+    void tick();
+#endif
+};
+
+#endif // SUPERVISOR_H
@@ -0,0 +1,111 @@
+/// @file Trace.cpp binary event trace in a RAM ring
+///
+#include <string.h>
+#include "Trace.h"
+
+TRACE_REC trace_ring[TRACE_RECORDS];
+volatile uint32_t trace_head = 0;
+volatile uint32_t trace_mask = 0;
+#if defined(TARGET_HOST)
+void (*trace_hook)(uint16_t id, uint16_t arg) = NULL;
+#endif
+
+#define TRACE_NAME(name, span, on) #name,
+static const char *const names[TRACE_COUNT] = {
+    TRACE_EVENTS(TRACE_NAME)
+};
+#undef TRACE_NAME
+
+#define TRACE_DEFAULT(name, span, on) | ((uint32_t)(on) << TR_##name)
+static const uint32_t defaults = 0 TRACE_EVENTS(TRACE_DEFAULT);
+#undef TRACE_DEFAULT
+
+void Trace_Init(void)
+{
+    Trace_Clear();
+    trace_mask = defaults;
+}
+
+void Trace_Clear(void)
+{
+    core_util_critical_section_enter();
+    trace_head = 0;
+    memset(trace_ring, 0, sizeof(trace_ring));
+    core_util_critical_section_exit();
+}
+
+void Trace_Enable(uint32_t mask, bool on)
+{
+    core_util_critical_section_enter();
+    if (on)
+        trace_mask |= mask;
+    else
+        trace_mask &= ~mask;
+    core_util_critical_section_exit();
+}
+
+uint32_t Trace_Mask(void)
+{
+    return trace_mask;
+}
+
+uint32_t Trace_Recorded(void)
+{
+    return trace_head;
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_u32(uint8_t *p, uint32_t v)
+{
+    put_u16(p, v & 0xFFFF);
+    put_u16(p + 2, v >> 16);
+}
+
+int Trace_Dump(void (*put)(const void *data, int len))
+{
+    // pause, so the ring does not move under the dump
+    core_util_critical_section_enter();
+    uint32_t mask = trace_mask;
+    trace_mask = 0;
+    uint32_t head = trace_head;
+    core_util_critical_section_exit();
+
+    uint32_t n = head < TRACE_RECORDS ? head : TRACE_RECORDS;
+    uint8_t hdr[TRACE_HEADER_SIZE];
+    memcpy(hdr, TRACE_MAGIC, 4);
+    put_u16(hdr + 4, n);
+    put_u16(hdr + 6, mask & 0xFFFF);
+    put_u32(hdr + 8, Prof_Hz());
+    put_u32(hdr + 12, head);
+    put(hdr, sizeof(hdr));
+    for (uint32_t i = head - n; i != head; i++) {
+        const TRACE_REC *r = &trace_ring[i & (TRACE_RECORDS - 1)];
+        uint8_t rec[sizeof(TRACE_REC)];
+        put_u32(rec, r->cycles);
+        put_u16(rec + 4, r->id);
+        put_u16(rec + 6, r->arg);
+        put(rec, sizeof(rec));
+    }
+
+    Trace_Enable(mask, true);
+    return n;
+}
+
+const char *Trace_Name(int id)
+{
+    return names[id];
+}
+
+int Trace_Find(const char *name)
+{
+    for (int i = 0; i < TRACE_COUNT; i++) {
+        if (!strcmp(name, names[i]))
+            return i;
+    }
+    return -1;
+}
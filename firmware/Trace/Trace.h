@@ -0,0 +1,158 @@
+/// @file Trace.h binary event trace in a RAM ring
+///
+/// The profiler tells how long things take on average, the trace tells in
+/// which order they happened around one particular stall: tick fired,
+/// conversion started, card busy, sync, console line out. TRACE() writes
+/// an 8 byte record (cycle counter, event id, argument) into a ring of
+/// TRACE_RECORDS, the oldest records are overwritten.
+///
+/// Writing is lock free and safe from interrupt handlers: the slot is
+/// claimed with one atomic increment (LDREX/STREX), then filled. An event
+/// costs about 20 cycles, or a load and a test when it is masked off, so
+/// the trace stays in production builds. Build with TRACE_ENABLE 0 to
+/// compile it out.
+///
+/// Trace_Dump() writes the ring in the layout of TraceFormat.h, the host
+/// tool trace2json turns that into Chrome trace-event JSON
+/// (chrome://tracing, ui.perfetto.dev). The timestamps come from
+/// Trace_Clock(), Prof_Init() must run first.
+///
+/// In the host build trace_hook, when set, sees every enabled event as it
+/// is recorded; the logging benchmark follows the run this way.
+///
+/// example:
+/// @code
+/// bool SDFileSystem::waitReady(int timeout)
+/// {
+///     TRACE_SCOPE(sd_busy, 0);
+///     ...
+/// }
+/// void onSerialRx()
+/// {
+///     TRACE(rx, n);
+/// }
+/// @endcode
+///
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "mbed.h"
+#include "Profiler.h"
+#include "TraceFormat.h"
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE    1
+#endif
+
+#ifndef TRACE_RECORDS
+#define TRACE_RECORDS   128     ///< ring size, a power of 2, 8 bytes each
+#endif
+
+extern TRACE_REC trace_ring[TRACE_RECORDS];
+extern volatile uint32_t trace_head;    // events recorded, the next slot modulo TRACE_RECORDS
+extern volatile uint32_t trace_mask;    // one bit per enabled TR_ event
+#if defined(TARGET_HOST)
+extern void (*trace_hook)(uint16_t id, uint16_t arg);
+#endif
+
+/// @returns the timestamp of an event: Prof_Cycles(), in the host build the
+/// nanoseconds of the virtual clock, so the trace shows the time the
+/// simulated card and bus take
+static inline uint32_t Trace_Clock(void)
+{
+#if defined(TARGET_HOST)
+    return (uint32_t)Sim_Nanos();
+#else
+    return Prof_Cycles();
+#endif
+}
+
+/// Record an event, safe from interrupt handlers
+///
+/// @param id is a TR_ event, with TRACE_END_BIT for the end of a span
+/// @param arg is the event argument
+static inline void Trace_Event(uint16_t id, uint16_t arg)
+{
+    if (!(trace_mask & (1UL << (id & ~TRACE_END_BIT))))
+        return;
+    TRACE_REC *r = &trace_ring[__sync_fetch_and_add(&trace_head, 1) & (TRACE_RECORDS - 1)];
+    r->cycles = Trace_Clock();
+    r->id = id;
+    r->arg = arg;
+#if defined(TARGET_HOST)
+    if (trace_hook)
+        trace_hook(id, arg);
+#endif
+}
+
+/// Empty the ring and enable the default events
+void Trace_Init(void);
+
+/// Empty the ring
+void Trace_Clear(void);
+
+/// Enable or disable events
+///
+/// @param mask has one bit per TR_ event
+/// @param on enables the events in mask, false disables them
+void Trace_Enable(uint32_t mask, bool on);
+
+/// @returns the enabled events, one bit per TR_ event
+uint32_t Trace_Mask(void);
+
+/// @returns events recorded since the last clear
+uint32_t Trace_Recorded(void);
+
+/// Write the ring, oldest record first, tracing pauses meanwhile
+///
+/// @param put is called with consecutive pieces of the dump
+/// @returns the number of records written
+int Trace_Dump(void (*put)(const void *data, int len));
+
+/// @returns the name of a TR_ event
+const char *Trace_Name(int id);
+
+/// @returns the TR_ event of a name, -1 if there is none
+int Trace_Find(const char *name);
+
+/// Records the begin and the end of the enclosing scope, use TRACE_SCOPE()
+class TraceScope {
+public:
+    TraceScope(uint16_t id, uint16_t arg) : _id(id), _arg(arg) {
+        Trace_Event(id, arg);
+    }
+    ~TraceScope() {
+        Trace_Event(_id | TRACE_END_BIT, _arg);
+    }
+private:
+    uint16_t _id;
+    uint16_t _arg;
+};
+
+/// TraceScope of a wide span event, use TRACE_SCOPE_WIDE()
+class TraceScopeWide {
+public:
+    TraceScopeWide(uint16_t id, uint32_t arg) : _id(id), _high((uint16_t)(arg >> 16)) {
+        Trace_Event(id, (uint16_t)arg);
+    }
+    ~TraceScopeWide() {
+        Trace_Event(_id | TRACE_END_BIT, _high);
+    }
+private:
+    uint16_t _id;
+    uint16_t _high;
+};
+
+#if TRACE_ENABLE
+#define TRACE(ev, arg)          Trace_Event(TR_##ev, (uint16_t)(arg))
+#define TRACE_END(ev, arg)      Trace_Event(TR_##ev | TRACE_END_BIT, (uint16_t)(arg))
+#define TRACE_SCOPE(ev, arg)    TraceScope trace_scope_##ev(TR_##ev, (uint16_t)(arg))
+#define TRACE_SCOPE_WIDE(ev, arg) TraceScopeWide trace_scope_##ev(TR_##ev, (uint32_t)(arg))
+#else
+#define TRACE(ev, arg)
+#define TRACE_END(ev, arg)
+#define TRACE_SCOPE(ev, arg)
+#define TRACE_SCOPE_WIDE(ev, arg)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,69 @@
+/// @file TraceFormat.h event ids and dump layout of the binary event trace
+///
+/// A trace record is 8 bytes: the cycle counter when the event happened,
+/// the event id and one argument. Events that take time are recorded twice,
+/// at the begin and, with TRACE_END_BIT set in the id, at the end.
+///
+/// Dump layout (all multi-byte fields little endian):
+/// @verbatim
+/// offset  size  field
+///   0      4    magic 'T','R','C','1'
+///   4      2    number of records that follow
+///   6      2    enabled event mask at the dump (low 16 bits)
+///   8      4    counter units per second
+///  12      4    events recorded since the last clear, older ones are overwritten
+///  16    8*n    records, oldest first
+/// @endverbatim
+///
+/// The counter is 32 bit and wraps (every 59.6 s at 72 MHz), the decoder
+/// unwraps it assuming that consecutive records are closer than half a
+/// wrap, either way: an interrupt between the slot and the counter read of
+/// an event records it a little out of order.
+/// The counter stands still in Stop mode, the end record of 'stop' carries
+/// the ms slept.
+///
+/// This file has no mbed dependency so the host tools can share it.
+///
+#ifndef TRACEFORMAT_H
+#define TRACEFORMAT_H
+
+#include <stdint.h>
+
+#define TRACE_MAGIC         "TRC1"
+#define TRACE_HEADER_SIZE   16
+#define TRACE_END_BIT       0x8000  ///< id flag of the end record of a span
+
+/// The events, X(name, span, enabled) for each instrumented place; span
+/// events, 1, have a begin and an end record, wide span events, 2, carry a
+/// 32 bit argument, its low half in the begin and its high half in the end
+/// record; enabled gives the default mask
+#define TRACE_EVENTS(X)         \
+    X(tick,      0, 1)  /* sample taken, arg SAMPLE_ flags */      \
+    X(task,      1, 1)  /* scheduler task run, arg task id */      \
+    X(conv,      0, 1)  /* DS18B20 conversions started */          \
+    X(conv_done, 0, 1)  /* conversions read, arg probes */         \
+    X(sd_busy,   1, 1)  /* waiting for the card to be ready */     \
+    X(sd_read,   2, 1)  /* sector read, arg sector */              \
+    X(sd_write,  2, 1)  /* sector write, arg sector */             \
+    X(sync,      1, 1)  /* f_sync, cached data to the card */      \
+    X(rx,        0, 1)  /* serial receive interrupt, arg bytes */  \
+    X(console,   1, 1)  /* console line sent, arg bytes */         \
+    X(adc,       1, 0)  /* ADC DMA half buffer, 64 per second */   \
+    X(stop,      1, 1)  /* Stop mode, end arg ms slept */          \
+    X(log,       1, 1)  /* log record written, arg format */
+
+#define TRACE_ENUM(name, span, on) TR_##name,
+enum {
+    TRACE_EVENTS(TRACE_ENUM)
+    TRACE_COUNT
+};
+#undef TRACE_ENUM
+
+/// One event
+typedef struct {
+    uint32_t cycles;            ///< cycle counter
+    uint16_t id;                ///< TR_ event, TRACE_END_BIT for the end of a span
+    uint16_t arg;               ///< event argument
+} TRACE_REC;
+
+#endif // TRACEFORMAT_H
@@ -121,4 +121,39 @@ bool Watchdog::WatchdogCausedReset() {
     }
     return wdreset;
 }
+#elif defined( TARGET_HOST )
+// The host build: a timer event on the virtual clock ends the run, as a
+// reset would end the firmware
+class HostDog : public SimEvent {
+protected:
+    virtual void fire() {
+        fprintf(stderr, "sim: watchdog reset at %llu us\n", (unsigned long long)Sim_Now());
+        exit(3);
+    }
+};
+
+static HostDog dog;
+static uint64_t timeout;
+
+/// Watchdog gets instantiated at the module level
+Watchdog::Watchdog() {
+    wdreset = false;
+}
+
+/// Load timeout value in watchdog timer and enable
+void Watchdog::Configure(float s) {
+    timeout = (uint64_t)(s * 1e9);
+    Service();
+}
+
+/// "Service", "kick" or "feed" the dog - reset the watchdog timer
+void Watchdog::Service() {
+    if (timeout)
+        dog.schedule(Sim_Nanos() + timeout);
+}
+
+/// get the flag to indicate if the watchdog causes the reset
+bool Watchdog::WatchdogCausedReset() {
+    return wdreset;
+}
 #endif
@@ -36,6 +36,7 @@
 /// \li TARGET_LPC1768 
 /// \li TARGET_LPC4088
 /// \li TARGET_STM
+/// \li TARGET_HOST, the host build, where a reset ends the run
 ///
 /// example:
 /// @code
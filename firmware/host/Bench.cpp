@@ -0,0 +1,102 @@
+/// @file Bench.cpp logging throughput and latency benchmark of the host build
+///
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "Bench.h"
+#include "Trace.h"
+
+static SdCard *card;
+static const char *profile;
+static unsigned period_ms;
+static char format[4];
+static unsigned sync_every;
+static char commands[64];
+static uint64_t end_us;
+
+static bool started;                    // the first tick came
+static uint64_t start_ns;
+static uint32_t reads0, writes0;        // card blocks before the first tick
+static uint64_t written0;
+static uint32_t ticks;
+static uint64_t span_ns;                // start of the log span in progress
+static std::vector<uint32_t> latency;   // us, one per record
+
+static void hook(uint16_t id, uint16_t arg)
+{
+    uint64_t now = Sim_Nanos();
+    switch (id) {
+    case TR_tick:
+        if (!started) {
+            started = true;
+            start_ns = now;
+            reads0 = card->blocksRead();
+            writes0 = card->blocksWritten();
+            written0 = Retarget_Written();
+        }
+        ticks++;
+        break;
+    case TR_log:
+        span_ns = now;
+        break;
+    case TR_log | TRACE_END_BIT:
+        latency.push_back((uint32_t)((now - span_ns + 500) / 1000));
+        break;
+    }
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &v, int pct)
+{
+    if (v.empty())
+        return 0;
+    size_t i = (v.size() * pct + 99) / 100;
+    return v[i ? i - 1 : 0];
+}
+
+static void report(void)
+{
+    double seconds = started ? (Sim_Nanos() - start_ns) / 1e9 : 0;
+    size_t n = latency.size();
+    double rec = n ? (double)n : 1;
+    double log_b = (Retarget_Written() - written0) / rec;
+    double wr_b = (card->blocksWritten() - writes0) * 512.0 / rec;
+    double rd_b = (card->blocksRead() - reads0) * 512.0 / rec;
+    std::sort(latency.begin(), latency.end());
+    // a refused Mode never ticks, a run that logged nothing compares nothing
+    bool complete = Sim_Now() >= end_us && started && n > 0;
+    printf("%s,%u,%s,%u,%d,%.3f,%lu,%lu,%.2f,%.1f,%.1f,%.1f,%.2f,%lu,%lu,%lu\n",
+           profile, period_ms, format, sync_every, complete, seconds,
+           (unsigned long)ticks, (unsigned long)n,
+           seconds > 0 ? n / seconds : 0.0, log_b, wr_b, rd_b, log_b > 0 ? wr_b / log_b : 0.0,
+           (unsigned long)percentile(latency, 50), (unsigned long)percentile(latency, 99),
+           (unsigned long)(n ? latency[n - 1] : 0));
+    fflush(stdout);
+}
+
+void Bench_Header(FILE *f)
+{
+    fprintf(f, "profile,period_ms,format,sync,complete,seconds,ticks,records,records_s,"
+            "log_b,card_wr_b,card_rd_b,amplif,p50_us,p99_us,max_us\n");
+}
+
+bool Bench_Start(const char *spec, SdCard *c, const char *name, uint64_t stop_us)
+{
+    if (sscanf(spec, "%u,%3[a-z],%u", &period_ms, format, &sync_every) != 3
+            || period_ms == 0 || sync_every == 0 || (strcmp(format, "csv") && strcmp(format, "bin")))
+        return false;
+    card = c;
+    profile = name;
+    end_us = stop_us;
+    snprintf(commands, sizeof(commands), "Format %s\r\nSync %u\r\nMode 1 %u\r\n",
+             format, sync_every, period_ms);
+    latency.reserve(4096);
+    trace_hook = hook;
+    atexit(report);
+    return true;
+}
+
+const char *Bench_Commands(void)
+{
+    return commands;
+}
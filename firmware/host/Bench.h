@@ -0,0 +1,58 @@
+/// @file Bench.h logging throughput and latency benchmark of the host build
+///
+/// gauge --bench PERIOD_MS,FORMAT,SYNC runs the real logging path against
+/// the simulated card: the board types Format, Sync and Mode 1 PERIOD_MS
+/// into the console itself, the console output is thrown away but still
+/// takes its time on the line. The trace hook follows the run, each log
+/// span is one record from the logger task taking the sample to the record
+/// being handed over as the sync policy says: to the stdio buffer, or
+/// closed and on the card.
+///
+/// When the run ends (--time) one CSV line goes to stdout:
+///
+///     profile      card latency profile
+///     period_ms    sample period
+///     format       csv or bin
+///     sync         log writes per file close
+///     complete     1 if the run lasted and logged, 0 if it ended early
+///                  (watchdog reset) or logged nothing (Mode refused)
+///     seconds      from the first sample tick to the end
+///     ticks        sample ticks
+///     records      records logged
+///     records_s    records per second, sustained
+///     log_b        bytes per record stdio handed to the file system
+///     card_wr_b    bytes per record written to the card, sectors of 512
+///     card_rd_b    bytes per record read from the card (FAT, directory)
+///     amplif       card_wr_b / log_b
+///     p50_us, p99_us, max_us   append latency, the log span
+///
+/// make bench in firmware/host sweeps period, format, sync and profile.
+/// A bin record is a few bytes of a 512 byte block, so bin runs last
+/// BENCH_TIME_BIN, long enough for several blocks to reach the card.
+///
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include "SdCard.h"
+
+/// Set up a benchmark run
+///
+/// @param spec is PERIOD_MS,FORMAT,SYNC, e.g. 200,csv,1
+/// @param card is the card to count the sectors of
+/// @param profile is the name of its latency profile
+/// @param stop_us is the end of the run, virtual time
+/// @returns false if spec is not valid
+bool Bench_Start(const char *spec, SdCard *card, const char *profile, uint64_t stop_us);
+
+/// @returns the console input that starts the run
+const char *Bench_Commands(void);
+
+/// Write the CSV header line
+void Bench_Header(FILE *f);
+
+/// @returns the bytes stdio handed to the mounted file systems, counted
+/// by Retarget.cpp
+uint64_t Retarget_Written(void);
+
+#endif // BENCH_H
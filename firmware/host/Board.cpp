@@ -0,0 +1,390 @@
+/// @file Board.cpp the simulated board around the firmware of the host build
+///
+/// The program is linked with --wrap,main: __wrap_main() takes the host
+/// options, puts the card, the probes and the pressure signal on the pins
+/// main.cpp uses and connects the serial port, then runs the firmware's
+/// main().
+///
+///     gauge [options]
+///       --sd FILE          card image, created and formatted if new (sd.img)
+///       --sd-size MB       size of a new image (64)
+///       --sd-latency NAME  ideal, fast, typical or slow (typical)
+///       --format           format the image before the run
+///       --probes N         DS18B20 probes on the 1-Wire bus, 0..8 (1)
+///       --temp C|FILE[:N]  probe temperature, a constant or column N of a log (1)
+///       --adc N|FILE[:N]   pressure ADC counts, a constant or column N of a log (2)
+///       --speed X          virtual time per wall time, 0 runs flat out
+///       --time S           end the run at S seconds of virtual time
+///       --pty              serial port on a pseudo terminal instead of stdio
+///       --bench MS,FMT,SYNC  logging benchmark run, see Bench.h
+///       --bench-header     print the CSV header of the benchmark
+///       --replay CAST      replay a recorded cast into the sensors, see Replay.h
+///       --replay-log FILE  copy of the firmware's log after the replay (replay.csv)
+///       --replay-format F  log format of the replay, csv or bin (csv)
+///
+/// The serial port is stdin and stdout. On a terminal the run is paced at
+/// real time, the terminal is raw and Ctrl-] ends the run; from a pipe the
+/// run goes flat out and ends once the input is used up and the firmware
+/// idles.
+///
+#include <fcntl.h>
+#include <signal.h>
+#include <termios.h>
+#include <unistd.h>
+#include "mbed.h"
+#include "FATFileSystem.h"
+#include "ff.h"
+#include "SdCard.h"
+#include "DS18B20Model.h"
+#include "Signal.h"
+#include "Bench.h"
+#include "Replay.h"
+
+// the wiring of main.cpp
+#define SD_SCLK     PA_5
+#define SD_CS       PA_4
+#define W1_PIN      PB_9
+#define ADC_PIN     PA_1
+#define SERIAL_TX   PB_10
+
+#define MAX_PROBES  8
+
+extern "C" int __real_main(int argc, char *argv[]);
+
+static SdCard card(SD_CS);
+static Signal temp(21.5);
+static Signal adc(0x8000);
+static DS18B20Model *probes[MAX_PROBES];
+
+static struct termios saved;
+static bool restore;
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: gauge [options]\n"
+            "  --sd FILE          card image, created and formatted if new (sd.img)\n"
+            "  --sd-size MB       size of a new image (64)\n"
+            "  --sd-latency NAME  ideal, fast, typical or slow (typical)\n"
+            "  --format           format the image before the run\n"
+            "  --probes N         DS18B20 probes on the 1-Wire bus, 0..8 (1)\n"
+            "  --temp C|FILE[:N]  probe temperature, a constant or column N of a log (1)\n"
+            "  --adc N|FILE[:N]   pressure ADC counts, a constant or column N of a log (2)\n"
+            "  --speed X          virtual time per wall time, 0 runs flat out\n"
+            "  --time S           end the run at S seconds of virtual time\n"
+            "  --pty              serial port on a pseudo terminal instead of stdio\n"
+            "  --bench MS,FMT,SYNC  logging benchmark run, see Bench.h\n"
+            "  --bench-header     print the CSV header of the benchmark\n"
+            "  --replay CAST      replay a recorded cast into the sensors, see Replay.h\n"
+            "  --replay-log FILE  copy of the firmware's log after the replay (replay.csv)\n"
+            "  --replay-format F  log format of the replay, csv or bin (csv)\n");
+    exit(2);
+}
+
+// a constant, or a log file with an optional :column
+static bool source(Signal *sig, char *arg, int column)
+{
+    char *end;
+    double v = strtod(arg, &end);
+    if (end != arg && *end == '\0') {
+        sig->set(v);
+        return true;
+    }
+    char *colon = strrchr(arg, ':');
+    if (colon && colon[1]) {
+        column = strtol(colon + 1, &end, 10);
+        if (*end == '\0')
+            *colon = '\0';
+    }
+    return sig->load(arg, column);
+}
+
+// the disk of a card image, to format it outside of the firmware's time
+class ImageDisk : public FATFileSystem {
+public:
+    ImageDisk(SdCard *card) : FATFileSystem(NULL), _card(card) {
+    }
+    virtual int disk_read(uint8_t *buffer, uint32_t sector, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (!_card->read(sector + i, buffer + 512 * i))
+                return 1;
+        }
+        return 0;
+    }
+    virtual int disk_write(const uint8_t *buffer, uint32_t sector, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (!_card->write(sector + i, buffer + 512 * i))
+                return 1;
+        }
+        return 0;
+    }
+    virtual uint32_t disk_sectors() {
+        return _card->blocks();
+    }
+
+private:
+    SdCard *_card;
+};
+
+static int formatImage(ImageDisk *disk, void *arg)
+{
+    return disk->format();
+}
+
+// the firmware's "sd" holds the only FatFs drive, lend it to the image
+static int withImage(int (*fn)(ImageDisk *disk, void *arg), void *arg)
+{
+    FATFileSystem *sdfs = FATFileSystem::_ffs[0];
+    FATFileSystem::_ffs[0] = NULL;
+    int r;
+    {
+        ImageDisk disk(&card);
+        r = fn(&disk, arg);
+    }
+    FATFileSystem::_ffs[0] = sdfs;
+    if (sdfs)
+        f_mount(&sdfs->_fs, sdfs->_fsid, 0);
+    return r;
+}
+
+static bool format(void)
+{
+    return withImage(formatImage, NULL) == 0;
+}
+
+struct copy {
+    const char *name;
+    const char *to;
+};
+
+static int copyOut(ImageDisk *disk, void *arg)
+{
+    const copy *c = (const copy *)arg;
+    FileHandle *fh = disk->open(c->name, O_RDONLY);
+    if (fh == NULL)
+        return 1;
+    int r = 1;
+    FILE *out = fopen(c->to, "wb");
+    if (out) {
+        char buf[512];
+        ssize_t n;
+        while ((n = fh->read(buf, sizeof(buf))) > 0 && fwrite(buf, 1, n, out) == (size_t)n)
+            ;
+        r = n != 0;
+        if (fclose(out))
+            r = 1;
+    }
+    fh->close();
+    return r;
+}
+
+bool Board_CopyOut(const char *name, const char *to)
+{
+    copy c = { name, to };
+    return withImage(copyOut, &c) == 0;
+}
+
+// console input the board types itself, the write end stays open for
+// more if writer is given
+static int typeInto(const char *cmds, int *writer)
+{
+    int fds[2];
+    if (pipe(fds) < 0 || write(fds[1], cmds, strlen(cmds)) < 0)
+        return -1;
+    if (writer)
+        *writer = fds[1];
+    else
+        close(fds[1]);
+    return fds[0];
+}
+
+static void restoreTerminal(void)
+{
+    if (restore)
+        tcsetattr(0, TCSAFLUSH, &saved);
+}
+
+static void onSignal(int sig)
+{
+    restoreTerminal();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// raw, but Ctrl-] still ends the run
+static void rawTerminal(void)
+{
+    if (tcgetattr(0, &saved) < 0)
+        return;
+    struct termios t = saved;
+    cfmakeraw(&t);
+    t.c_lflag |= ISIG;
+    t.c_cc[VINTR] = 0x1D;
+    t.c_cc[VQUIT] = _POSIX_VDISABLE;
+    t.c_cc[VSUSP] = _POSIX_VDISABLE;
+    restore = true;
+    atexit(restoreTerminal);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    tcsetattr(0, TCSAFLUSH, &t);
+}
+
+// a pseudo terminal for a terminal program, the slave stays open so the
+// port survives the program closing it
+static int openPty(void)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) < 0 || unlockpt(fd) < 0)
+        return -1;
+    const char *name = ptsname(fd);
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0)
+        return -1;
+    struct termios t;
+    tcgetattr(slave, &t);
+    cfmakeraw(&t);
+    tcsetattr(slave, TCSANOW, &t);
+    fprintf(stderr, "sim: serial on %s\n", name);
+    return fd;
+}
+
+extern "C" int __wrap_main(int argc, char *argv[])
+{
+    const char *image = "sd.img";
+    unsigned mbytes = 64;
+    const SD_LATENCY_T *profile = SdCard_Profile("typical");
+    bool reformat = false;
+    int nprobes = 1;
+    double speed = -1;
+    double stop = 0;
+    bool pty = false;
+    const char *bench = NULL;
+    const char *replay = NULL;
+    const char *replaylog = "replay.csv";
+    const char *replayfmt = "csv";
+
+    for (int i = 1; i < argc; i++) {
+        const char *opt = argv[i];
+        char *arg = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(opt, "--format")) {
+            reformat = true;
+            continue;
+        }
+        if (!strcmp(opt, "--pty")) {
+            pty = true;
+            continue;
+        }
+        if (!strcmp(opt, "--bench-header")) {
+            Bench_Header(stdout);
+            return 0;
+        }
+        if (arg == NULL)
+            usage();
+        i++;
+        if (!strcmp(opt, "--sd"))
+            image = arg;
+        else if (!strcmp(opt, "--sd-size"))
+            mbytes = strtoul(arg, NULL, 0);
+        else if (!strcmp(opt, "--sd-latency")) {
+            profile = SdCard_Profile(arg);
+            if (profile == NULL)
+                usage();
+        } else if (!strcmp(opt, "--probes")) {
+            nprobes = atoi(arg);
+            if (nprobes < 0 || nprobes > MAX_PROBES)
+                usage();
+        } else if (!strcmp(opt, "--temp")) {
+            if (!source(&temp, arg, 1)) {
+                fprintf(stderr, "sim: cannot read %s\n", arg);
+                return 1;
+            }
+        } else if (!strcmp(opt, "--adc")) {
+            if (!source(&adc, arg, 2)) {
+                fprintf(stderr, "sim: cannot read %s\n", arg);
+                return 1;
+            }
+        } else if (!strcmp(opt, "--speed"))
+            speed = atof(arg);
+        else if (!strcmp(opt, "--time"))
+            stop = atof(arg);
+        else if (!strcmp(opt, "--bench"))
+            bench = arg;
+        else if (!strcmp(opt, "--replay"))
+            replay = arg;
+        else if (!strcmp(opt, "--replay-log"))
+            replaylog = arg;
+        else if (!strcmp(opt, "--replay-format"))
+            replayfmt = arg;
+        else
+            usage();
+    }
+
+    bool created;
+    if (!card.open(image, mbytes, &created)) {
+        fprintf(stderr, "sim: cannot open card image %s\n", image);
+        return 1;
+    }
+    if (replay && bench) {
+        fprintf(stderr, "sim: --replay or --bench, not both\n");
+        return 2;
+    }
+    if ((created || reformat || replay) && !format()) {    // a replay logs to a clean card
+        fprintf(stderr, "sim: cannot format card image %s\n", image);
+        return 1;
+    }
+    card.latency(profile);
+    Sim_SpiAttach(SD_SCLK, &card);
+
+    for (int i = 0; i < nprobes; i++)
+        probes[i] = new DS18B20Model(W1_PIN, 0x0000C0FFEE00ULL + i * 0x1111, &temp);
+    Sim_AnalogAttach(ADC_PIN, &adc);
+
+    Serial *port = Serial::find(SERIAL_TX);
+    bool interactive;
+    if (bench) {
+        // the board types the commands, the console goes nowhere
+        if (stop <= 0 || !Bench_Start(bench, &card, profile->name, (uint64_t)(stop * 1e6))) {
+            fprintf(stderr, "sim: --bench needs MS,csv|bin,SYNC and --time\n");
+            return 2;
+        }
+        int fd = typeInto(Bench_Commands(), NULL);
+        if (fd < 0)
+            return 1;
+        port->connect(fd, open("/dev/null", O_WRONLY));
+        interactive = false;
+    } else if (replay) {
+        if (!Replay_Start(replay, &temp, &adc, replayfmt, replaylog)) {
+            fprintf(stderr, "sim: cannot replay %s\n", replay);
+            return 1;
+        }
+        int writer;
+        int fd = typeInto(Replay_Commands(), &writer);
+        if (fd < 0)
+            return 1;
+        Replay_Input(writer);
+        port->connect(fd, open("/dev/null", O_WRONLY));
+        interactive = false;
+    } else if (pty) {
+        int fd = openPty();
+        if (fd < 0) {
+            fprintf(stderr, "sim: no pseudo terminal\n");
+            return 1;
+        }
+        port->connect(fd, fd);
+        interactive = true;
+    } else {
+        interactive = isatty(0);
+        if (interactive)
+            rawTerminal();
+        port->connect(0, 1);
+    }
+    setvbuf(stdout, NULL, _IONBF, 0);   // the firmware's printf() and the port share stdout
+
+    Sim_Speed(speed >= 0 ? speed : interactive ? 1.0 : 0.0);
+    if (stop > 0)
+        Sim_StopAt((uint64_t)(stop * 1e6));
+
+    char name[] = "gauge";
+    char *args[] = { name, NULL };
+    return __real_main(1, args);
+}
@@ -0,0 +1,226 @@
+/// @file DS18B20Model.cpp a DS18B20 on a 1-Wire pin of the simulated board
+///
+#include <math.h>
+#include <string.h>
+#include "DS18B20Model.h"
+
+#define RESET_NS        480000ULL       // a low this long is a reset
+#define PRESENCE_NS     30000ULL        // presence pulse, after the release
+#define PRESENCE_LEN_NS 120000ULL
+#define ONE_NS          15000ULL        // a write slot low shorter than this is a 1
+#define ZERO_LEN_NS     30000ULL        // a 0 is sent by holding the line this long
+
+static uint8_t crc8(const uint8_t *data, int len)
+{
+    uint8_t crc = 0;
+    for (int i = 0; i < len; i++) {
+        uint8_t b = data[i];
+        for (int j = 0; j < 8; j++) {
+            uint8_t mix = (crc ^ b) & 0x01;
+            crc >>= 1;
+            if (mix)
+                crc ^= 0x8C;
+            b >>= 1;
+        }
+    }
+    return crc;
+}
+
+DS18B20Model::DS18B20Model(PinName pin, uint64_t serial, Signal *temp) : _pin(pin), _temp(temp),
+    _state(ST_IDLE), _fell(0), _pull_from(0), _pull_to(0), _rx(0), _rxbits(0), _bit(0), _phase(0),
+    _match(false), _txlen(0), _txbit(0), _wrlen(0), _converting(false), _done(0), _result(0)
+{
+    _rom[0] = 0x28;
+    for (int i = 1; i < 7; i++)
+        _rom[i] = serial >> (8 * (i - 1));
+    _rom[7] = crc8(_rom, 7);
+
+    static const uint8_t power_up[8] = { 0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10 };  // 85 C
+    memcpy(_pad, power_up, 8);
+    _pad[8] = crc8(_pad, 8);
+    memcpy(_eeprom, &_pad[2], 3);
+    Sim_PinAttach(pin, this);
+}
+
+bool DS18B20Model::pulling()
+{
+    uint64_t now = Sim_Nanos();
+    return now >= _pull_from && now < _pull_to;
+}
+
+void DS18B20Model::driven(bool low)
+{
+    uint64_t now = Sim_Nanos();
+    if (_converting && now >= _done) {
+        _converting = false;
+        _pad[0] = _result & 0xFF;
+        _pad[1] = (uint16_t)_result >> 8;
+        _pad[8] = crc8(_pad, 8);
+    }
+    if (low) {
+        _fell = now;
+        slot();
+        return;
+    }
+    uint64_t len = now - _fell;
+    if (len >= RESET_NS)
+        reset();
+    else if (_state == ST_ROM || _state == ST_MATCH || _state == ST_FUNC || _state == ST_WRITE
+             || (_state == ST_SEARCH && _phase == 3))
+        bitIn(len < ONE_NS);
+}
+
+void DS18B20Model::reset()
+{
+    uint64_t now = Sim_Nanos();
+    _state = ST_ROM;
+    _rx = 0;
+    _rxbits = 0;
+    _pull_from = now + PRESENCE_NS;
+    _pull_to = _pull_from + PRESENCE_LEN_NS;
+}
+
+// the start of a slot, send a 0 if this one is ours to answer
+void DS18B20Model::slot()
+{
+    int bit;
+    switch (_state) {
+    case ST_SEARCH:
+        if (_phase == 2) {
+            _phase = 3;                 // the master writes the direction
+            return;
+        }
+        bit = (_rom[_bit / 8] >> (_bit % 8)) & 1;
+        if (_phase++ == 1)
+            bit = !bit;
+        break;
+    case ST_SEND:
+        bit = _txbit < 8 * _txlen ? (_tx[_txbit / 8] >> (_txbit % 8)) & 1 : 1;
+        _txbit++;
+        break;
+    case ST_CONVERT:
+        bit = !_converting;
+        break;
+    default:
+        return;
+    }
+    if (!bit) {
+        _pull_from = Sim_Nanos();
+        _pull_to = _pull_from + ZERO_LEN_NS;
+    }
+}
+
+void DS18B20Model::bitIn(int bit)
+{
+    if (_state == ST_SEARCH || _state == ST_MATCH) {
+        int mine = (_rom[_bit / 8] >> (_bit % 8)) & 1;
+        if (_state == ST_SEARCH) {
+            _phase = 0;
+            if (bit != mine) {
+                _state = ST_IDLE;       // lost the search, out until the next reset
+                return;
+            }
+        } else if (bit != mine)
+            _match = false;
+        if (++_bit == 64)
+            _state = _state == ST_SEARCH || _match ? ST_FUNC : ST_IDLE;
+        return;
+    }
+    _rx |= bit << _rxbits;
+    if (++_rxbits == 8) {
+        uint8_t b = _rx;
+        _rx = 0;
+        _rxbits = 0;
+        byteIn(b);
+    }
+}
+
+void DS18B20Model::send(const uint8_t *data, int len)
+{
+    if (len)
+        memcpy(_tx, data, len);
+    _txlen = len;
+    _txbit = 0;
+    _state = ST_SEND;
+}
+
+void DS18B20Model::byteIn(uint8_t b)
+{
+    switch (_state) {
+    case ST_ROM:
+        switch (b) {
+        case 0xF0:                      // search ROM
+            _state = ST_SEARCH;
+            _bit = 0;
+            _phase = 0;
+            break;
+        case 0x33:                      // read ROM
+            send(_rom, 8);
+            break;
+        case 0x55:                      // match ROM
+            _state = ST_MATCH;
+            _bit = 0;
+            _match = true;
+            break;
+        case 0xCC:                      // skip ROM
+            _state = ST_FUNC;
+            break;
+        default:                        // alarm search and the rest: no alarms here
+            _state = ST_IDLE;
+            break;
+        }
+        break;
+
+    case ST_FUNC:
+        switch (b) {
+        case 0x44: {                    // convert T
+            int res = (_pad[4] >> 5) & 3;   // 9..12 bit
+            double t = _temp ? _temp->value(Sim_Now()) : 25.0;
+            if (t < -55)
+                t = -55;
+            if (t > 125)
+                t = 125;
+            _result = (int16_t)floor(t * 16 + 0.5) & ~((1 << (3 - res)) - 1);
+            _done = Sim_Nanos() + (93750000ULL << res);
+            _converting = true;
+            _state = ST_CONVERT;
+            break;
+        }
+        case 0xBE:                      // read scratchpad
+            send(_pad, 9);
+            break;
+        case 0x4E:                      // write scratchpad: TH, TL, config
+            _state = ST_WRITE;
+            _wrlen = 0;
+            break;
+        case 0x48:                      // copy scratchpad
+            memcpy(_eeprom, &_pad[2], 3);
+            _state = ST_IDLE;
+            break;
+        case 0xB8:                      // recall EEPROM
+            memcpy(&_pad[2], _eeprom, 3);
+            _pad[8] = crc8(_pad, 8);
+            _state = ST_IDLE;
+            break;
+        case 0xB4:                      // read power supply: ones, not parasite powered
+            send(NULL, 0);
+            break;
+        default:
+            _state = ST_IDLE;
+            break;
+        }
+        break;
+
+    case ST_WRITE:
+        _pad[2 + _wrlen] = b;
+        if (++_wrlen == 3) {
+            _pad[4] = (b & 0x60) | 0x1F;
+            _state = ST_IDLE;
+        }
+        _pad[8] = crc8(_pad, 8);
+        break;
+
+    default:
+        break;
+    }
+}
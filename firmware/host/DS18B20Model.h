@@ -0,0 +1,77 @@
+/// @file DS18B20Model.h a DS18B20 on a 1-Wire pin of the simulated board
+///
+/// The probe follows the bus from the edges the firmware drives: a low of
+/// 480 us or more is a reset, answered with a presence pulse; in a write
+/// slot a low shorter than 15 us is a 1; in a read slot a 0 is sent by
+/// holding the line low for 30 us from the falling edge. Several probes on
+/// one pin see the same edges and pull the line together, so the ROM
+/// search resolves them like on a real bus.
+///
+/// ROM commands: search (F0), read (33), match (55), skip (CC). Function
+/// commands: convert (44) with the conversion time of the resolution and
+/// read slots answering 0 until it is done, read scratchpad (BE), write
+/// scratchpad (4E), copy (48), recall (B8), read power supply (B4, always
+/// powered). A conversion latches the temperature of the probe's Signal.
+///
+#ifndef DS18B20MODEL_H
+#define DS18B20MODEL_H
+
+#include "Sim.h"
+#include "Signal.h"
+
+class DS18B20Model : public SimPinDevice {
+public:
+    /// @param pin is the bus
+    /// @param serial makes the ROM id, family 0x28 and the CRC are added
+    /// @param temp is the temperature in degrees C over time
+    DS18B20Model(PinName pin, uint64_t serial, Signal *temp);
+
+    virtual void driven(bool low);
+    virtual bool pulling();
+
+    /// @returns the ROM id, family code first
+    const uint8_t *rom() const {
+        return _rom;
+    }
+
+private:
+    enum state {
+        ST_IDLE,                        // not addressed until the next reset
+        ST_ROM,                         // reading a ROM command
+        ST_SEARCH,                      // three slots per ROM bit
+        ST_MATCH,                       // reading 64 bits of ROM id
+        ST_FUNC,                        // reading a function command
+        ST_WRITE,                       // reading scratchpad bytes
+        ST_SEND,                        // sending bytes, then ones
+        ST_CONVERT,                     // read slots tell whether the conversion is done
+    };
+
+    void reset();
+    void bitIn(int bit);
+    void slot();
+    void byteIn(uint8_t b);
+    void send(const uint8_t *data, int len);
+
+    PinName  _pin;
+    Signal  *_temp;
+    uint8_t  _rom[8];
+    uint8_t  _pad[9];                   // scratchpad
+    uint8_t  _eeprom[3];                // TH, TL, config
+
+    state    _state;
+    uint64_t _fell;                     // when the firmware pulled the line low
+    uint64_t _pull_from, _pull_to;      // this device holds the line low meanwhile
+    uint8_t  _rx;                       // byte being read, bit by bit
+    int      _rxbits;
+    int      _bit;                      // search and match: ROM bit index
+    int      _phase;                    // search: bit, complement, then direction slot
+    bool     _match;                    // match: the id so far is ours
+    uint8_t  _tx[9];
+    int      _txlen, _txbit;
+    int      _wrlen;                    // write scratchpad: bytes so far
+    bool     _converting;
+    uint64_t _done;                     // the conversion is done at this time
+    int16_t  _result;                   // and gives this reading
+};
+
+#endif // DS18B20MODEL_H
@@ -0,0 +1,471 @@
+/// @file Drivers.cpp mbed drivers of the host build on the simulated board
+///
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include "mbed.h"
+#include "FileSystemLike.h"
+
+// --- time
+
+static uint64_t spin_at = 0;            // virtual time of the previous clock read
+static int      spins = 0;              // clock reads since it moved
+
+namespace mbed {
+
+uint64_t sim_clock_us()
+{
+    uint64_t ns = Sim_Nanos();
+    if (ns != spin_at) {
+        spin_at = ns;
+        spins = 0;
+    } else if (++spins >= 64) {
+        Sim_Advance(1000);              // polling in a loop, let the loop take time
+        spin_at = Sim_Nanos();
+        spins = 0;
+    }
+    return spin_at / 1000;
+}
+
+} // namespace mbed
+
+extern "C" uint32_t us_ticker_read(void)
+{
+    return (uint32_t)sim_clock_us();
+}
+
+extern "C" void wait(float s)
+{
+    Sim_Advance((uint64_t)(s * 1e9f));
+}
+
+extern "C" void wait_ms(int ms)
+{
+    Sim_Advance((uint64_t)ms * 1000000ULL);
+}
+
+extern "C" void wait_us(int us)
+{
+    Sim_Advance((uint64_t)us * 1000ULL);
+}
+
+extern "C" void core_util_critical_section_enter(void)
+{
+    Sim_IrqDisable();
+}
+
+extern "C" void core_util_critical_section_exit(void)
+{
+    Sim_IrqEnable();
+}
+
+extern "C" bool core_util_are_interrupts_enabled(void)
+{
+    return Sim_IrqEnabled();
+}
+
+extern "C" void pin_mode(PinName pin, PinMode mode)
+{
+    if (mode == PullUp)
+        Sim_PinPull(pin, 1);
+    else if (mode == PullDown)
+        Sim_PinPull(pin, 0);
+}
+
+extern "C" void error(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+    exit(1);
+}
+
+extern "C" void mbed_assert_internal(const char *expr, const char *file, int line)
+{
+    fprintf(stderr, "mbed assertation failed: %s, file: %s, line %d \n", expr, file, line);
+    abort();
+}
+
+namespace mbed {
+
+// --- timers
+
+Timer::Timer() : _running(false), _start(0), _time(0)
+{
+}
+
+void Timer::start()
+{
+    if (!_running) {
+        _start = sim_clock_us();
+        _running = true;
+    }
+}
+
+void Timer::stop()
+{
+    _time = read_high_resolution_us();
+    _running = false;
+}
+
+void Timer::reset()
+{
+    _start = sim_clock_us();
+    _time = 0;
+}
+
+uint64_t Timer::read_high_resolution_us()
+{
+    return _running ? _time + sim_clock_us() - _start : _time;
+}
+
+float Timer::read()
+{
+    return read_high_resolution_us() / 1000000.0f;
+}
+
+int Timer::read_ms()
+{
+    return read_high_resolution_us() / 1000;
+}
+
+int Timer::read_us()
+{
+    return read_high_resolution_us();
+}
+
+void Ticker::attach_us(Callback<void()> func, timestamp_t t)
+{
+    _function = func;
+    _period = t ? (uint64_t)t * 1000 : 1000;
+    _due = Sim_Nanos() + _period;
+    schedule(_due);
+}
+
+void Ticker::detach()
+{
+    cancel();
+    _function = NULL;
+}
+
+void Ticker::fire()
+{
+    _due += _period;
+    schedule(_due);
+    _function.call();
+}
+
+void Timeout::fire()
+{
+    _function.call();
+}
+
+// --- pins
+
+void InterruptIn::edge(bool rise)
+{
+    Callback<void()> &func = rise ? _rise : _fall;
+    if (_enabled && func)
+        func.call();
+}
+
+unsigned short AnalogIn::read_u16()
+{
+    Sim_Advance(14000);                 // 1.5 + 12.5 cycles at 1 MHz, the slowest ADC clock
+    SimSignal *sig = Sim_Analog(_pin);
+    return sig ? sig->sample(Sim_Now()) : 0x8000;
+}
+
+// --- SPI
+
+SPI::SPI(PinName mosi, PinName miso, PinName sclk, PinName ssel) : _sclk(sclk), _bits(8)
+{
+    frequency();
+}
+
+void SPI::format(int bits, int mode)
+{
+    _bits = bits;
+}
+
+void SPI::frequency(int hz)
+{
+    // the STM32F1 SPI clock is 72 MHz divided by a power of 2, at least 2
+    int div = 2;
+    while (div < 256 && 72000000 / div > hz)
+        div *= 2;
+    _bit_ns = div * 1000000000ULL / 72000000;
+}
+
+int SPI::write(int value)
+{
+    Sim_Advance(_bits * _bit_ns);
+    SimSpiDevice *dev = Sim_Spi(_sclk);
+    return dev ? dev->transfer(value, _bits) : (1 << _bits) - 1;
+}
+
+// --- serial
+
+static Serial *serials = NULL;
+
+Serial::Serial(PinName tx, PinName rx, const char *name, int baud)
+{
+    init(tx, rx, baud);
+}
+
+Serial::Serial(PinName tx, PinName rx, int baud)
+{
+    init(tx, rx, baud);
+}
+
+void Serial::init(PinName tx, PinName rx, int baudrate)
+{
+    _tx = tx;
+    _rx = rx;
+    _txfree = 0;
+    _in = _out = -1;
+    _eof = false;
+    _full = false;
+    _polled = false;
+    _qhead = _qlen = 0;
+    baud(baudrate);
+    _next = serials;
+    serials = this;
+}
+
+Serial::~Serial()
+{
+    for (Serial **p = &serials; *p; p = &(*p)->_next) {
+        if (*p == this) {
+            *p = _next;
+            break;
+        }
+    }
+    if (_in >= 0)
+        Sim_Unwatch(_in);
+}
+
+Serial *Serial::find(PinName tx)
+{
+    for (Serial *s = serials; s; s = s->_next) {
+        if (s->_tx == tx)
+            return s;
+    }
+    return NULL;
+}
+
+void Serial::connect(int in, int out)
+{
+    if (_in >= 0)
+        Sim_Unwatch(_in);
+    _in = in;
+    _out = out;
+    _eof = false;
+    if (_in >= 0)
+        Sim_Watch(_in, &Serial::input, this);
+}
+
+void Serial::baud(int baudrate)
+{
+    _char_ns = 10 * 1000000000ULL / baudrate;   // start, 8 data, stop bit
+}
+
+void Serial::format(int bits, Parity parity, int stop_bits)
+{
+}
+
+void Serial::attach(Callback<void()> func, IrqType type)
+{
+    _irq[type] = func;
+    if (type == RxIrq)
+        pull();
+}
+
+// the line delivers once someone listens, the host does not send into a
+// port that is not yet set up
+void Serial::pull()
+{
+    if (_qlen && !pending() && (_irq[RxIrq] || _polled))
+        schedule(Sim_Nanos() + _char_ns);
+}
+
+// the host descriptor is readable: take what fits, the line delivers it
+void Serial::input(void *arg)
+{
+    Serial *s = (Serial *)arg;
+    uint8_t buf[sizeof(s->_queue)];
+    int room = sizeof(s->_queue) - s->_qlen;
+    int n = read(s->_in, buf, room);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        return;
+    if (n <= 0) {
+        Sim_Unwatch(s->_in);
+        s->_eof = true;
+        if (!s->_qlen && !s->pending())
+            Sim_EndOfInput();
+        return;
+    }
+    for (int i = 0; i < n; i++)
+        s->_queue[(s->_qhead + s->_qlen++) % sizeof(s->_queue)] = buf[i];
+    if (s->_qlen == (int)sizeof(s->_queue))
+        Sim_Unwatch(s->_in);            // back pressure, watched again once drained
+    s->pull();
+}
+
+// a character came in on the line
+void Serial::fire()
+{
+    if (!_qlen)
+        return;
+    _rdr = _queue[_qhead];
+    _qhead = (_qhead + 1) % sizeof(_queue);
+    _qlen--;
+    _full = true;                       // an unread character is overrun
+    Sim_PinSet(_rx, 0);                 // start bit
+    Sim_PinSet(_rx, 1);
+    if (_irq[RxIrq])
+        _irq[RxIrq].call();
+    if (_qlen)
+        schedule(Sim_Nanos() + _char_ns);
+    else if (_eof)
+        Sim_EndOfInput();
+    if (!_eof && _in >= 0 && _qlen == (int)sizeof(_queue) / 2)
+        Sim_Watch(_in, &Serial::input, this);
+}
+
+int Serial::readable()
+{
+    _polled = true;
+    pull();
+    return _full;
+}
+
+int Serial::getc()
+{
+    _polled = true;
+    pull();
+    while (!_full) {
+        Sim_Idle();
+        Sim_Advance(0);
+    }
+    _full = false;
+    return _rdr;
+}
+
+void Serial::send(const char *s, int n)
+{
+    for (int i = 0; i < n; i++) {
+        // one character in the holding register, one in the shift register
+        uint64_t now = Sim_Nanos();
+        if (_txfree > now + _char_ns)
+            Sim_Advance(_txfree - _char_ns - now);
+        _txfree = (_txfree > Sim_Nanos() ? _txfree : Sim_Nanos()) + _char_ns;
+    }
+    while (_out >= 0 && n > 0) {
+        int w = write(_out, s, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            break;
+        s += w;
+        n -= w;
+    }
+}
+
+int Serial::putc(int c)
+{
+    char ch = c;
+    send(&ch, 1);
+    return c;
+}
+
+int Serial::puts(const char *str)
+{
+    send(str, strlen(str));
+    return 0;
+}
+
+int Serial::printf(const char *format, ...)
+{
+    char buf[256];
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(buf, sizeof(buf), format, ap);
+    va_end(ap);
+    if (n < (int)sizeof(buf)) {
+        send(buf, n);
+        return n;
+    }
+    char *big = (char *)malloc(n + 1);
+    va_start(ap, format);
+    vsnprintf(big, n + 1, format, ap);
+    va_end(ap);
+    send(big, n);
+    free(big);
+    return n;
+}
+
+// --- file system base classes, as in the mbed library
+
+FileBase *FileBase::_head = NULL;
+SingletonPtr<PlatformMutex> FileBase::_mutex;
+
+FileBase::FileBase(const char *name, PathType t) : _next(NULL), _name(name), _path_type(t)
+{
+    if (name != NULL) {
+        _next = _head;
+        _head = this;
+    }
+}
+
+FileBase::~FileBase()
+{
+    for (FileBase **p = &_head; *p; p = &(*p)->_next) {
+        if (*p == this) {
+            *p = _next;
+            break;
+        }
+    }
+}
+
+FileBase *FileBase::lookup(const char *name, unsigned int len)
+{
+    for (FileBase *p = _head; p; p = p->_next) {
+        if (p->_name != NULL && strncmp(p->_name, name, len) == 0 && strlen(p->_name) == len)
+            return p;
+    }
+    return NULL;
+}
+
+FileBase *FileBase::get(int n)
+{
+    FileBase *p = _head;
+    for (int i = 0; p && i < n; i++)
+        p = p->_next;
+    return p;
+}
+
+const char *FileBase::getName(void)
+{
+    return _name;
+}
+
+PathType FileBase::getPathType(void)
+{
+    return _path_type;
+}
+
+FileSystemLike::FileSystemLike(const char *name) : FileBase(name, FileSystemPathType)
+{
+}
+
+FileSystemLike::~FileSystemLike()
+{
+}
+
+FileHandle::~FileHandle()
+{
+}
+
+} // namespace mbed
@@ -0,0 +1,9 @@
+/// @file PeripheralNames.h peripheral names of the host build
+///
+/// The simulated board has no peripheral instances, its drivers work on
+/// the pins themselves.
+///
+#ifndef MBED_PERIPHERALNAMES_H
+#define MBED_PERIPHERALNAMES_H
+
+#endif
@@ -0,0 +1,111 @@
+/// @file Replay.cpp replay of a recorded cast through the host build
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "Replay.h"
+#include "Trace.h"
+#include "SampleClock.h"
+
+extern char filename[];                 // the firmware's log file, main.cpp
+
+static const char *logcopy;
+static char commands[64];
+static int input = -1;
+static uint64_t wall0;
+
+static uint32_t ticks, flagged, records;
+static uint64_t span_ns;                // start of the log span in progress
+static uint64_t maxlog_ns;
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// one period after the last point: stop logging and end the input
+class CastEnd : public SimEvent {
+protected:
+    virtual void fire() {
+        static const char stop[] = "Mode 0\r\n";
+        if (write(input, stop, sizeof(stop) - 1) < 0)
+            perror("sim: replay");
+        close(input);
+        input = -1;
+    }
+};
+
+static CastEnd castEnd;
+
+static void hook(uint16_t id, uint16_t arg)
+{
+    switch (id) {
+    case TR_tick:
+        ticks++;
+        if (arg & (SAMPLE_LATE | SAMPLE_SKIPPED | SAMPLE_OVERRUN))
+            flagged++;
+        break;
+    case TR_log:
+        span_ns = Sim_Nanos();
+        break;
+    case TR_log | TRACE_END_BIT:
+        records++;
+        if (Sim_Nanos() - span_ns > maxlog_ns)
+            maxlog_ns = Sim_Nanos() - span_ns;
+        break;
+    }
+}
+
+static void report(void)
+{
+    double virt = Sim_Nanos() / 1e9, wall = (wall_ns() - wall0) / 1e9;
+    fprintf(stderr, "replay: %.3f s in %.3f s wall (%.0fx), %lu ticks, %lu flagged, "
+            "%lu records, longest append %.3f ms\n",
+            virt, wall, wall > 0 ? virt / wall : 0.0, (unsigned long)ticks,
+            (unsigned long)flagged, (unsigned long)records, maxlog_ns / 1e6);
+    if (Board_CopyOut(filename, logcopy))
+        fprintf(stderr, "replay: log %s copied to %s\n", filename, logcopy);
+    else
+        fprintf(stderr, "replay: no log %s on the card\n", filename);
+}
+
+bool Replay_Start(const char *cast, Signal *temp, Signal *adc, const char *format, const char *log)
+{
+    if (strcmp(format, "csv") && strcmp(format, "bin"))
+        return false;
+    if (!temp->load(cast, 1) || !adc->load(cast, 2) || adc->count() < 2)
+        return false;
+
+    // the counts that give P (units) through offset 0 and the gain
+    long gain = 1000;
+    while (adc->peak() * 1000 > 0.8 * gain && gain < 100000000)
+        gain *= 10;
+    adc->scale(65536.0 * 1000 / gain, 0);
+
+    unsigned period_ms = (unsigned)((adc->last() - adc->first()) / (adc->count() - 1) / 1000);
+    if (period_ms == 0)
+        period_ms = 1;
+    snprintf(commands, sizeof(commands), "Format %s\r\nCal 0 %ld\r\nMode 1 %u\r\n",
+             format, gain, period_ms);
+    castEnd.schedule((adc->last() + period_ms * 1000ULL) * 1000);
+
+    logcopy = log;
+    trace_hook = hook;
+    wall0 = wall_ns();
+    atexit(report);
+    return true;
+}
+
+const char *Replay_Commands(void)
+{
+    return commands;
+}
+
+void Replay_Input(int fd)
+{
+    input = fd;
+}
@@ -0,0 +1,59 @@
+/// @file Replay.h replay of a recorded cast through the host build
+///
+/// gauge --replay CAST feeds a cast the gauge recorded, its millis;T;P csv
+/// log, back into the sensors: the probes read column T, the pressure ADC
+/// gives the counts that calibrate to column P. The times are the board's
+/// own, ms since power up, so the firmware's log of the replay lines up
+/// with the cast; before the first point the sensors hold its values.
+///
+/// The board types Format (--replay-format, csv by default), Cal and Mode 1
+/// at the cast's mean sample period into the console, and Mode 0 one period
+/// after the last point; the run ends when the firmware idles. --speed 100 replays at 100 times real time,
+/// without --speed the run goes flat out. The console output is thrown
+/// away but still takes its time on the line.
+///
+/// When the run ends the firmware's log file is copied out of the card
+/// image and a summary goes to stderr: virtual and wall time, sample
+/// ticks, ticks the sample clock flagged (late, skipped or overrun),
+/// records logged and the longest log append. tools/replaydiff checks the
+/// copy against the cast for dropped, reordered and wrong samples, a bin
+/// log after tools/logdecode.
+///
+/// The calibration is offset 0 and a gain of 1000 milli-units per full
+/// scale times a power of ten, the smallest with the cast's peak pressure
+/// below 80 % of it. The firmware takes no sample with P at or below
+/// 0.001 or at 100 and above, or T at exactly 0, such points show up as
+/// gaps.
+///
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "Signal.h"
+
+/// Load a cast into the sensor signals and set up the run
+///
+/// @param cast is the cast file
+/// @param temp is the probes' temperature
+/// @param adc is the pressure ADC counts
+/// @param format is the log format, csv or bin
+/// @param log is the file the firmware's log is copied to
+/// @returns false if the cast cannot be read or has less than two points
+bool Replay_Start(const char *cast, Signal *temp, Signal *adc, const char *format, const char *log);
+
+/// @returns the console input that starts the run
+const char *Replay_Commands(void);
+
+/// Hand over the write end of the console input, the end of the cast
+/// types Mode 0 into it and closes it
+///
+/// @param fd is the descriptor
+void Replay_Input(int fd);
+
+/// Copy a file from the card image, outside of the firmware's time
+///
+/// @param name is the file on the card
+/// @param to is the host file
+/// @returns false if either cannot be opened or the copy fails
+bool Board_CopyOut(const char *name, const char *to);
+
+#endif // REPLAY_H
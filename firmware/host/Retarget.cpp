@@ -0,0 +1,170 @@
+/// @file Retarget.cpp C library file calls onto the mounted mbed file systems
+///
+/// On the target mbed's retarget layer hands a path like "/sd/LOG001.CSV"
+/// to the FileSystemLike mounted as "sd". Here fopen(), remove(), rename()
+/// and mkdir() do the same and pass any other path on to the C library;
+/// opendir(), readdir() and closedir() use the mbed DIR, so they only know
+/// the mounted file systems.
+///
+/// A mounted file becomes a FILE through fopencookie() with newlib's 1024
+/// byte buffer, so the file system sees writes of the same size as on the
+/// target.
+///
+#include <errno.h>
+#include <dlfcn.h>
+#include "mbed.h"
+#include "FileSystemLike.h"
+#include "Bench.h"
+
+#define NEWLIB_BUFSIZ   1024
+
+static uint64_t written;                // bytes stdio wrote to mounted files
+
+// the file system of a path, and the path within it
+static FileSystemLike *mounted(const char *path, const char **rest)
+{
+    if (path[0] != '/')
+        return NULL;
+    const char *name = path + 1;
+    const char *end = strchr(name, '/');
+    unsigned len = end ? (unsigned)(end - name) : strlen(name);
+    FileBase *fb = FileBase::lookup(name, len);
+    if (fb == NULL || fb->getPathType() != FileSystemPathType)
+        return NULL;
+    *rest = end ? end + 1 : "";
+    return (FileSystemLike *)fb;
+}
+
+template<typename F>
+static F real(const char *name)
+{
+    return (F)dlsym(RTLD_NEXT, name);
+}
+
+static ssize_t cookie_read(void *cookie, char *buf, size_t size)
+{
+    return ((FileHandle *)cookie)->read(buf, size);
+}
+
+static ssize_t cookie_write(void *cookie, const char *buf, size_t size)
+{
+    ssize_t n = ((FileHandle *)cookie)->write(buf, size);
+    if (n < 0)
+        return 0;                       // 0 is the error of a cookie write
+    written += n;
+    return n;
+}
+
+static int cookie_seek(void *cookie, off64_t *pos, int whence)
+{
+    off_t r = ((FileHandle *)cookie)->lseek(*pos, whence);
+    if (r < 0)
+        return -1;
+    *pos = r;
+    return 0;
+}
+
+static int cookie_close(void *cookie)
+{
+    return ((FileHandle *)cookie)->close();
+}
+
+uint64_t Retarget_Written(void)
+{
+    return written;
+}
+
+extern "C" FILE *fopen(const char *path, const char *mode)
+{
+    const char *rest;
+    FileSystemLike *fs = mounted(path, &rest);
+    if (fs == NULL)
+        return real<FILE *(*)(const char *, const char *)>("fopen")(path, mode);
+
+    // the mode to open() flags, as the mbed retarget does
+    int flags;
+    bool plus = strchr(mode, '+') != NULL;
+    switch (mode[0]) {
+    case 'r':
+        flags = plus ? O_RDWR : O_RDONLY;
+        break;
+    case 'w':
+        flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC;
+        break;
+    case 'a':
+        flags = (plus ? O_RDWR : O_WRONLY) | O_CREAT | O_APPEND;
+        break;
+    default:
+        errno = EINVAL;
+        return NULL;
+    }
+    FileHandle *fh = fs->open(rest, flags);
+    if (fh == NULL) {
+        errno = ENOENT;
+        return NULL;
+    }
+    cookie_io_functions_t io = { cookie_read, cookie_write, cookie_seek, cookie_close };
+    FILE *f = fopencookie(fh, mode, io);
+    if (f == NULL) {
+        fh->close();
+        return NULL;
+    }
+    setvbuf(f, NULL, _IOFBF, NEWLIB_BUFSIZ);
+    return f;
+}
+
+extern "C" int remove(const char *path)
+{
+    const char *rest;
+    FileSystemLike *fs = mounted(path, &rest);
+    if (fs == NULL)
+        return real<int (*)(const char *)>("remove")(path);
+    return fs->remove(rest);
+}
+
+extern "C" int rename(const char *oldpath, const char *newpath)
+{
+    const char *oldrest, *newrest;
+    FileSystemLike *fs = mounted(oldpath, &oldrest);
+    if (fs == NULL)
+        return real<int (*)(const char *, const char *)>("rename")(oldpath, newpath);
+    if (mounted(newpath, &newrest) != fs) {
+        errno = EXDEV;
+        return -1;
+    }
+    return fs->rename(oldrest, newrest);
+}
+
+extern "C" int mkdir(const char *path, mode_t mode)
+{
+    const char *rest;
+    FileSystemLike *fs = mounted(path, &rest);
+    if (fs == NULL)
+        return real<int (*)(const char *, mode_t)>("mkdir")(path, mode);
+    return fs->mkdir(rest, mode);
+}
+
+extern "C" DIR *opendir(const char *path)
+{
+    const char *rest;
+    FileSystemLike *fs = mounted(path, &rest);
+    if (fs == NULL) {
+        errno = ENOENT;
+        return NULL;
+    }
+    return fs->opendir(rest);
+}
+
+extern "C" struct dirent *readdir(DIR *dir)
+{
+    return dir->readdir();
+}
+
+extern "C" int closedir(DIR *dir)
+{
+    if (dir == NULL) {
+        errno = EBADF;
+        return -1;
+    }
+    return dir->closedir();
+}
@@ -0,0 +1,316 @@
+/// @file SdCard.cpp SDHC card in SPI mode, backed by an image file
+///
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "mbed.h"
+#include "SDCRC.h"
+#include "SdCard.h"
+
+#define SD_INIT_NS      50000000ULL     // ACMD41 keeps answering idle this long
+#define SD_CSD_NS       100000ULL       // from CMD9 to the CSD
+
+static const SD_LATENCY_T profiles[] = {
+    //  name       read  write  stall  every
+    { "ideal",        0,     0,      0,   0 },
+    { "fast",       100,   250,  20000, 256 },
+    { "typical",    500,  1000, 100000, 128 },
+    { "slow",      1500,  3000, 350000,  32 },
+};
+
+const SD_LATENCY_T *SdCard_Profile(const char *name)
+{
+    for (unsigned i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+        if (!strcmp(name, profiles[i].name))
+            return &profiles[i];
+    }
+    return NULL;
+}
+
+SdCard::SdCard(PinName cs) : _cs(cs), _fd(-1), _blocks(0), _lat(&profiles[2]),
+    _idle(true), _app(false), _crc(false), _init_at(0), _busy(0), _cmdlen(0),
+    _rhead(0), _rlen(0), _bpos(0), _blen(0), _block_at(0), _rx(RX_CMD),
+    _multi(false), _reading(false), _addr(0), _dlen(0), _written(0), _reads(0), _writes(0)
+{
+}
+
+SdCard::~SdCard()
+{
+    if (_fd >= 0)
+        close(_fd);
+}
+
+bool SdCard::open(const char *file, unsigned mbytes, bool *created)
+{
+    _fd = ::open(file, O_RDWR | O_CREAT, 0644);
+    if (_fd < 0)
+        return false;
+    struct stat st;
+    fstat(_fd, &st);
+    *created = st.st_size == 0;
+    if (*created && ftruncate(_fd, (off_t)mbytes << 20) < 0)
+        return false;
+    fstat(_fd, &st);
+    _blocks = (uint32_t)(st.st_size >> 19) << 10;     // C_SIZE counts 512 kB
+    return _blocks > 0;
+}
+
+bool SdCard::read(uint32_t block, uint8_t *data)
+{
+    if (block >= _blocks)
+        return false;
+    return pread(_fd, data, 512, (off_t)block * 512) == 512;
+}
+
+bool SdCard::write(uint32_t block, const uint8_t *data)
+{
+    if (block >= _blocks)
+        return false;
+    return pwrite(_fd, data, 512, (off_t)block * 512) == 512;
+}
+
+int SdCard::transfer(int out, int bits)
+{
+    if (Sim_PinRead(_cs)) {
+        _cmdlen = 0;                    // deselected, DO floats high
+        return (1 << bits) - 1;
+    }
+    if (bits == 16) {
+        int hi = xfer(out >> 8);
+        return (hi << 8) | xfer(out & 0xFF);
+    }
+    return xfer(out);
+}
+
+// one byte each way, what goes out was decided before this byte came in
+uint8_t SdCard::xfer(uint8_t in)
+{
+    uint64_t now = Sim_Nanos();
+    uint8_t out = 0xFF;
+    if (_rlen) {
+        out = _resp[_rhead];
+        _rhead = (_rhead + 1) % sizeof(_resp);
+        _rlen--;
+    } else if (_blen) {
+        if (now >= _block_at) {
+            out = _block[_bpos++];
+            if (_bpos == _blen) {
+                _blen = 0;
+                if (_reading) {
+                    uint8_t data[512];
+                    if (read(_addr, data)) {
+                        _reads++;
+                        queueBlock(data, 512, now + _lat->read_us * 1000ULL);
+                        _addr++;
+                    } else
+                        _reading = false;
+                }
+            }
+        }
+    } else if (now < _busy)
+        out = 0x00;
+
+    switch (_rx) {
+    case RX_CMD:
+        if (_cmdlen == 0 && (in & 0xC0) != 0x40)
+            break;
+        _cmd[_cmdlen++] = in;
+        if (_cmdlen == 6) {
+            _cmdlen = 0;
+            command();
+        }
+        break;
+    case RX_TOKEN:
+        if (in == (_multi ? 0xFC : 0xFE)) {
+            _rx = RX_DATA;
+            _dlen = 0;
+        } else if (in == 0xFD && _multi) {
+            _multi = false;             // stop tran, the last block is already programmed
+            _rx = RX_CMD;
+        } else if ((in & 0xC0) == 0x40) {
+            _multi = false;             // a command instead, CMD12 after an error
+            _rx = RX_CMD;
+            _cmd[0] = in;
+            _cmdlen = 1;
+        }
+        break;
+    case RX_DATA:
+        _data[_dlen++] = in;
+        if (_dlen == (int)sizeof(_data))
+            received();
+        break;
+    }
+    return out;
+}
+
+void SdCard::respond(uint8_t r1)
+{
+    _rhead = _rlen = 0;
+    _resp[_rlen++] = 0xFF;              // NCR, one byte
+    _resp[_rlen++] = r1;
+}
+
+void SdCard::queueBlock(const uint8_t *data, int len, uint64_t at)
+{
+    unsigned short crc = SDCRC::crc16((const char *)data, len);
+    _block[0] = 0xFE;
+    memcpy(&_block[1], data, len);
+    _block[len + 1] = crc >> 8;
+    _block[len + 2] = crc;
+    _blen = len + 3;
+    _bpos = 0;
+    _block_at = at;
+}
+
+void SdCard::command()
+{
+    uint64_t now = Sim_Nanos();
+    uint8_t cmd = _cmd[0] & 0x3F;
+    uint32_t arg = ((uint32_t)_cmd[1] << 24) | ((uint32_t)_cmd[2] << 16) | ((uint32_t)_cmd[3] << 8) | _cmd[4];
+    bool app = _app;
+    _app = false;
+    uint8_t r1 = _idle ? 0x01 : 0x00;
+
+    if ((_crc || cmd == 0 || cmd == 8) && ((SDCRC::crc7((const char *)_cmd, 5) << 1) | 0x01) != _cmd[5]) {
+        respond(r1 | 0x08);             // com crc error
+        return;
+    }
+
+    switch (cmd) {
+    case 0:                             // GO_IDLE_STATE
+        _idle = true;
+        _crc = false;
+        _init_at = 0;
+        _multi = _reading = false;
+        _blen = 0;
+        _rx = RX_CMD;
+        respond(0x01);
+        break;
+    case 8:                             // SEND_IF_COND, R7 echoes voltage and pattern
+        respond(r1);
+        _resp[_rlen++] = 0x00;
+        _resp[_rlen++] = 0x00;
+        _resp[_rlen++] = (arg >> 8) & 0x0F;
+        _resp[_rlen++] = arg & 0xFF;
+        break;
+    case 58: {                          // READ_OCR: 2.7-3.6 V, powered up and CCS once ready
+        uint32_t ocr = 0x00FF8000 | (_idle ? 0 : 0xC0000000);
+        respond(r1);
+        for (int i = 24; i >= 0; i -= 8)
+            _resp[_rlen++] = ocr >> i;
+        break;
+    }
+    case 55:                            // APP_CMD
+        _app = true;
+        respond(r1);
+        break;
+    case 59:                            // CRC_ON_OFF
+        _crc = arg & 1;
+        respond(r1);
+        break;
+    case 16:                            // SET_BLOCKLEN, fixed at 512 for SDHC
+        respond(arg == 512 ? r1 : r1 | 0x40);
+        break;
+    case 9: {                           // SEND_CSD, version 2.0
+        uint32_t csize = _blocks / 1024 - 1;
+        uint8_t csd[16] = { 0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00,
+                            (uint8_t)((csize >> 16) & 0x3F), (uint8_t)(csize >> 8), (uint8_t)csize,
+                            0x7F, 0x80, 0x0A, 0x40, 0x00, 0x00 };
+        csd[15] = (SDCRC::crc7((const char *)csd, 15) << 1) | 0x01;
+        respond(r1);
+        queueBlock(csd, 16, now + SD_CSD_NS);
+        break;
+    }
+    case 13:                            // SEND_STATUS, R2
+        respond(r1);
+        _resp[_rlen++] = 0x00;
+        break;
+    case 12:                            // STOP_TRANSMISSION
+        _reading = _multi = false;
+        _blen = 0;
+        _rx = RX_CMD;
+        respond(r1);
+        _rlen = 0;
+        _resp[_rlen++] = 0xFF;          // stuff byte
+        _resp[_rlen++] = 0xFF;
+        _resp[_rlen++] = r1;
+        break;
+    case 17:                            // READ_SINGLE_BLOCK
+    case 18: {                          // READ_MULTIPLE_BLOCK
+        uint8_t data[512];
+        if (!read(arg, data)) {
+            respond(r1 | 0x20);         // address error
+            break;
+        }
+        respond(r1);
+        _reads++;
+        queueBlock(data, 512, now + _lat->read_us * 1000ULL);
+        _reading = cmd == 18;
+        _addr = arg + 1;
+        break;
+    }
+    case 24:                            // WRITE_BLOCK
+    case 25:                            // WRITE_MULTIPLE_BLOCK
+        if (arg >= _blocks) {
+            respond(r1 | 0x20);
+            break;
+        }
+        respond(r1);
+        _multi = cmd == 25;
+        _addr = arg;
+        _written = 0;
+        _rx = RX_TOKEN;
+        break;
+    case 41:                            // SD_SEND_OP_COND
+        if (!app) {
+            respond(r1 | 0x04);
+            break;
+        }
+        if (!_init_at)
+            _init_at = now + SD_INIT_NS;
+        if (now >= _init_at)
+            _idle = false;
+        respond(_idle ? 0x01 : 0x00);
+        break;
+    case 22: {                          // SEND_NUM_WR_BLOCKS
+        if (!app) {
+            respond(r1 | 0x04);
+            break;
+        }
+        uint8_t n[4] = { (uint8_t)(_written >> 24), (uint8_t)(_written >> 16),
+                         (uint8_t)(_written >> 8), (uint8_t)_written };
+        respond(r1);
+        queueBlock(n, 4, now);
+        break;
+    }
+    case 23:                            // SET_WR_BLK_ERASE_COUNT
+    case 42:                            // SET_CLR_CARD_DETECT
+        respond(app ? r1 : r1 | 0x04);
+        break;
+    default:
+        respond(r1 | 0x04);             // illegal command
+        break;
+    }
+}
+
+// a data block came in
+void SdCard::received()
+{
+    unsigned short crc = (_data[512] << 8) | _data[513];
+    uint8_t token;
+    if (_crc && crc != SDCRC::crc16((const char *)_data, 512))
+        token = 0x0B;                   // CRC error
+    else if (!write(_addr, _data))
+        token = 0x0D;                   // write error
+    else {
+        token = 0x05;                   // accepted
+        _addr++;
+        _written++;
+        _writes++;
+        bool stall = _lat->stall_every && _writes % _lat->stall_every == 0;
+        _busy = Sim_Nanos() + (stall ? _lat->stall_us : _lat->write_us) * 1000ULL;
+    }
+    _rhead = _rlen = 0;
+    _resp[_rlen++] = token;
+    _rx = _multi ? RX_TOKEN : RX_CMD;
+}
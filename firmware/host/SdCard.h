@@ -0,0 +1,109 @@
+/// @file SdCard.h SDHC card in SPI mode, backed by an image file
+///
+/// The card answers SDFileSystem byte by byte the way a real card does:
+/// CMD0/8/58/55/41 bring it up as a high capacity v2 card, CMD9 gives a
+/// CSD for the image size, CMD17/18 read and CMD24/25 write blocks with
+/// their tokens, CRC16 and data response, CMD12 stops a transfer and
+/// CMD13 returns the status. CRC checking follows CMD59.
+///
+/// Reads and writes take time like flash does: a read block comes after
+/// an access latency, a written block keeps the card busy (MISO low) for
+/// its program time, and every so many blocks a much longer stall stands
+/// for the erase and wear leveling that make the worst case of a card.
+/// The profiles are fixed, runs are repeatable.
+///
+#ifndef SDCARD_H
+#define SDCARD_H
+
+#include "Sim.h"
+
+/// Timing of a card
+typedef struct {
+    const char *name;
+    uint32_t read_us;                   ///< from a read command to the data token
+    uint32_t write_us;                  ///< busy after each written block
+    uint32_t stall_us;                  ///< busy of a long stall instead
+    uint32_t stall_every;               ///< written blocks per long stall, 0 for none
+} SD_LATENCY_T;
+
+/// @returns the latency profile of a name (ideal, fast, typical, slow),
+///     NULL if there is none
+const SD_LATENCY_T *SdCard_Profile(const char *name);
+
+class SdCard : public SimSpiDevice {
+public:
+    /// @param cs is the chip select pin, the card answers while it is low
+    SdCard(PinName cs);
+    virtual ~SdCard();
+
+    /// Open the image, create it with a size if it does not exist
+    ///
+    /// @param file is the image file
+    /// @param mbytes is the size of a new image, a multiple of 512 kB is used
+    /// @param created is set true if the image is new
+    /// @returns false if the image cannot be opened or created
+    bool open(const char *file, unsigned mbytes, bool *created);
+
+    /// Set the latency profile, "typical" by default
+    void latency(const SD_LATENCY_T *profile) {
+        _lat = profile;
+    }
+
+    /// @returns the image size in 512 byte blocks
+    uint32_t blocks() const {
+        return _blocks;
+    }
+
+    /// Read and write a block of the image directly, no SPI and no time
+    bool read(uint32_t block, uint8_t *data);
+    bool write(uint32_t block, const uint8_t *data);
+
+    uint32_t blocksRead() const {
+        return _reads;
+    }
+    uint32_t blocksWritten() const {
+        return _writes;
+    }
+
+    virtual int transfer(int out, int bits);
+
+private:
+    uint8_t xfer(uint8_t in);
+    void command();
+    void respond(uint8_t r1);
+    void queueBlock(const uint8_t *data, int len, uint64_t at);
+    void received();
+
+    PinName  _cs;
+    int      _fd;
+    uint32_t _blocks;
+    const SD_LATENCY_T *_lat;
+
+    bool     _idle;                     // not yet initialized by ACMD41
+    bool     _app;                      // the previous command was CMD55
+    bool     _crc;                      // CMD59 turned CRC checking on
+    uint64_t _init_at;                  // ACMD41 finishes initialization then
+    uint64_t _busy;                     // MISO is held low until then
+
+    uint8_t  _cmd[6];
+    int      _cmdlen;
+
+    uint8_t  _resp[24];                 // response bytes, sent first
+    int      _rhead, _rlen;
+
+    uint8_t  _block[1 + 512 + 2];       // data token, data and CRC going out
+    int      _bpos, _blen;
+    uint64_t _block_at;                 // when the token may go
+
+    enum { RX_CMD, RX_TOKEN, RX_DATA } _rx;
+    bool     _multi;                    // CMD25 in progress
+    bool     _reading;                  // CMD18 in progress
+    uint32_t _addr;                     // next block of the transfer
+    uint8_t  _data[512 + 2];
+    int      _dlen;
+    uint32_t _written;                  // blocks written by the latest write command, for ACMD22
+
+    uint32_t _reads, _writes;
+};
+
+#endif // SDCARD_H
@@ -0,0 +1,103 @@
+/// @file Signal.cpp sensor values of the simulated board over time
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Signal.h"
+
+Signal::Signal(double value) : _value(value), _points(NULL), _count(0), _at(0)
+{
+}
+
+Signal::~Signal()
+{
+    free(_points);
+}
+
+void Signal::set(double value)
+{
+    free(_points);
+    _points = NULL;
+    _count = 0;
+    _at = 0;
+    _value = value;
+}
+
+bool Signal::load(const char *file, int column)
+{
+    FILE *f = fopen(file, "r");
+    if (f == NULL)
+        return false;
+    char line[256];
+    int size = 0;
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line, *end;
+        double ms = strtod(p, &end);
+        if (end == p)
+            continue;                   // a header or an empty line
+        double v = 0;
+        int col;
+        for (col = 0; col < column; col++) {
+            p = strchr(end, ';');
+            if (p == NULL)
+                break;
+            v = strtod(p + 1, &end);
+        }
+        if (col < column)
+            continue;
+        if (_count == size) {
+            size = size ? 2 * size : 1024;
+            _points = (point *)realloc(_points, size * sizeof(point));
+        }
+        _points[_count].us = (uint64_t)(ms * 1000);
+        _points[_count].v = v;
+        _count++;
+    }
+    fclose(f);
+    _at = 0;
+    return _count > 0;
+}
+
+void Signal::scale(double mul, double add)
+{
+    _value = _value * mul + add;
+    for (int i = 0; i < _count; i++)
+        _points[i].v = _points[i].v * mul + add;
+}
+
+double Signal::peak() const
+{
+    if (!_count)
+        return _value;
+    double v = _points[0].v;
+    for (int i = 1; i < _count; i++) {
+        if (_points[i].v > v)
+            v = _points[i].v;
+    }
+    return v;
+}
+
+double Signal::value(uint64_t us)
+{
+    if (!_count)
+        return _value;
+    if (us < _points[_at].us)
+        _at = 0;
+    while (_at + 1 < _count && _points[_at + 1].us <= us)
+        _at++;
+    const point *a = &_points[_at];
+    if (_at + 1 == _count || us <= a->us)
+        return a->v;
+    const point *b = a + 1;
+    return a->v + (b->v - a->v) * (double)(us - a->us) / (double)(b->us - a->us);
+}
+
+uint16_t Signal::sample(uint64_t us)
+{
+    double v = value(us);
+    if (v < 0)
+        return 0;
+    if (v > 65535)
+        return 65535;
+    return (uint16_t)(v + 0.5);
+}
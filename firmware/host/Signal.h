@@ -0,0 +1,68 @@
+/// @file Signal.h sensor values of the simulated board over time
+///
+/// A Signal is a constant, or a table of (time, value) points read from a
+/// file and interpolated linearly between them; before the first point it
+/// holds the first value, after the last one the last. The file has one
+/// point per line, the time in ms and the values separated by ';' like the
+/// csv log (millis;T;P), column selects the value.
+///
+/// As an analog source sample() returns the value as a 16 bit ADC reading.
+///
+#ifndef SIGNAL_H
+#define SIGNAL_H
+
+#include "Sim.h"
+
+class Signal : public SimSignal {
+public:
+    /// @param value is the constant value
+    Signal(double value = 0);
+    virtual ~Signal();
+
+    /// Make the signal a constant, the points are dropped
+    void set(double value);
+
+    /// Read the points from a file
+    ///
+    /// @param file is the file name
+    /// @param column is the value column, 1 is the first after the time
+    /// @returns false if the file cannot be read or has no points
+    bool load(const char *file, int column);
+
+    /// Map the value linearly, value * mul + add, points and constant
+    void scale(double mul, double add);
+
+    /// @returns the time of the first and the last point in us, 0 for a constant
+    uint64_t first() const {
+        return _count ? _points[0].us : 0;
+    }
+    uint64_t last() const {
+        return _count ? _points[_count - 1].us : 0;
+    }
+
+    /// @returns the number of points
+    int count() const {
+        return _count;
+    }
+
+    /// @returns the largest value, the constant if there are no points
+    double peak() const;
+
+    /// @param us is the virtual time
+    /// @returns the value at that time
+    double value(uint64_t us);
+
+    virtual uint16_t sample(uint64_t us);
+
+private:
+    struct point {
+        uint64_t us;
+        double   v;
+    };
+    double _value;
+    point *_points;
+    int    _count;
+    int    _at;                         // last segment used, time moves forward
+};
+
+#endif // SIGNAL_H
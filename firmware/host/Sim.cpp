@@ -0,0 +1,402 @@
+/// @file Sim.cpp virtual clock and simulated board of the host build
+///
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include "Sim.h"
+
+#define SIM_PINS        256     // PinName is one byte on this board
+#define SIM_PIN_DEVICES 8
+#define SIM_WATCHES     4
+#define SIM_POLL_NS     1000000ULL      // look for input this often while time passes
+#define SIM_BEHIND_NS   50000000ULL     // further behind the wall clock than this, give up catching up
+
+static uint64_t  now_ns = 0;
+static SimEvent *head = NULL;           // sorted by time, FIFO for equal times
+static int       masked = 0;
+static bool      in_irq = false;
+
+static double    speed = 1.0;
+static uint64_t  wall0, virt0;          // pacing anchor
+static bool      anchored = false;
+static uint64_t  stop_us = 0;
+static bool      input_ended = false;
+static uint64_t  next_poll = 0;
+
+static uint64_t wall_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void anchor(void)
+{
+    wall0 = wall_ns();
+    virt0 = now_ns;
+    anchored = true;
+}
+
+// wall clock time at which the virtual clock reaches virt
+static uint64_t wall_at(uint64_t virt)
+{
+    return wall0 + (uint64_t)((virt - virt0) / speed);
+}
+
+// hold the virtual clock back to the wall clock
+static void pace(void)
+{
+    if (speed <= 0)
+        return;
+    if (!anchored)
+        anchor();
+    uint64_t wall = wall_ns();
+    uint64_t due = wall_at(now_ns);
+    if (due > wall + 2000000) {
+        struct timespec ts;
+        ts.tv_sec = (due - wall) / 1000000000ULL;
+        ts.tv_nsec = (due - wall) % 1000000000ULL;
+        nanosleep(&ts, NULL);
+    } else if (wall > due + SIM_BEHIND_NS)
+        anchor();
+}
+
+uint64_t Sim_Now(void)
+{
+    return now_ns / 1000;
+}
+
+uint64_t Sim_Nanos(void)
+{
+    return now_ns;
+}
+
+void Sim_Speed(double factor)
+{
+    speed = factor;
+    anchored = false;
+}
+
+void Sim_StopAt(uint64_t us)
+{
+    stop_us = us;
+}
+
+void Sim_EndOfInput(void)
+{
+    input_ended = true;
+}
+
+// --- events
+
+SimEvent::SimEvent() : _next(NULL), _at(0), _queued(false)
+{
+}
+
+SimEvent::~SimEvent()
+{
+    cancel();
+}
+
+void SimEvent::schedule(uint64_t at_ns)
+{
+    cancel();
+    _at = at_ns;
+    SimEvent **p = &head;
+    while (*p && (*p)->_at <= at_ns)
+        p = &(*p)->_next;
+    _next = *p;
+    *p = this;
+    _queued = true;
+}
+
+void SimEvent::cancel()
+{
+    if (!_queued)
+        return;
+    for (SimEvent **p = &head; *p; p = &(*p)->_next) {
+        if (*p == this) {
+            *p = _next;
+            break;
+        }
+    }
+    _queued = false;
+}
+
+// run the events that are due, one interrupt at a time
+void sim_dispatch(void)
+{
+    if (masked || in_irq)
+        return;
+    while (head && head->_at <= now_ns) {
+        SimEvent *e = head;
+        head = e->_next;
+        e->_queued = false;
+        in_irq = true;
+        e->fire();
+        in_irq = false;
+    }
+}
+
+void Sim_IrqDisable(void)
+{
+    masked++;
+}
+
+void Sim_IrqEnable(void)
+{
+    if (masked && --masked == 0)
+        sim_dispatch();
+}
+
+bool Sim_IrqEnabled(void)
+{
+    return !masked && !in_irq;
+}
+
+// --- input
+
+static struct {
+    int fd;
+    void (*func)(void *);
+    void *arg;
+} watches[SIM_WATCHES];
+static int nwatches = 0;
+
+void Sim_Watch(int fd, void (*func)(void *), void *arg)
+{
+    Sim_Unwatch(fd);
+    if (nwatches == SIM_WATCHES)
+        return;
+    watches[nwatches].fd = fd;
+    watches[nwatches].func = func;
+    watches[nwatches].arg = arg;
+    nwatches++;
+}
+
+void Sim_Unwatch(int fd)
+{
+    for (int i = 0; i < nwatches; i++) {
+        if (watches[i].fd == fd) {
+            watches[i] = watches[--nwatches];
+            return;
+        }
+    }
+}
+
+// wait up to timeout_ms (-1 forever) for input, run the callbacks of what came
+static bool poll_input(int timeout_ms)
+{
+    struct pollfd fds[SIM_WATCHES];
+    for (int i = 0; i < nwatches; i++) {
+        fds[i].fd = watches[i].fd;
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+    if (poll(fds, nwatches, timeout_ms) <= 0)
+        return false;
+    for (int i = nwatches - 1; i >= 0; i--) {   // a callback may unwatch itself
+        if (fds[i].revents)
+            watches[i].func(watches[i].arg);
+    }
+    return true;
+}
+
+static void check_stop(void)
+{
+    if (stop_us && now_ns >= stop_us * 1000) {
+        fprintf(stderr, "sim: stopped at %.3f s\n", now_ns / 1e9);
+        exit(0);
+    }
+}
+
+// --- clock
+
+void Sim_Advance(uint64_t ns)
+{
+    uint64_t end = now_ns + ns;
+    while (!masked && !in_irq && head && head->_at <= end) {
+        if (head->_at > now_ns)
+            now_ns = head->_at;
+        pace();
+        check_stop();
+        sim_dispatch();
+    }
+    if (end > now_ns)
+        now_ns = end;
+    pace();
+    check_stop();
+    if (now_ns >= next_poll) {
+        next_poll = now_ns + SIM_POLL_NS;
+        poll_input(0);
+        sim_dispatch();
+    }
+}
+
+void Sim_Idle(void)
+{
+    if (head && head->_at <= now_ns)
+        return;                         // an interrupt is pending, it ends the sleep at once
+    if (input_ended && !stop_us) {
+        fprintf(stderr, "sim: end of input at %.3f s\n", now_ns / 1e9);
+        exit(0);
+    }
+    if (!head && !nwatches) {
+        fprintf(stderr, "sim: nothing left to wake up at %.3f s\n", now_ns / 1e9);
+        exit(0);
+    }
+
+    uint64_t next = head ? head->_at : 0;
+    if (stop_us && (!next || next > stop_us * 1000))
+        next = stop_us * 1000;
+    int timeout = -1;
+    if (next && speed > 0) {
+        if (!anchored)
+            anchor();
+        uint64_t wall = wall_ns(), due = wall_at(next);
+        timeout = due > wall ? (int)((due - wall + 999999) / 1000000) : 0;
+    } else if (next)
+        timeout = 0;
+
+    if (poll_input(timeout)) {
+        // input came first: the clock moves to when it came
+        uint64_t t = now_ns;
+        if (speed > 0)
+            t = virt0 + (uint64_t)((wall_ns() - wall0) * speed);
+        if (next && t > next)
+            t = next;
+        if (t > now_ns)
+            now_ns = t;
+    } else if (next)
+        now_ns = next;
+    next_poll = now_ns + SIM_POLL_NS;
+    check_stop();
+}
+
+// --- pins
+
+struct pin {
+    int drive;                          // -1 released, 0 or 1 driven by the firmware
+    int pull;
+    int ext;                            // -1, or the level set from outside
+    SimPinDevice *dev[SIM_PIN_DEVICES];
+    int ndev;
+    SimEdge *listener;
+};
+
+static pin pins[SIM_PINS];
+static bool pins_ready = false;
+
+static pin *find(PinName name)
+{
+    if (!pins_ready) {
+        for (int i = 0; i < SIM_PINS; i++) {
+            pins[i].drive = -1;
+            pins[i].pull = 1;
+            pins[i].ext = -1;
+        }
+        pins_ready = true;
+    }
+    if (name == NC || (unsigned)name >= SIM_PINS)
+        return NULL;
+    return &pins[name];
+}
+
+static int level(pin *p)
+{
+    if (p->drive >= 0)
+        return p->drive;
+    for (int i = 0; i < p->ndev; i++) {
+        if (p->dev[i]->pulling())
+            return 0;
+    }
+    return p->ext >= 0 ? p->ext : p->pull;
+}
+
+static void tell(pin *p, int before)
+{
+    int after = level(p);
+    if (p->listener && after != before)
+        p->listener->edge(after);
+}
+
+void Sim_PinDrive(PinName name, int lvl)
+{
+    pin *p = find(name);
+    if (!p || p->drive == lvl)
+        return;
+    int before = level(p);
+    bool waslow = p->drive == 0;
+    p->drive = lvl;
+    if (waslow != (lvl == 0)) {
+        for (int i = 0; i < p->ndev; i++)
+            p->dev[i]->driven(lvl == 0);
+    }
+    tell(p, before);
+}
+
+int Sim_PinRead(PinName name)
+{
+    pin *p = find(name);
+    return p ? level(p) : 0;
+}
+
+void Sim_PinPull(PinName name, int lvl)
+{
+    pin *p = find(name);
+    if (p)
+        p->pull = lvl;
+}
+
+void Sim_PinAttach(PinName name, SimPinDevice *dev)
+{
+    pin *p = find(name);
+    if (p && p->ndev < SIM_PIN_DEVICES)
+        p->dev[p->ndev++] = dev;
+}
+
+void Sim_PinListen(PinName name, SimEdge *listener)
+{
+    pin *p = find(name);
+    if (p)
+        p->listener = listener;
+}
+
+void Sim_PinSet(PinName name, int lvl)
+{
+    pin *p = find(name);
+    if (!p)
+        return;
+    int before = level(p);
+    p->ext = lvl;
+    tell(p, before);
+}
+
+// --- buses
+
+static SimSpiDevice *spi[SIM_PINS];
+static SimSignal *analog[SIM_PINS];
+
+void Sim_SpiAttach(PinName sclk, SimSpiDevice *dev)
+{
+    if (sclk != NC && (unsigned)sclk < SIM_PINS)
+        spi[sclk] = dev;
+}
+
+SimSpiDevice *Sim_Spi(PinName sclk)
+{
+    return sclk != NC && (unsigned)sclk < SIM_PINS ? spi[sclk] : NULL;
+}
+
+void Sim_AnalogAttach(PinName pin, SimSignal *sig)
+{
+    if (pin != NC && (unsigned)pin < SIM_PINS)
+        analog[pin] = sig;
+}
+
+SimSignal *Sim_Analog(PinName pin)
+{
+    return pin != NC && (unsigned)pin < SIM_PINS ? analog[pin] : NULL;
+}
@@ -0,0 +1,188 @@
+/// @file Sim.h virtual clock and simulated board of the host build
+///
+/// The host build runs the firmware as a Linux program. Its time is
+/// virtual: time passes only while the firmware waits (wait_us(), clocking
+/// bytes over SPI, sending a character, polling a busy card) or sleeps, and
+/// then jumps straight to the next timer event. Code itself takes no time,
+/// so a run is repeatable. Sim_Speed() paces the clock against the wall
+/// clock, 1 for real time, 10 for ten times faster, 0 as fast as the host
+/// can.
+///
+/// Timer events are the interrupts of the simulation: they run when the
+/// clock passes their time, unless a critical section holds them back, as
+/// nested calls from whatever code moved the clock.
+///
+/// The board is a table of pin levels. Drivers drive and read pins,
+/// simulated devices hang on them: 1-Wire slaves pull a line low, an SPI
+/// device answers on its clock pin, a signal source feeds an analog pin.
+///
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include "PinNames.h"
+
+/// @returns the virtual time in us
+uint64_t Sim_Now(void);
+
+/// @returns the virtual time in ns
+uint64_t Sim_Nanos(void);
+
+/// Let time pass, the events that come due run on the way
+///
+/// @param ns is the time to pass
+void Sim_Advance(uint64_t ns);
+
+/// Sleep until the next event or input, for sleep() with interrupts masked
+void Sim_Idle(void);
+
+/// Pace the virtual clock
+///
+/// @param factor is virtual time per wall clock time, 0 does not pace
+void Sim_Speed(double factor);
+
+/// End the run when the virtual clock reaches a time
+///
+/// @param us is the time, 0 for no limit
+void Sim_StopAt(uint64_t us);
+
+/// Tell that no more input will come, the run ends when it goes idle
+/// unless Sim_StopAt() set the end
+void Sim_EndOfInput(void);
+
+/// Mask and unmask the events, nested like critical sections
+void Sim_IrqDisable(void);
+void Sim_IrqEnable(void);
+
+/// @returns true if events may run
+bool Sim_IrqEnabled(void);
+
+/// A timer event, the interrupt handler is fire()
+class SimEvent {
+public:
+    SimEvent();
+    virtual ~SimEvent();
+
+    /// Run fire() at a virtual time, replacing an earlier schedule
+    ///
+    /// @param at_ns is the time, a past time runs at the next chance
+    void schedule(uint64_t at_ns);
+
+    /// Take the event off the queue
+    void cancel();
+
+    /// @returns true if the event is scheduled
+    bool pending() const {
+        return _queued;
+    }
+
+protected:
+    virtual void fire() = 0;
+
+private:
+    friend void sim_dispatch(void);
+    friend void Sim_Idle(void);
+    friend void Sim_Advance(uint64_t ns);
+    SimEvent *_next;
+    uint64_t  _at;
+    bool      _queued;
+};
+
+/// Watch a file descriptor for input, the callback runs when it is readable
+///
+/// @param fd is the descriptor
+/// @param func is called with arg, outside of any event
+/// @param arg is handed to func
+void Sim_Watch(int fd, void (*func)(void *), void *arg);
+
+/// Stop watching a file descriptor
+void Sim_Unwatch(int fd);
+
+/// Something on a pin, told about the levels the firmware drives
+class SimPinDevice {
+public:
+    virtual ~SimPinDevice() {}
+
+    /// The firmware changed the level it drives, or released the line
+    ///
+    /// @param low is true while the firmware pulls the line low
+    virtual void driven(bool low) {
+    }
+
+    /// @returns true while the device pulls the line low
+    virtual bool pulling() {
+        return false;
+    }
+};
+
+/// Drive a pin from the firmware side
+///
+/// @param pin is the pin
+/// @param level is 0 or 1, -1 releases the line to its pull
+void Sim_PinDrive(PinName pin, int level);
+
+/// @returns the level on a pin: what the firmware drives, else 0 if a
+/// device pulls it low, else its pull
+int Sim_PinRead(PinName pin);
+
+/// Set the pull of a released pin
+///
+/// @param pin is the pin
+/// @param level is 1 for a pullup, 0 for a pulldown
+void Sim_PinPull(PinName pin, int level);
+
+/// Put a device on a pin, a pin carries up to SIM_PIN_DEVICES
+void Sim_PinAttach(PinName pin, SimPinDevice *dev);
+
+/// An edge listener on a pin, InterruptIn
+class SimEdge {
+public:
+    virtual ~SimEdge() {}
+    virtual void edge(bool rise) = 0;
+};
+
+/// Listen to the edges of a pin, one listener per pin
+void Sim_PinListen(PinName pin, SimEdge *listener);
+
+/// Set a pin from outside, a switch or a line into the board
+///
+/// @param pin is the pin
+/// @param level is its new level, a change runs the edge listener
+void Sim_PinSet(PinName pin, int level);
+
+/// A device on an SPI bus, it looks at its own chip select
+class SimSpiDevice {
+public:
+    virtual ~SimSpiDevice() {}
+
+    /// Clock one frame
+    ///
+    /// @param out is what the firmware sends
+    /// @param bits is the frame size, 8 or 16
+    /// @returns what the device sends back, all ones when it is not selected
+    virtual int transfer(int out, int bits) = 0;
+};
+
+/// Put a device on the SPI bus of a clock pin, one per bus
+void Sim_SpiAttach(PinName sclk, SimSpiDevice *dev);
+
+/// @returns the device on the bus of a clock pin, NULL if there is none
+SimSpiDevice *Sim_Spi(PinName sclk);
+
+/// An analog signal
+class SimSignal {
+public:
+    virtual ~SimSignal() {}
+
+    /// @param us is the virtual time
+    /// @returns the 16 bit ADC reading at that time
+    virtual uint16_t sample(uint64_t us) = 0;
+};
+
+/// Feed an analog pin, one signal per pin
+void Sim_AnalogAttach(PinName pin, SimSignal *sig);
+
+/// @returns the signal of an analog pin, NULL if there is none
+SimSignal *Sim_Analog(PinName pin);
+
+#endif // SIM_H
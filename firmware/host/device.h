@@ -0,0 +1,17 @@
+/// @file device.h device capabilities of the host build
+///
+/// The drivers of the host build are in mbed.h, the DEVICE_ flags only
+/// serve the mbed headers that are shared with the target. DEVICE_SLEEP is
+/// off so hal/sleep_api.h does not declare sleep() against the C library.
+///
+#ifndef MBED_DEVICE_H
+#define MBED_DEVICE_H
+
+#define DEVICE_SERIAL           1
+#define DEVICE_SPI              1
+#define DEVICE_ANALOGIN         1
+#define DEVICE_INTERRUPTIN      1
+#define DEVICE_STDIO_MESSAGES   1
+#define DEVICE_SLEEP            0
+
+#endif
@@ -0,0 +1,365 @@
+/// @file mbed.h the mbed API of the host build
+///
+/// Stands in for mbed/mbed.h when the firmware is built as a Linux program.
+/// The plain C++ parts of mbed (Callback, CircularBuffer, the file system
+/// base classes) come from the mbed tree, the drivers are declared here
+/// with the signatures the firmware uses and run on the simulated board of
+/// Sim.h. Only what the firmware uses is there.
+///
+#ifndef MBED_H
+#define MBED_H
+
+#define MBED_LIBRARY_VERSION 137
+#define MBED_MAJOR_VERSION 2
+#define MBED_MINOR_VERSION 0
+#define MBED_PATCH_VERSION MBED_LIBRARY_VERSION
+
+#include "platform/toolchain.h"
+#include "platform/platform.h"
+
+#include <math.h>
+#include <time.h>
+
+#include "platform/mbed_error.h"
+#include "platform/mbed_assert.h"
+#include "platform/wait_api.h"
+#include "platform/critical.h"
+#include "platform/Callback.h"
+#include "platform/CircularBuffer.h"
+#include "hal/us_ticker_api.h"
+#include "hal/pinmap.h"
+#include "Sim.h"
+
+/// The Cortex-M interrupt mask, the events of the simulation
+static inline void __disable_irq(void)
+{
+    Sim_IrqDisable();
+}
+
+static inline void __enable_irq(void)
+{
+    Sim_IrqEnable();
+}
+
+/// Sleep until an interrupt, pending ones end it at once even when masked
+static inline void sleep(void)
+{
+    Sim_Idle();
+}
+
+static inline void deepsleep(void)
+{
+    Sim_Idle();
+}
+
+namespace mbed {
+
+class DigitalOut {
+public:
+    DigitalOut(PinName pin, int value = 0) : _pin(pin) {
+        write(value);
+    }
+    void write(int value) {
+        _value = value ? 1 : 0;
+        Sim_PinDrive(_pin, _value);
+    }
+    int read() {
+        return _value;
+    }
+    int is_connected() {
+        return _pin != NC;
+    }
+    DigitalOut &operator=(int value) {
+        write(value);
+        return *this;
+    }
+    DigitalOut &operator=(DigitalOut &rhs) {
+        write(rhs.read());
+        return *this;
+    }
+    operator int() {
+        return read();
+    }
+private:
+    PinName _pin;
+    int     _value;
+};
+
+class DigitalIn {
+public:
+    DigitalIn(PinName pin, PinMode pull = PullDefault) : _pin(pin) {
+        mode(pull);
+    }
+    int read() {
+        return Sim_PinRead(_pin);
+    }
+    void mode(PinMode pull) {
+        pin_mode(_pin, pull);
+    }
+    int is_connected() {
+        return _pin != NC;
+    }
+    operator int() {
+        return read();
+    }
+private:
+    PinName _pin;
+};
+
+/// An input or push-pull output, or with mode(OpenDrain) an output that
+/// releases the line for a 1
+class DigitalInOut {
+public:
+    DigitalInOut(PinName pin) : _pin(pin), _value(1), _output(false), _od(false) {
+    }
+    DigitalInOut(PinName pin, PinDirection direction, PinMode pull, int value)
+        : _pin(pin), _value(value ? 1 : 0), _output(direction == PIN_OUTPUT), _od(false) {
+        mode(pull);
+        apply();
+    }
+    void write(int value) {
+        _value = value ? 1 : 0;
+        apply();
+    }
+    int read() {
+        return Sim_PinRead(_pin);
+    }
+    void output() {
+        _output = true;
+        apply();
+    }
+    void input() {
+        _output = false;
+        apply();
+    }
+    void mode(PinMode pull) {
+        _od = pull == OpenDrain;
+        if (!_od)
+            pin_mode(_pin, pull);
+        apply();
+    }
+    int is_connected() {
+        return _pin != NC;
+    }
+    DigitalInOut &operator=(int value) {
+        write(value);
+        return *this;
+    }
+    operator int() {
+        return read();
+    }
+private:
+    void apply() {
+        if (!_output || (_od && _value))
+            Sim_PinDrive(_pin, -1);
+        else
+            Sim_PinDrive(_pin, _value);
+    }
+    PinName _pin;
+    int     _value;
+    bool    _output;
+    bool    _od;
+};
+
+class InterruptIn : private SimEdge {
+public:
+    InterruptIn(PinName pin) : _pin(pin), _enabled(true) {
+        Sim_PinListen(pin, this);
+    }
+    virtual ~InterruptIn() {
+        Sim_PinListen(_pin, NULL);
+    }
+    int read() {
+        return Sim_PinRead(_pin);
+    }
+    operator int() {
+        return read();
+    }
+    void rise(Callback<void()> func) {
+        _rise = func;
+    }
+    template<typename T>
+    void rise(T *obj, void (T::*method)()) {
+        _rise = callback(obj, method);
+    }
+    void fall(Callback<void()> func) {
+        _fall = func;
+    }
+    template<typename T>
+    void fall(T *obj, void (T::*method)()) {
+        _fall = callback(obj, method);
+    }
+    void mode(PinMode pull) {
+        pin_mode(_pin, pull);
+    }
+    void enable_irq() {
+        _enabled = true;
+    }
+    void disable_irq() {
+        _enabled = false;
+    }
+private:
+    virtual void edge(bool rise);
+    PinName _pin;
+    bool    _enabled;
+    Callback<void()> _rise;
+    Callback<void()> _fall;
+};
+
+class AnalogIn {
+public:
+    AnalogIn(PinName pin) : _pin(pin) {
+    }
+    unsigned short read_u16();
+    float read() {
+        return read_u16() * (1.0f / 65535.0f);
+    }
+    operator float() {
+        return read();
+    }
+private:
+    PinName _pin;
+};
+
+class SerialBase {
+public:
+    enum Parity {
+        None = 0,
+        Odd,
+        Even,
+        Forced1,
+        Forced0
+    };
+    enum IrqType {
+        RxIrq = 0,
+        TxIrq,
+        IrqCnt
+    };
+};
+
+/// A UART, the board connects it to host file descriptors.
+/// Sending takes the character time at the set baud rate, received bytes
+/// arrive one character time apart and raise RxIrq; the RX pin shows the
+/// start bits, for an InterruptIn on it.
+class Serial : public SerialBase, private SimEvent {
+public:
+    Serial(PinName tx, PinName rx, const char *name = NULL, int baud = 9600);
+    Serial(PinName tx, PinName rx, int baud);
+    virtual ~Serial();
+    void baud(int baudrate);
+    void format(int bits = 8, Parity parity = SerialBase::None, int stop_bits = 1);
+    int readable();
+    int writeable() {
+        return 1;
+    }
+    int getc();
+    int putc(int c);
+    int puts(const char *str);
+    int printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    void attach(Callback<void()> func, IrqType type = RxIrq);
+    template<typename T>
+    void attach(T *obj, void (T::*method)(), IrqType type = RxIrq) {
+        attach(callback(obj, method), type);
+    }
+
+    /// Host side: connect to file descriptors, -1 for none
+    void connect(int in, int out);
+
+    /// @returns the serial port on a TX pin, NULL if there is none
+    static Serial *find(PinName tx);
+
+private:
+    virtual void fire();
+    static void input(void *arg);
+    void pull();
+    void send(const char *s, int n);
+    void init(PinName tx, PinName rx, int baud);
+
+    PinName  _tx, _rx;
+    uint64_t _char_ns;                  // one character at the baud rate
+    uint64_t _txfree;                   // when the transmitter takes the next character
+    int      _in, _out;
+    bool     _eof;
+    bool     _full;                     // the receive register holds a character
+    bool     _polled;                   // read without RxIrq, the line delivers anyway
+    uint8_t  _rdr;
+    uint8_t  _queue[4096];              // received on the host side, not yet on the line
+    int      _qhead, _qlen;
+    Callback<void()> _irq[IrqCnt];
+    Serial  *_next;
+};
+
+typedef Serial RawSerial;
+
+class SPI {
+public:
+    SPI(PinName mosi, PinName miso, PinName sclk, PinName ssel = NC);
+    void format(int bits, int mode = 0);
+    void frequency(int hz = 1000000);
+    int write(int value);
+private:
+    PinName  _sclk;
+    int      _bits;
+    uint64_t _bit_ns;
+};
+
+class Timer {
+public:
+    Timer();
+    void start();
+    void stop();
+    void reset();
+    float read();
+    int read_ms();
+    int read_us();
+    uint64_t read_high_resolution_us();
+    operator float() {
+        return read();
+    }
+private:
+    bool     _running;
+    uint64_t _start;
+    uint64_t _time;
+};
+
+/// A periodic interrupt
+class Ticker : private SimEvent {
+public:
+    Ticker() : _period(0) {
+    }
+    void attach(Callback<void()> func, float t) {
+        attach_us(func, (timestamp_t)(t * 1000000.0f));
+    }
+    template<typename T>
+    void attach(T *obj, void (T::*method)(), float t) {
+        attach(callback(obj, method), t);
+    }
+    void attach_us(Callback<void()> func, timestamp_t t);
+    template<typename T>
+    void attach_us(T *obj, void (T::*method)(), timestamp_t t) {
+        attach_us(callback(obj, method), t);
+    }
+    void detach();
+protected:
+    virtual void fire();
+    Callback<void()> _function;
+    uint64_t _period;                   // ns, 0 for a Timeout
+    uint64_t _due;
+};
+
+/// A one shot interrupt
+class Timeout : public Ticker {
+protected:
+    virtual void fire();
+};
+
+/// @returns the us_ticker spin guarded: code that takes no time must
+/// still see a clock that moves when it polls it
+uint64_t sim_clock_us();
+
+} // namespace mbed
+
+using namespace mbed;
+using namespace std;
+
+#endif
@@ -0,0 +1,8 @@
+/// @file syslimits.h newlib's limits header, for the mbed file system headers
+///
+#ifndef SYS_SYSLIMITS_H
+#define SYS_SYSLIMITS_H
+
+#include <limits.h>
+
+#endif
@@ -2,42 +2,111 @@
 //                   console application.
 //
 
-#define MAX_PROBES      2
-#define W1_PIN      PB_9
+#define W1_PINS     { PB_9 }        // one entry per bit-banged 1-Wire bus
+//#define W1_UART_PIN PA_9            // USART1 TX, 1-Wire bus with hardware timed slots
+#define PWR_SENSOR_PIN  NC          // sensor supply switch, NC if always powered
+#define PWR_SD_PIN      NC          // SD card supply switch, NC if always powered
+#define PWR_BATCH       16          // low power mode: csv samples per SD card write
+#define PWR_SETTLE_MS   10          // sensor supply settling time
+#define PWR_CONV_MS     750         // DS18B20 12 bit conversion time
+#define PWR_CONSOLE_MS  30000       // no Stop mode for this long after serial input
+#define CLI_SLICE_MS    50          // a busy console command runs this long, then the other tasks get their turn
+#define LOG_MIN_MS      200         // logging mode: shortest period, below it logging starves the other tasks
+#define LOG_MAX_MS      (SAMPLECLOCK_MAX_US / 1000)
+#define LOG_QUEUE       8           // logging mode: samples the logger may fall behind by
+#define PWR_MIN_S       5           // low power mode: shortest period, longer than a whole wake cycle
+#define PWR_MAX_S       86400
 
 #include "mbed.h"
 #include "DS1820.h"
+#include "ProbeManager.h"
+#include "OneWireUart.h"
+#include "RomCache.h"
+#include "PowerManager.h"
+#include "PressureADC.h"
+#include "Profiler.h"
+#include "SampleClock.h"
+#include "Scheduler.h"
+#include "Supervisor.h"
+#include "Trace.h"
 #include "SDFileSystem.h"
 #include "millis.h"
 #include "Watchdog.h"
-#include <string>
-#include <vector>
+#include "LogCodec.h"
+#include "FixedPoint.h"
+#include "Benchmark.h"
+#include "SectorPool.h"
+#include "MemStats.h"
+#include "Metrics.h"
+#include "FATFileHandle.h"
+#include "Console.h"
 
 extern "C" {
 #include "CommandProcessor.h"
 }
 
 Watchdog wdt;
+Supervisor sup(wdt);            // feeds wdt only while every task heartbeat is on time
 
-Serial btserial(PB_10, PB_11); // serial communication (HC-05 in this case)
+Serial btport(PB_10, PB_11);   // serial communication (HC-05 in this case)
+Console btserial(GetCommandProcessor()->Write);    // what the commands and the log show, framed in machine mode
+InterruptIn rxwake(PB_11);      // the same RX pin as EXTI line, the UART cannot end Stop mode
 
 SDFileSystem sd(PA_7, PA_6, PA_5, PA_4, "sd");  //mosi, miso, sck, cs
 
-AnalogIn   pressin(PA_1);       // pressure transducer adc pin
+PressureADC pressin(PA_1);      // pressure transducer adc pin, oversampled by DMA
 DigitalOut ledout(PC_13);       // builtin led
-DS1820* probe[MAX_PROBES];      // software onewire bus
+ProbeManager chain;             // DS18B20 probes on all onewire buses
+#ifdef W1_UART_PIN
+OneWireUart w1uart(W1_UART_PIN);
+#endif
 
-Ticker measureTick;             // measurement ticker
+SampleClock measureTick;        // measurement trigger, hardware timed and stamped
+Scheduler sched;                // everything outside interrupt handlers runs as a task
+PowerManager pm(PWR_SENSOR_PIN, PWR_SD_PIN);    // Stop mode and supply switches, low power mode
+static CMDP_T *cp;              // the command line, run by the cli task
+CircularBuffer<char, 64> rxbuf; // serial input, filled by the receive interrupt
 
-vector<string> filenames; //filenames are stored in a vector string
 bool dsstarted = false;
-float   temp = 0;
+int     temp16 = 0;               // latest completed temperature of probe 0, 1/16 degree C
+bool    tempvalid = false;        // temp16 holds a real reading
+LINCAL_T prescal = LINCAL_DEFAULT;  // pressure calibration
 uint8_t dserror = 0;
-uint8_t mode = 0;
+uint8_t mode = 0;               // 0 - idle, 1 - logging, 2 - low power logging
+uint8_t logformat = 0;          // 0 - csv text, 1 - compressed blocks (LogCodec)
+bool    logstatus = false;      // csv: append the SAMPLE_ deadline flags as last column
+int     logsync = 1;            // logging mode: log writes per file close (Sync)
+FILE   *logfp = NULL;           // the log file, open between syncs
+int     logwrites = 0;          // writes since the last sync
+LogEncoder logblock;            // block being filled in compressed mode, in blockbuf
+char   *blockbuf = NULL;        // its sector while logging compressed, from the SectorPool
+char   *logiob = NULL;          // stdio buffer of the csv log file while it is open
 char filename[32];
 char longfilename[48];
 char buffer [128];
 
+// task ids, in order of priority
+int tSampler, tProbe, tWake, tMeasure, tLogger, tCli, tWatchdog;
+volatile uint64_t trigStamp;    // time of the latest sample trigger, us
+volatile uint32_t lastRx;       // millis() of the latest serial input
+int hbBoot, hbSched, hbSampler, hbMeasure;  // supervisor heartbeat ids
+
+// low power mode: one wake cycle per sample, csv lines collected for one card write
+bool     cycling = false;       // sensors powered, a sample in progress
+uint8_t  phase;                 // step of the wake cycle
+uint32_t convStart;             // millis() the conversions were started
+#define  BATCH_SECTORS   2       // csv lines collected per card write, in sectors
+char    *batchbuf = NULL;       // from the SectorPool while in low power csv mode
+int      batchlen = 0;
+int      batched = 0;
+uint32_t statusms = 0;          // csv log: a status record of the metrics this often, 0 - none
+uint32_t laststatus;            // millis() of the latest status record
+int      sdusers = 0;           // the log and the console's transfers, while they have the card mounted
+uint32_t cliresume = 1;         // a busy console command's next slice, ms from now
+bool     clibusy = false;       // a console command runs in slices, its output has the console
+FILE    *sendfp = NULL;         // the file Get is sending, a slice at a time
+char    *sendiob = NULL;        // its stdio buffer, from the SectorPool
+
 
 void listdir(void) // FIX THIS
 {
@@ -57,32 +126,85 @@ void listdir(void) // FIX THIS
     closedir(d);
 }
 
-bool sendfile(char* fname, bool test)
+// the card is shared by the log and the console's file transfers: the first
+// user powers and mounts it, the last one unmounts it, and in low power mode
+// powers it off again
+static void sdUnmount(void)
 {
-    bool stat = false;
-    FILE *fp = fopen(fname, "r");
-    if(fp == NULL) {
-        btserial.printf("Could not open file for read\r\n");
-        stat = 1;
-    } else {
-        while(fgets (buffer, 32, fp) != NULL) {
-            btserial.printf("%s",buffer); // and show it in char format
-        }
-        if (test) {
-            fseek(fp, 0, SEEK_END); // seek to end of file
-            int size = ftell(fp);       // get current file pointer
-            fseek(fp, 0, SEEK_SET); // seek back to beginning of file
-            btserial.printf("File size: %i bytes\r\n",size);
+    if (sdusers > 0 && --sdusers > 0)
+        return;
+    sd.unmount();
+    if (mode == 2)
+        pm.sd(false);
+}
+
+static bool sdMount(void)
+{
+    if (sdusers == 0) {
+        pm.sd(true);
+        if (sd.disk_initialize()) { // not initialized, code 1
+            btserial.printf("Problem with SD card\r\n");
+            sdUnmount();
+            return false;
         }
-        stat = 0;
+        sd.mount();
     }
-    fclose(fp);
-    return stat;
+    sdusers++;
+    return true;
 }
 
-void sdtst(void)
+// every fopen sets a stdio buffer from the SectorPool, or none, so that
+// newlib takes none from the heap
+static bool sendOpen(const char *fname)
+{
+    sendfp = fopen(fname, "r");
+    if (sendfp == NULL) {
+        btserial.printf("Could not open file for read\r\n");
+        return false;
+    }
+    sendiob = SectorPool_Get(1);
+    setvbuf(sendfp, sendiob, sendiob ? _IOFBF : _IONBF, SECTORPOOL_SECTOR);
+    return true;
+}
+
+// send the open file on for about ms, returns true at its end
+static bool sendSlice(uint32_t ms)
+{
+    uint32_t start = millis();
+    do {
+        if (fgets(buffer, 32, sendfp) == NULL)
+            return true;
+        btserial.printf("%s", buffer); // and show it in char format
+    } while (millis() - start < ms);
+    return false;
+}
+
+static void sendClose(void)
+{
+    fclose(sendfp);
+    SectorPool_Release(sendiob);
+    sendfp = NULL;
+    sendiob = NULL;
+}
+
+// the whole file in one go, for short ones
+bool sendfile(char* fname, bool test)
+{
+    if (!sendOpen(fname))
+        return 1;
+    while (!sendSlice(CLI_SLICE_MS))
+        ;
+    if (test) {
+        fseek(sendfp, 0, SEEK_END); // seek to end of file
+        int size = ftell(sendfp);       // get current file pointer
+        btserial.printf("File size: %i bytes\r\n",size);
+    }
+    sendClose();
+    return 0;
+}
+
+bool sdtst(void)
 {
-    startMillis();
     btserial.printf("Trying to test writing...\r\n");
     bool writetest = 1;
     bool readtest = 1;
@@ -92,11 +214,14 @@ void sdtst(void)
         writetest = 1;
         fclose(fp);
     } else {
+        char *iob = SectorPool_Get(1);
+        setvbuf(fp, iob, iob ? _IOFBF : _IONBF, SECTORPOOL_SECTOR);
         for (int i = 0; i < 5; i++) {
             fprintf(fp, "%i:%d\r\n", i, millis());
         }
         writetest = 0;
         fclose(fp);
+        SectorPool_Release(iob);
         btserial.printf("Trying to self-test reading...\r\n");
         readtest = sendfile("/sd/sdcheck.txt", 1);
     }
@@ -104,43 +229,471 @@ void sdtst(void)
         btserial.printf("\r\nSD check OK\r\n");
     else
         btserial.printf("\r\nSD check FAILED!\r\n");
-    stopMillis();
+    return !(writetest || readtest);
 }
 
-void onMeasureTick(void)       // function to call every tick
+// Sample in raw units, converted to milli-units and text only at output time
+typedef struct {
+    uint32_t ms;
+    int      t16;           // temperature, 1/16 degree C
+    uint16_t praw;          // pressure, raw 16 bit ADC reading
+    SAMPLETIME_T time;      // trigger time and SAMPLE_ deadline flags
+} SAMPLE_T;
+
+CircularBuffer<SAMPLE_T, LOG_QUEUE> logqueue;  // handed from the sampler task to the logger task
+SAMPLE_T logsample;         // the sample of a low power cycle
+int mReadable();
+
+// Run the DS18B20 conversions without waiting for them: the chain manager
+// picks up finished readings and starts the next conversion. A 12 bit
+// conversion (750 ms) spans several polls, the samples in between carry
+// the latest completed values. Returns true once a temperature is known.
+static bool updateTemperature(void)
+{
+    if (chain.poll() == ProbeManager::updated) {
+        int t = chain.temperature(0);
+        if (t != DS1820::invalid_conversion) {
+            temp16 = t;
+            tempvalid = true;
+        }
+    }
+    return tempvalid;
+}
+
+// take one sample, returns false if it fails the sanity check
+static bool takeSample(SAMPLE_T *s)
+{
+    if (!tempvalid)
+        return false;
+    s->praw = pressin.read_u16();
+    s->t16 = temp16;
+    s->ms = (uint32_t)(s->time.stamp / 1000);   // trigger time, not the time we got here
+    int32_t p = fx_calibrate(&prescal, s->praw);
+    return (s->t16 != 0) && (p > 1) && (p < 100000);
+}
+
+#define SAMPLE_FMT_LOG     "%lu;%s;%s"                    // text log line
+#define SAMPLE_FMT_CONSOLE "Millis:%lu | T:%s | P:%s"     // serial console
+
+// format a sample in engineering units, without the line end
+static char *formatSample(char *buf, const SAMPLE_T *s, const char *fmt)
+{
+    PROF_ZONE(format);
+    char t[13], p[13];
+    sprintf(buf, fmt, (unsigned long)s->ms,
+            fx_format_milli(t, fx_t16_to_milli(s->t16)),
+            fx_format_milli(p, fx_calibrate(&prescal, s->praw)));
+    return buf;
+}
+
+// format the latest reading of a chain probe, empty if it has none: a
+// missing probe or a failed CRC must not look like a temperature
+static const char *formatProbe(char *buf, int i)
+{
+    int t16 = chain.temperature(i);
+    if (t16 == DS1820::invalid_conversion) {
+        buf[0] = '\0';
+        return buf;
+    }
+    return fx_format_milli(buf, fx_t16_to_milli(t16));
+}
+
+// show a sample on the console, traced until the line is handed to the UART;
+// none while a command's output, a file download, has the console
+static void consoleSample(const SAMPLE_T *s)
+{
+    if (clibusy)
+        return;
+    TRACE(console, 0);
+    int n = btserial.printf("%s\r\n", formatSample(buffer, s, SAMPLE_FMT_CONSOLE));
+    TRACE_END(console, n);
+}
+
+// a log write failed
+static void runError(void)
+{
+    METRIC_INC(log_errors);
+    btserial.printf("Measuring mode run error\r\n");
+}
+
+#define STATUS_FMT_HEAD    "#%lu"           // status record: millis, then the metrics
+#define STATUS_FMT_ITEM    " %s=%lu"
+
+// is a status record due in the csv log, takes its time if so
+static bool statusDue(void)
+{
+    if (statusms == 0 || millis() - laststatus < statusms)
+        return false;
+    laststatus = millis();
+    METRIC_SET(uptime_s, laststatus / 1000);
+    return true;
+}
+
+// write the status record to the log file, returns its length
+static int logStatus(FILE *fp)
+{
+    int n = fprintf(fp, STATUS_FMT_HEAD, (unsigned long)laststatus);
+    for (int i = 0; i < METRIC_COUNT; i++)
+        n += fprintf(fp, STATUS_FMT_ITEM, Metric_Name(i), (unsigned long)Metric_Read(i));
+    return n + fprintf(fp, "\r\n");
+}
+
+// the log file, the card is mounted and the file opened by the first write after a sync;
+// csv lines collect in a stdio buffer, compressed blocks are whole sectors and go
+// straight through
+static FILE *logOpen(void)
+{
+    if (logfp != NULL || !sdMount())
+        return logfp;
+    logfp = fopen(longfilename, "a");
+    if (logfp == NULL) {
+        btserial.printf("Could not open file '%s' for write\r\n", filename);
+        sdUnmount();
+    } else if (logformat == 1 && (fseek(logfp, 0, SEEK_END) || ftell(logfp) % LOGCODEC_BLOCK_SIZE)) {
+        // blocks behind anything but whole blocks would not sit on sectors
+        btserial.printf("File '%s' is not a block log\r\n", filename);
+        fclose(logfp);
+        logfp = NULL;
+        sdUnmount();
+    } else {
+        logiob = logformat == 1 ? NULL : SectorPool_Get(1);
+        setvbuf(logfp, logiob, logiob ? _IOFBF : _IONBF, SECTORPOOL_SECTOR);
+    }
+    return logfp;
+}
+
+// count a log write, every logsync writes (or now, if forced) close the
+// file so its data and directory entry are on the card
+static bool logSync(bool force)
 {
     bool err = 0;
+    if (logfp == NULL || (!force && ++logwrites < logsync))
+        return err;
+    if (fclose(logfp))
+        err = 1;
+    METRIC_INC(syncs);
+    SectorPool_Release(logiob);
+    logiob = NULL;
+    logfp = NULL;
+    logwrites = 0;
+    sdUnmount();
+    return err;
+}
+
+// write the pending compressed block as one whole sector of the log file
+static bool flushLogBlock(void)
+{
+    bool err = 0;
+    if (logblock.empty())
+        return err;
+    FILE *fp = logOpen();
+    if (fp == NULL || fwrite(logblock.data(), 1, LOGCODEC_BLOCK_SIZE, fp) != LOGCODEC_BLOCK_SIZE)
+        err = 1;
+    else
+        METRIC_ADD(log_bytes, LOGCODEC_BLOCK_SIZE);
+    if (logSync(mode != 1))             // low power mode powers the card off after each write
+        err = 1;
+    logblock.reset();
+    return err;
+}
+
+// Sample clock interrupt: only note the trigger, the work runs as tasks
+void onMeasureTick(void)
+{
+    trigStamp = measureTick.stamp();
+    MemStats_IsrMark();
     ledout = !ledout;                 //  toggle the LED
-    if (!sd.disk_initialize()) { // disk initialized with code 0
-        sd.mount();
+    sched.post(tSampler);
+}
+
+// Sampler task: read the sensors for the latest trigger, hand the sample to the logger;
+// the deadline of a sample runs from here until the logger has written it
+static void samplerTask(void)
+{
+    sup.beat(hbSampler);
+    if (!dsstarted) {
+        btserial.printf("Problem with DS18B20 init\r\n");
+        btserial.printf("Measuring mode run error\r\n");
+        return;
+    }
+    SAMPLE_T s;
+    measureTick.start(&s.time, trigStamp);
+    TRACE(tick, s.time.status);
+    if (!takeSample(&s)) {
+        METRIC_INC(samples_bad);
+        measureTick.done(&s.time);
+        return;
+    }
+    METRIC_INC(samples);
+    consoleSample(&s);
+    if (logqueue.full())
+        METRIC_INC(samples_dropped);
+    logqueue.push(s);           // a full queue loses its oldest sample
+    sched.post(tLogger);
+}
+
+// write one sample to the card
+static void logSample(const SAMPLE_T *smp)
+{
+    bool err = 0;
+    TRACE_SCOPE(log, logformat);
+    if (logformat == 1) {
+        LogSample s = { smp->ms, fx_t16_to_milli(smp->t16), fx_calibrate(&prescal, smp->praw) };
+        METRIC_INC(records);
+        if (logblock.add(s))
+            err = flushLogBlock();
+        if (err) runError();
+        return;
+    }
+    FILE *fp = logOpen();
+    if (fp == NULL)
+        err = 1;
+    else {
+        const char *line = formatSample(buffer, smp, SAMPLE_FMT_LOG);
+        int n = strlen(line);
+        fputs(line, fp);
+        for (int i = 1; i < chain.count(); i++) {   // rest of the chain as extra columns
+            char t[13];
+            n += fprintf(fp, ";%s", formatProbe(t, i));
+        }
+        if (logstatus)
+            n += fprintf(fp, ";%u", smp->time.status);
+        fputs("\r\n", fp);
+        n += 2;
+        METRIC_INC(records);
+        if (statusDue())
+            n += logStatus(fp);
+        METRIC_ADD(log_bytes, n);
+        if (logSync(false))
+            err = 1;
+    }
+    if (err) runError();
+}
+
+// Logger task: write the samples the sampler queued, one post may stand for several
+static void loggerTask(void)
+{
+    SAMPLE_T s;
+    while (logqueue.pop(s)) {
+        logSample(&s);
+        measureTick.done(&s.time);
+    }
+}
+
+// Probe task: advance the chain conversions, only scheduled while measuring
+static void probeTask(void)
+{
+    updateTemperature();
+}
+
+// append one csv line to the batch, false if it does not fit
+static bool batchLine(const SAMPLE_T *s)
+{
+    char *p = batchbuf + batchlen;
+    int room = BATCH_SECTORS * SECTORPOOL_SECTOR - batchlen;
+    int n = snprintf(p, room, "%s", formatSample(buffer, s, SAMPLE_FMT_LOG));
+    for (int i = 1; i < chain.count() && n < room; i++) {
+        char t[13];
+        n += snprintf(p + n, room - n, ";%s", formatProbe(t, i));
+    }
+    if (logstatus && n < room)
+        n += snprintf(p + n, room - n, ";%u", s->time.status);
+    if (n < room)
+        n += snprintf(p + n, room - n, "\r\n");
+    if (n >= room)
+        return false;
+    batchlen += n;
+    batched++;
+    METRIC_INC(records);
+    return true;
+}
+
+// append the status record to the batch, false if it does not fit
+static bool batchStatus(void)
+{
+    char *p = batchbuf + batchlen;
+    int room = BATCH_SECTORS * SECTORPOOL_SECTOR - batchlen;
+    int n = snprintf(p, room, STATUS_FMT_HEAD, (unsigned long)laststatus);
+    for (int i = 0; i < METRIC_COUNT && n < room; i++)
+        n += snprintf(p + n, room - n, STATUS_FMT_ITEM, Metric_Name(i), (unsigned long)Metric_Read(i));
+    if (n < room)
+        n += snprintf(p + n, room - n, "\r\n");
+    if (n >= room)
+        return false;
+    batchlen += n;
+    return true;
+}
+
+// write the collected csv lines with the card powered just for this, in one call
+static bool writeBatch(void)
+{
+    bool err = 0;
+    if (!batchlen)
+        return err;
+    if (sdMount()) {
         FILE *fp = fopen(longfilename, "a");
-        if(fp == NULL) {
+        if (fp == NULL) {
             btserial.printf("Could not open file '%s' for write\r\n", filename);
             err = 1;
         } else {
-            if (dsstarted) {
-                probe[0]->convertTemperature(true, DS1820::all_devices);         //Start temperature conversion, wait until ready
-                //wait(.1);
-                float pressure = pressin.read();
-                //wait(.1);
-                temp = probe[0]->temperature();
-                if ((abs(temp) > 0.001) && (abs(pressure > 0.001)) && (abs(pressure < 100))) {
-                    btserial.printf("Millis:%d | T:%.3f | P:%.3f\r\n",millis(), temp, pressure);
-                    fprintf(fp, "%d;%.3f;%.3f\r\n",millis(),temp,pressure);
-                }
-                err = 0;
-            } else {
-                btserial.printf("Problem with DS18B20 init\r\n", filename);
+            setvbuf(fp, NULL, _IONBF, 0);
+            if (fwrite(batchbuf, 1, batchlen, fp) != (size_t)batchlen)
                 err = 1;
-            }
+            else
+                METRIC_ADD(log_bytes, batchlen);
+            fclose(fp);
+            METRIC_INC(syncs);
         }
-        fclose(fp);
+        sdUnmount();
     } else
-        btserial.printf("Problem with SD card\r\n"); // ooops, not initialized, code 1
-    sd.unmount();
-    if (err) btserial.printf("Measuring mode run error\r\n");
+        err = 1;
+    batchlen = 0;
+    batched = 0;
+    return err;
+}
+
+// keep a low power sample, the card only wakes for a full batch or block
+static void batchSample(const SAMPLE_T *s)
+{
+    bool err = 0;
+    if (logformat == 1) {
+        LogSample ls = { s->ms, fx_t16_to_milli(s->t16), fx_calibrate(&prescal, s->praw) };
+        METRIC_INC(records);
+        if (logblock.add(ls)) {
+            err = flushLogBlock();
+            pm.mark(pwr_write);
+        }
+    } else {
+        if (!batchLine(s)) {
+            err = writeBatch();
+            batchLine(s);
+        }
+        if (statusDue() && !batchStatus()) {
+            err |= writeBatch();
+            batchStatus();
+        }
+        if (batched >= PWR_BATCH) {
+            err |= writeBatch();
+            pm.mark(pwr_write);
+        }
+    }
+    if (err) runError();
+}
+
+// Wake task: start of a low power cycle, posted by its timer after the RTC wakeup
+static void wakeTask(void)
+{
+    if (cycling)
+        return;                         // the previous sample is still running
+    pm.beginCycle();
+    pm.sensors(true);
+    cycling = true;
+    phase = 0;
+    sched.after(tMeasure, PWR_SETTLE_MS);
+}
+
+// Measure task: the steps of a low power cycle, rescheduled while waiting on the sensors
+static void measureTask(void)
+{
+    uint16_t v;
+    bool pressvalid = true;
+    switch (phase) {
+    case 0:                             // supply settled
+        pm.mark(pwr_sensors);
+        logsample.ms = millis();
+        logsample.time.status = 0;
+        chain.startConversions();
+        pressin.start();
+        convStart = millis();
+        phase = 1;
+        sched.after(tMeasure, PWR_CONV_MS);
+        return;
+    case 1:                             // temperature
+        if (chain.collect() == ProbeManager::converting) {
+            if (millis() - convStart < 2 * PWR_CONV_MS) {
+                sched.after(tMeasure, 20);
+                return;
+            }
+            tempvalid = false;          // timed out, the reading there is the previous cycle's
+        } else {
+            tempvalid = chain.temperature(0) != DS1820::invalid_conversion;
+            if (tempvalid)
+                temp16 = chain.temperature(0);
+        }
+        pm.mark(pwr_temp);
+        phase = 2;
+        // fall through
+    case 2:                             // pressure, at least one decimated reading
+        if (!pressin.get(&v)) {
+            if (millis() - convStart < 4 * PWR_CONV_MS) {
+                sched.after(tMeasure, 20);
+                return;
+            }
+            pressvalid = false;         // timed out, read_u16() still holds the previous cycle's
+        }
+        logsample.praw = pressin.read_u16();
+        sup.beat(hbMeasure);
+        pm.mark(pwr_pressure);
+        pressin.stop();
+        pm.sensors(false);
+        cycling = false;
+        break;
+    }
+    logsample.t16 = temp16;
+    int32_t p = fx_calibrate(&prescal, logsample.praw);
+    if (!tempvalid || !pressvalid || logsample.t16 == 0 || p <= 1 || p >= 100000) {
+        METRIC_INC(samples_bad);
+        return;
+    }
+    METRIC_INC(samples);
+    pm.mark(pwr_sample);
+    if (millis() - lastRx < PWR_CONSOLE_MS)
+        consoleSample(&logsample);
+    batchSample(&logsample);
+}
+
+// Serial RX edge while in Stop mode: waking up is all it has to do
+static void onRxWake(void)
+{
+    lastRx = millis();
+}
+
+// Scheduler idle hook: Stop mode between low power samples, unless a
+// sample is in progress (the ADC needs its clock) or the console is in use
+static bool onIdle(uint64_t us)
+{
+    if (mode != 2 || cycling || millis() - lastRx < PWR_CONSOLE_MS)
+        return false;
+    rxwake.fall(&onRxWake);             // serial input ends Stop mode, that first character is lost
+    bool stopped = pm.stop(us);
+    rxwake.fall(Callback<void()>());
+    return stopped;
+}
+
+// Watchdog task: lowest priority, so its heartbeat only comes while every task gets its turn
+static void watchdogTask(void)
+{
+    sup.beat(hbSched);
 }
 
+// Command line task: posted by the serial receive interrupt, and by its own
+// timer while a command runs in slices
+static void cliTask(void)
+{
+    RUNRESULT_T r;
+    do {
+        r = cp->Run();
+    } while (r == runok && mReadable());
+    if (r == runok)
+        r = cp->Run();   // shows the prompt after a command
+    clibusy = r == runbusy;
+    if (clibusy) {
+        sched.after(tCli, cliresume);   // never at once, the watchdog task must get its turn
+        cliresume = 1;
+    } else if (r != runok)
+        sched.stop();
+    ledout = 1;
+}
 
 RUNRESULT_T Check(char *p);
 const CMD_T CheckCmd = {
@@ -150,14 +703,126 @@ const CMD_T CheckCmd = {
     visible
 };
 
+RUNRESULT_T Bench(char *p);
+const CMD_T BenchCmd = {
+    "Bench",
+    "Performance profile: SD sequential and random writes, 1-Wire, ADC and serial throughput",
+    Bench,
+    visible
+};
+
 RUNRESULT_T Mode(char *p);
 const CMD_T ModeCmd = {
     "Mode",
-    "Select run mode (0 - do nothing; 1 - logging mode)",
+    "Run mode (0 - idle; 1 [ms] - logging, default 330; 2 [s] - low power, default 60)",
     Mode,
     visible
 };
 
+RUNRESULT_T Health(char *p);
+const CMD_T HealthCmd = {
+    "Health",
+    "Task heartbeats of the watchdog supervisor and the breadcrumb of the last watchdog reset",
+    Health,
+    visible
+};
+
+RUNRESULT_T Prof(char *p);
+const CMD_T ProfCmd = {
+    "Prof",
+    "Profiling zones: runs, average, min, max and total time (reset - clear the table)",
+    Prof,
+    visible
+};
+
+RUNRESULT_T Mem(char *p);
+const CMD_T MemCmd = {
+    "Mem",
+    "RAM: heap in use and peak, stack high-water marks, sector pool and major static buffers",
+    Mem,
+    visible
+};
+
+RUNRESULT_T Trace(char *p);
+const CMD_T TraceCmd = {
+    "Trace",
+    "Event trace ring (dump - binary for trace2json; clear; on|off [event ...], none - all)",
+    Trace,
+    visible
+};
+
+RUNRESULT_T Stats(char *p);
+const CMD_T StatsCmd = {
+    "Stats",
+    "Counters, gauges (reset - clear counters; log s - csv status record every s sec, 0 off)",
+    Stats,
+    visible
+};
+
+RUNRESULT_T Power(char *p);
+const CMD_T PowerCmd = {
+    "Power",
+    "Low power mode: Stop time and wake-to-sample latency budget (reset - restart statistics)",
+    Power,
+    visible
+};
+
+RUNRESULT_T Probes(char *p);
+const CMD_T ProbesCmd = {
+    "Probes",
+    "List probes: index, bus, ROM id, latest reading (scan - search the buses again)",
+    Probes,
+    visible
+};
+
+RUNRESULT_T Adc(char *p);
+const CMD_T AdcCmd = {
+    "Adc",
+    "Pressure filter: Adc [order log2ratio], CIC order 1 (boxcar)..3, decimation 2^log2ratio",
+    Adc,
+    visible
+};
+
+RUNRESULT_T Jitter(char *p);
+const CMD_T JitterCmd = {
+    "Jitter",
+    "Sample timing: interval deviation and trigger latency (reset - restart the statistics)",
+    Jitter,
+    visible
+};
+
+RUNRESULT_T Deadline(char *p);
+const CMD_T DeadlineCmd = {
+    "Deadline",
+    "Sample deadlines: late, skipped, overrun ticks (reset; flags on|off - csv status column)",
+    Deadline,
+    visible
+};
+
+RUNRESULT_T Cal(char *p);
+const CMD_T CalCmd = {
+    "Cal",
+    "Pressure calibration: Cal [offset gain], milli-units at 0 and per full scale",
+    Cal,
+    visible
+};
+
+RUNRESULT_T Format(char *p);
+const CMD_T FormatCmd = {
+    "Format",
+    "Log format (csv - text; bin - compressed blocks, always a .bin file)",
+    Format,
+    visible
+};
+
+RUNRESULT_T Sync(char *p);
+const CMD_T SyncCmd = {
+    "Sync",
+    "Log sync: close the log file every n writes (1 - after each record or block, default)",
+    Sync,
+    visible
+};
+
 RUNRESULT_T Ls(char *p);
 const CMD_T LsCmd = {
     "Ls",
@@ -201,118 +866,770 @@ RUNRESULT_T Ls(char *p)
 {
     ledout = 0;
     listdir();
-    for(vector<string>::iterator it=filenames.begin(); it < filenames.end(); it++) {
-        printf("%s\n\r",(*it).c_str());
-    }
     return runok;
 }
 
+// the log file name takes the extension of the log format, so that
+// compressed blocks never go into a file that holds csv text
+static bool logFilename(const char *name)
+{
+    const char *dot = strrchr(name, '.');
+    int len = dot ? dot - name : strlen(name);
+    if (len == 0 || len + 4 >= (int)sizeof(filename))
+        return false;
+    memmove(filename, name, len);
+    strcpy(filename + len, logformat == 1 ? ".bin" : ".csv");
+    sprintf(longfilename, "/sd/%s", filename);
+    return true;
+}
+
 RUNRESULT_T Filename(char *p)
 {
     ledout = 0;
     if (*p) {
-        strcpy (filename, p);
-        sprintf(longfilename, "/sd/%s", filename);
+        if (!logFilename(p)) {
+            btserial.printf("\r\nbad filename\r\n");
+            return runfailed;
+        }
     } else
         btserial.printf("\r%s\r\n", filename);
     btserial.puts("\r\nsuccess\r\n");
     return runok;
 }
 
+// sends a slice per call, the log goes on in between
 RUNRESULT_T FileGet(char *p)
 {
-    if (!(*p))
-        p = filename;
     ledout = 0;
-    if (!sd.disk_initialize()) { // disk initialized with code 0
-        sd.mount();
+    if (sendfp == NULL) {               // the first call
+        if (!(*p))
+            p = filename;
+        if (!sdMount())
+            return runfailed;
         btserial.puts("\r\n_start_file\r\n");
         char fname[48];
         sprintf(fname, "/sd/%s", p);
-        sendfile(fname, 0);
-        btserial.puts("\r\n_end_file\r\n");
-    } else
-        btserial.printf("Problem with SD card\r\n"); // ooops, not initialized, code 1
-    sd.unmount();
+        if (!sendOpen(fname)) {
+            btserial.puts("\r\n_end_file\r\n");
+            sdUnmount();
+            return runfailed;
+        }
+    }
+    if (p != NULL && !sendSlice(CLI_SLICE_MS))
+        return runbusy;
+    sendClose();
+    btserial.puts(p ? "\r\n_end_file\r\n" : "\r\n_cancel_file\r\n");
+    sdUnmount();
     return runok;
 }
 
 
+// leave the current run mode, everything powered and idle afterwards
+static void stopLogging(void)
+{
+    bool err = 0;
+    measureTick.detach();
+    sched.every(tProbe, 0);
+    sup.pause(hbSampler);
+    sup.pause(hbMeasure);
+    if (mode == 2) {
+        sched.every(tWake, 0);
+        sched.every(tMeasure, 0);
+        sched.every(tWatchdog, 1000);
+        cycling = false;
+        err = writeBatch();
+        pm.sensors(true);
+        pm.sd(true);
+        pressin.start();
+    }
+    if (logformat == 1 && flushLogBlock())   // keep the partial block
+        err = 1;
+    if (logSync(true))
+        err = 1;
+    if (err) runError();
+    logblock.attach(NULL);
+    SectorPool_Release(blockbuf);
+    SectorPool_Release(batchbuf);
+    blockbuf = NULL;
+    batchbuf = NULL;
+    mode = 0;
+    METRIC_SET(mode, 0);
+    METRIC_SET(interval_ms, 0);
+}
+
+// take the buffers of a run in mode m from the SectorPool
+static bool logBuffers(int m)
+{
+    if (logformat == 1) {
+        blockbuf = SectorPool_Get(1);
+        logblock.attach((uint8_t *)blockbuf);
+        return blockbuf != NULL;
+    }
+    if (m == 2) {
+        batchbuf = SectorPool_Get(BATCH_SECTORS);
+        return batchbuf != NULL;
+    }
+    return true;
+}
+
 RUNRESULT_T Mode(char *p)
 {
+    int m;
+    unsigned long every = 0;            // mode 1: ms, mode 2: seconds
     ledout = 0;
-    if (strrchr(p, '0')) { //stop mode activated
+    if (sscanf(p, "%d %lu", &m, &every) < 1 || m < 0 || m > 2
+            || (m == 1 && every && (every < LOG_MIN_MS || every > LOG_MAX_MS))
+            || (m == 2 && every && (every < PWR_MIN_S || every > PWR_MAX_S))) {
+        btserial.printf("\r\nbad mode\r\n");
+        return runfailed;
+    }
+    stopLogging();
+    if (m == 0) { //stop mode activated
         btserial.printf("\r\ndeactivated\r\n");
-        mode = 0;
-        measureTick.detach();
-        stopMillis();
-    } else if (strrchr(p, '1')) { //run mode activated
+    } else if (!logBuffers(m)) {
+        stopLogging();
+        btserial.printf("\r\nno free sector buffer\r\n");
+        return runfailed;
+    } else if (m == 1) { //run mode activated
+        unsigned long ms = every ? every : 330;
+        if (!measureTick.attach(&onMeasureTick, ms * 1000)) {  // attach the onTick function to the sample clock
+            stopLogging();
+            btserial.printf("\r\nbad mode\r\n");
+            return runfailed;
+        }
         btserial.printf("\r\nactivated\r\n");
         mode = 1;
-        startMillis();
-        measureTick.attach(&onMeasureTick,0.33);  // attach the onTick function to the ticker at a period of 0.33 seconds
+        METRIC_SET(mode, 1);
+        METRIC_SET(interval_ms, ms);
+        laststatus = millis();
+        sched.every(tProbe, 250);   // keep the chain converting
+        sup.resume(hbSampler, ms < 1000 ? 2000 : 2 * ms);
+    } else { // low power mode: sensors and card off, Stop mode between samples
+        unsigned long seconds = every ? every : 60;
+        btserial.printf("\r\nlow power, every %lu s\r\n", seconds);
+        mode = 2;
+        METRIC_SET(mode, 2);
+        METRIC_SET(interval_ms, seconds * 1000);
+        laststatus = millis();
+        pressin.stop();
+        pm.sensors(false);
+        pm.sd(false);
+        pm.resetStats();
+        sched.every(tWatchdog, PWR_MAX_STOP_MS / 2);   // the dog runs on in Stop mode
+        sched.every(tWake, seconds * 1000);
+        sched.post(tWake);          // first sample now
+        sup.resume(hbMeasure, seconds * 1000 + 4 * PWR_CONV_MS);
+    }
+    return runok;
+}
+
+// what the previous run left in the backup registers
+static void printCrash(const CRUMB_T *c)
+{
+    btserial.printf("last check at %lu s, task %s", (unsigned long)c->uptime,
+                    c->task < sched.count() ? sched.name(c->task) : "-");
+    btserial.printf(" after %s\r\n", c->prevtask < sched.count() ? sched.name(c->prevtask) : "-");
+    if (c->reason == CRUMB_STALL) {
+        btserial.printf("stalled:");
+        for (int i = 0; i < sup.count(); i++) {
+            if (c->late & (1 << i))
+                btserial.printf(" %s", sup.name(i));
+        }
+        btserial.printf(", pc %08lX in %s %u\r\n", (unsigned long)c->pc,
+                        c->exception ? "exception" : "thread", c->exception);
     } else
-        btserial.printf("\r\nbad mode\r\n");
+        btserial.printf("no stall recorded, interrupts were blocked or the stall was too short\r\n");
+}
+
+RUNRESULT_T Health(char *p)
+{
+    CRUMB_T c;
+    ledout = 0;
+    bool crashed = sup.lastCrash(&c);
+    btserial.printf("\r\n%u watchdog resets, %u stalls recovered (%lu this run)\r\n", c.resets,
+                    c.recovered, (unsigned long)sup.recovered());
+    btserial.printf("heartbeat  deadline      age    worst  misses (ms)\r\n");
+    for (int i = 0; i < sup.count(); i++) {
+        if (sup.active(i))
+            btserial.printf("%-10s %8lu %8lu %8lu %7lu\r\n", sup.name(i), (unsigned long)sup.deadline(i),
+                            (unsigned long)sup.age(i), (unsigned long)sup.worst(i), (unsigned long)sup.misses(i));
+        else
+            btserial.printf("%-10s    pause %17lu %7lu\r\n", sup.name(i), (unsigned long)sup.worst(i),
+                            (unsigned long)sup.misses(i));
+    }
+    if (crashed)
+        printCrash(&c);
+    return runok;
+}
+
+RUNRESULT_T Prof(char *p)
+{
+    PROF_T z;
+    uint32_t mhz = Prof_Hz() / 1000000;
+    ledout = 0;
+    btserial.printf("\r\nzone            runs      avg      min      max    total (cycles at %lu MHz)\r\n",
+                    (unsigned long)mhz);
+    for (int i = 0; i < PROF_COUNT; i++) {
+        Prof_Read(i, &z);
+        if (!z.count)
+            continue;
+        btserial.printf("%-12s %7lu %8lu %8lu %8lu %8lu ms\r\n", Prof_Name(i), (unsigned long)z.count,
+                        (unsigned long)(z.total / z.count), (unsigned long)z.min, (unsigned long)z.max,
+                        (unsigned long)(z.total / (mhz * 1000)));
+    }
+    if (strncmp(p, "reset", 5) == 0)
+        Prof_Reset();
     return runok;
 }
 
+RUNRESULT_T Mem(char *p)
+{
+    static const struct {
+        const char *name;
+        unsigned size;
+    } bufs[] = {
+        { "sector pool", SECTORPOOL_SECTORS * SECTORPOOL_SECTOR },
+        { "card volume", sizeof(sd) },
+        { "open files", FAT_MAX_OPEN_FILES * sizeof(FATFileHandle) },
+        { "trace ring", sizeof(trace_ring) },
+        { "command line", (CMDP_MAX_HISTORY + 2) * (CMDP_MAX_CMDLEN + 1) + CMDP_MAX_QUEUE + CMDP_MAX_PAYLOAD },
+        { "serial input", sizeof(rxbuf) },
+        { "log queue", sizeof(logqueue) },
+        { "log encoder", sizeof(logblock) },
+        { "line buffer", sizeof(buffer) },
+    };
+    mbed_stats_heap_t h;
+    MEMSTATS_STACK_T s;
+    ledout = 0;
+    mbed_stats_heap_get(&h);
+    MemStats_Stack(&s);
+    btserial.printf("\r\nheap    %lu now in %lu blocks, %lu peak, %lu allocated in all, %lu failed, %lu reserved\r\n",
+                    (unsigned long)h.current_size, (unsigned long)h.alloc_cnt, (unsigned long)h.max_size,
+                    (unsigned long)h.total_size,
+                    (unsigned long)h.alloc_fail_cnt, (unsigned long)h.reserved_size);
+    btserial.printf("stack   %lu peak of %lu, %lu now, interrupts entered %lu deep\r\n",
+                    (unsigned long)s.peak, (unsigned long)s.size, (unsigned long)s.now, (unsigned long)s.isr);
+    btserial.printf("sectors %d of %d free, %d at the fewest\r\n",
+                    SectorPool_Free(), SECTORPOOL_SECTORS, SectorPool_LowWater());
+    for (unsigned i = 0; i < sizeof(bufs) / sizeof(bufs[0]); i++)
+        btserial.printf("%-14s %5u\r\n", bufs[i].name, bufs[i].size);
+    return runok;
+}
 
-RUNRESULT_T Check(char *p)
+static void tracePut(const void *data, int len)
 {
-    if (mode == 0) {
-        ledout = 0;
-        btserial.printf("Pressure sensor: %.3f\r\n", pressin.read());
+    btserial.write(data, len);
+}
 
-        if (dsstarted) {
-            wait(.33);
-            btserial.printf("Millis before ready:%d\r\n",millis());
-            probe[0]->convertTemperature(true, DS1820::all_devices);  //Start temperature conversion, wait until ready (maybe problem but we will use NTC sensor)
-            btserial.printf("Millis after ready:%d\r\n",millis());
-            temp = probe[0]->temperature();
-            btserial.printf("Temp sensor = %3.3f\r\n", temp);
+RUNRESULT_T Trace(char *p)
+{
+    ledout = 0;
+    char *arg = strtok(p, " ");
+    if (arg && strcmp(arg, "dump") == 0) {
+        btserial.printf("\r\n");
+        Trace_Dump(tracePut);
+        btserial.printf("\r\n");
+        return runok;
+    }
+    if (arg && strcmp(arg, "clear") == 0)
+        Trace_Clear();
+    else if (arg && (strcmp(arg, "on") == 0 || strcmp(arg, "off") == 0)) {
+        bool on = arg[1] == 'n';
+        uint32_t mask = 0;
+        while ((arg = strtok(NULL, " ")) != NULL) {
+            int id = Trace_Find(arg);
+            if (id < 0) {
+                btserial.printf("\r\nunknown event %s\r\n", arg);
+                return runok;
+            }
+            mask |= 1UL << id;
+        }
+        Trace_Enable(mask ? mask : (1UL << TRACE_COUNT) - 1, on);
+    } else if (arg) {
+        btserial.printf("\r\nbad option\r\n");
+        return runfailed;
+    }
+    uint32_t n = Trace_Recorded();
+    btserial.printf("\r\n%lu events recorded, the last %u kept\r\n", (unsigned long)n,
+                    n < TRACE_RECORDS ? (unsigned)n : TRACE_RECORDS);
+    for (int i = 0; i < TRACE_COUNT; i++)
+        btserial.printf("%s %s\r\n", Trace_Name(i), Trace_Mask() & (1UL << i) ? "on" : "off");
+    return runok;
+}
 
-        } else
+RUNRESULT_T Stats(char *p)
+{
+    ledout = 0;
+    if (strncmp(p, "log", 3) == 0) {
+        unsigned long s;
+        if (sscanf(p + 3, "%lu", &s) != 1) {
+            btserial.printf("\r\nbad period\r\n");
+            return runfailed;
+        }
+        statusms = s * 1000;
+        laststatus = millis();
+    }
+    METRIC_SET(uptime_s, millis() / 1000);
+    btserial.printf("\r\n");
+    for (int i = 0; i < METRIC_COUNT; i++)
+        btserial.printf("%s=%lu\r\n", Metric_Name(i), (unsigned long)Metric_Read(i));
+    if (strncmp(p, "reset", 5) == 0)
+        Metrics_Reset();
+    return runok;
+}
+
+RUNRESULT_T Power(char *p)
+{
+    static const char *const step[PWR_MARKS] = { "clock", "sensors", "temp", "pressure", "sample", "write" };
+    POWER_T s;
+    ledout = 0;
+    pm.stats(&s);
+    if (!pm.rtcClock()) {
+        btserial.printf("\r\nno RTC clock, Stop mode not available\r\n");
+        return runok;
+    }
+    btserial.printf("\r\nRTC %lu Hz, %lu cycles, %lu stops (%lu by alarm), %lu ms stopped of %lu ms\r\n",
+                    (unsigned long)pm.rtcClock(), (unsigned long)s.cycles, (unsigned long)s.stops,
+                    (unsigned long)s.alarms, (unsigned long)(s.stopped / 1000),
+                    (unsigned long)(sched.uptime() / 1000));
+    btserial.printf("after wakeup     last      max us\r\n");
+    for (int i = 0; i < PWR_MARKS; i++)
+        btserial.printf("%-12s %8lu %8lu\r\n", step[i], (unsigned long)s.last[i], (unsigned long)s.max[i]);
+    if (strncmp(p, "reset", 5) == 0)
+        pm.resetStats();
+    return runok;
+}
+
+RUNRESULT_T Format(char *p)
+{
+    ledout = 0;
+    if (*p) {
+        if (mode != 0) {
+            btserial.printf("\r\nstop logging first\r\n");
+            return runfailed;
+        }
+        uint8_t f = logformat;
+        if (strncmp(p, "csv", 3) == 0)
+            logformat = 0;
+        else if (strncmp(p, "bin", 3) == 0)
+            logformat = 1;
+        else {
+            btserial.printf("\r\nbad format\r\n");
+            return runfailed;
+        }
+        if (!logFilename(filename)) {
+            logformat = f;
+            btserial.printf("\r\nbad filename\r\n");
+            return runfailed;
+        }
+        logblock.reset();
+    }
+    btserial.printf("\r\n%s %s\r\n", logformat ? "bin" : "csv", filename);
+    return runok;
+}
+
+RUNRESULT_T Sync(char *p)
+{
+    int n;
+    ledout = 0;
+    if (*p) {
+        if (sscanf(p, "%d", &n) != 1 || n < 1) {
+            btserial.printf("\r\nbad sync\r\n");
+            return runfailed;
+        }
+        logsync = n;
+    }
+    btserial.printf("\r\nclose every %d writes\r\n", logsync);
+    return runok;
+}
+
+
+// cycles to turn one sample into a log line, soft-float versus fixed point
+static void compareSampleMath(const SAMPLE_T *s)
+{
+    uint32_t c0 = Prof_Cycles();
+    float t = s->t16 / 16.0f;
+    float p = s->praw * (1.0f / 65535.0f);
+    if ((abs(t) > 0.001) && (p > 0.001f) && (p < 100))
+        sprintf(buffer, "%lu;%.3f;%.3f", (unsigned long)s->ms, t, p);
+    uint32_t c1 = Prof_Cycles();
+    int32_t pm = fx_calibrate(&prescal, s->praw);
+    if ((s->t16 != 0) && (pm > 1) && (pm < 100000))
+        formatSample(buffer, s, SAMPLE_FMT_LOG);
+    uint32_t c2 = Prof_Cycles();
+    btserial.printf("Sample math cycles: float %lu, fixed %lu\r\n",
+                    (unsigned long)(c1 - c0), (unsigned long)(c2 - c1));
+}
+
+// Check runs in steps, the other tasks run while it waits
+enum { check_start, check_pause, check_convert, check_card };
+static uint8_t  checkstep = check_start;
+static uint32_t checkat;                // millis() the step began
+
+RUNRESULT_T Check(char *p)
+{
+    char pv[13];
+    ledout = 0;
+    if (p == NULL) {                    // cancelled, a conversion may finish unread
+        checkstep = check_start;
+        return runok;
+    }
+    switch (checkstep) {
+    case check_start:
+        if (mode != 0)
+            return runok;
+        btserial.printf("Pressure sensor: %s\r\n", fx_format_milli(pv, fx_calibrate(&prescal, pressin.read_u16())));
+        if (!dsstarted)
             btserial.printf ("\r\nTemp sensor not present\r\n");
+        checkstep = dsstarted ? check_pause : check_card;
+        checkat = millis();
+        cliresume = 330;
+        return runbusy;
+    case check_pause:
+        if (millis() - checkat < 330)
+            return runbusy;
+        btserial.printf("Millis before ready:%d\r\n",millis());
+        chain.startConversions();    //Start temperature conversion on all buses
+        checkstep = check_convert;
+        checkat = millis();
+        cliresume = 10;
+        return runbusy;
+    case check_convert:
+        if (chain.collect() == ProbeManager::converting && millis() - checkat < 1000) {
+            cliresume = 10;
+            return runbusy;
+        }
+        btserial.printf("Millis after ready:%d\r\n",millis());
+        for (int i = 0; i < chain.count(); i++) {
+            const char *t = formatProbe(pv, i);
+            btserial.printf("Temp sensor %d = %s\r\n", i, *t ? t : "no reading");
+        }
+        {
+            SAMPLE_T smp = { millis(), chain.temperature(0), pressin.read_u16() };
+            compareSampleMath(&smp);
+        }
+        checkstep = check_card;
+        return runbusy;
+    default:                            // check_card
+        checkstep = check_start;
+        if (!sdMount())
+            return runfailed;
+        bool ok = sdtst();
+        sdUnmount();
+        return ok ? runok : runfailed;
+    }
+}
+
+#define BENCH_FILE      "/sd/bench.tmp"
+#define BENCH_BYTES     32768       // per transfer size
+#define BENCH_WRITES    64          // random sector writes
+#define BENCH_LINE      240         // serial test line
+#define BENCH_ADC_MS    4000        // ADC count window, 16 decimated readings at 4 Hz
+
+// the transfer sizes of the logger: a csv line, the console buffer, a
+// compressed block, a low power batch
+static const int benchSizes[] = { 32, 128, SECTORPOOL_SECTOR, BATCH_SECTORS * SECTORPOOL_SECTOR };
+
+// Bench runs one measurement per slice, the other tasks run in between
+enum { bench_start, bench_seq, bench_random, bench_w1, bench_adc, bench_adc_end, bench_serial };
+static uint8_t benchstep = bench_start;
+static uint8_t benchsize;               // benchSizes index of the next bench_seq
+static char   *benchbuf;                // card transfer buffer, a low power batch
+static BENCH_ADC_T benchadc;
+
+// end the card part of Bench: scratch file gone, buffer back, card released
+static void benchCardEnd(void)
+{
+    if (benchbuf == NULL)
+        return;
+    remove(BENCH_FILE);
+    sdUnmount();
+    SectorPool_Release(benchbuf);
+    benchbuf = NULL;
+}
 
-        if (!sd.disk_initialize()) { // disk initialized with code 0
-            sd.mount();
-            sdtst();
+RUNRESULT_T Bench(char *p)
+{
+    char v[13], w[13];
+    ledout = 0;
+    if (p == NULL) {                    // cancelled
+        benchCardEnd();
+        benchstep = bench_start;
+        return runok;
+    }
+    switch (benchstep) {
+    case bench_start:
+        if (mode != 0) {
+            btserial.printf("\r\nstop logging first\r\n");
+            return runfailed;
+        }
+        btserial.printf("\r\n");
+        benchstep = bench_w1;
+        benchbuf = SectorPool_Get(BATCH_SECTORS);
+        if (benchbuf == NULL)
+            btserial.printf("SD card: no free sector buffer\r\n");
+        else if (!sdMount()) {
+            SectorPool_Release(benchbuf);
+            benchbuf = NULL;
+        } else {
+            btserial.printf("SD card, %lu KB per size\r\n", (unsigned long)BENCH_BYTES / 1024);
+            btserial.printf(" size  write MB/s  read MB/s  max write us\r\n");
+            benchsize = 0;
+            benchstep = bench_seq;
+        }
+        return runbusy;
+    case bench_seq: {
+        BENCH_SEQ_T s;
+        bool ok = Benchmark_Sequential(BENCH_FILE, benchbuf, benchSizes[benchsize], BENCH_BYTES, &s);
+        btserial.printf("%5d  %10s %10s %13lu%s\r\n", s.size, fx_format_milli(v, s.wr_bps / 1000),
+                        fx_format_milli(w, s.rd_bps / 1000), (unsigned long)s.wr_max, ok ? "" : "  failed");
+        if (!ok) {
+            benchCardEnd();
+            benchstep = bench_w1;
+        } else if (++benchsize == sizeof(benchSizes) / sizeof(benchSizes[0]))
+            benchstep = bench_random;
+        return runbusy;
+    }
+    case bench_random: {
+        BENCH_RAND_T rnd;
+        bool ok = Benchmark_Random(BENCH_FILE, benchbuf, BENCH_BYTES, BENCH_WRITES, &rnd);
+        btserial.printf("random 512 B: %lu writes/s, avg %lu us, max %lu us%s\r\n", (unsigned long)rnd.iops,
+                        (unsigned long)rnd.avg, (unsigned long)rnd.max, ok ? "" : ", failed");
+        benchCardEnd();
+        benchstep = bench_w1;
+        return runbusy;
+    }
+    case bench_w1:
+        if (dsstarted) {
+            BENCH_W1_T w1;
+            Benchmark_OneWire(&chain, &w1);
+            btserial.printf("1-Wire: conversion %lu us, scratchpad avg %lu max %lu us (%d probes), chain %lu us%s\r\n",
+                            (unsigned long)w1.conversion, (unsigned long)w1.readavg, (unsigned long)w1.readmax,
+                            chain.count(), (unsigned long)w1.chain, w1.ok ? "" : ", probes missing");
         } else
-            btserial.printf("Problem with SD card\r\n"); // ooops, not initialized, code 1
-        sd.unmount();
+            btserial.printf("1-Wire: no probes\r\n");
+        benchstep = bench_adc;
+        return runbusy;
+    case bench_adc:
+        Benchmark_AdcStart(&pressin, &benchadc);
+        benchstep = bench_adc_end;
+        cliresume = BENCH_ADC_MS;
+        return runbusy;
+    case bench_adc_end:
+        Benchmark_AdcEnd(&pressin, &benchadc);
+        btserial.printf("ADC: %lu samples/s, %lu readings/s over %lu ms\r\n",
+                        (unsigned long)benchadc.samples, (unsigned long)benchadc.readings,
+                        (unsigned long)(benchadc.window / 1000));
+        benchstep = bench_serial;
+        return runbusy;
+    default:                            // bench_serial
+        benchstep = bench_start;
+        if (cp->Machine()) {            // the raw test line would break the frames
+            btserial.printf("serial TX: skipped in machine mode\r\n");
+            return runok;
+        }
+        btserial.printf("serial TX: %lu bytes/s\r\n", (unsigned long)Benchmark_SerialTx(&btport, BENCH_LINE));
+        return runok;
+    }
+}
+
+// store the ROM ids of the chain, so the next boot can skip the search
+static void saveProbes(void)
+{
+    ROMCACHE_T cache;
+    cache.count = chain.count();
+    cache.buses = chain.buses();
+    for (int i = 0; i < chain.count(); i++) {
+        cache.bus[i] = chain.busOf(i);
+        memcpy(cache.rom[i], chain.probe(i)->rom(), 8);
+    }
+    if (!RomCache_Save(&cache))
+        btserial.printf("Could not store the probe table\r\n");
+}
+
+// Take over the probes of the last boot with one scratchpad read each, the
+// full Search ROM only runs when there is no table or a probe did not answer
+static void startProbes(void)
+{
+    ROMCACHE_T cache;
+    int adopted = 0;
+    bool cached = RomCache_Load(&cache) && cache.count > 0 && cache.buses == chain.buses();
+
+    if (cached) {
+        for (int i = 0; i < cache.count; i++) {
+            if (chain.adopt(cache.bus[i], cache.rom[i]))
+                adopted++;
+        }
+    }
+    if (!cached || adopted < cache.count) {
+        chain.discover();
+        saveProbes();
+    }
+    dsstarted = chain.count() > 0;
+}
+
+RUNRESULT_T Probes(char *p)
+{
+    ledout = 0;
+    if (strncmp(p, "scan", 4) == 0) {
+        if (mode != 0) {
+            btserial.printf("\r\nstop logging first\r\n");
+            return runfailed;
+        }
+        chain.discover();               // picks up probes added since boot
+        saveProbes();
+        dsstarted = chain.count() > 0;
+    }
+    btserial.printf("\r\n%d probes on %d buses, %lu readings\r\n", chain.count(), chain.buses(),
+                    (unsigned long)chain.readings());
+    for (int i = 0; i < chain.count(); i++) {
+        const char *rom = chain.probe(i)->rom();
+        char t[13];
+        btserial.printf("%2d %d ", i, chain.busOf(i));
+        for (int b = 7; b >= 0; b--)
+            btserial.printf("%02X", rom[b]);
+        btserial.printf(" %s\r\n", *formatProbe(t, i) ? t : "no reading");
     }
     return runok;
 }
 
+RUNRESULT_T Adc(char *p)
+{
+    ledout = 0;
+    if (*p) {
+        int order, log2ratio;
+        if (sscanf(p, "%d %d", &order, &log2ratio) != 2 || !pressin.configure(order, log2ratio)) {
+            btserial.printf("\r\nbad filter\r\n");
+            return runfailed;
+        }
+    }
+    const Decimator &dec = pressin.decimator();
+    btserial.printf("\r\n%d Hz, order %d, ratio %lu: %lu Hz, %lu readings, %lu overruns\r\n",
+                    PRESSADC_RATE, dec.order(), (unsigned long)dec.ratio(),
+                    (unsigned long)pressin.outputRate(), (unsigned long)pressin.readings(),
+                    (unsigned long)pressin.overruns());
+    return runok;
+}
+
+RUNRESULT_T Jitter(char *p)
+{
+    JITTER_T j;
+    ledout = 0;
+    measureTick.stats(&j);
+    if (j.samples < 2)
+        btserial.printf("\r\nno samples\r\n");
+    else {
+        btserial.printf("\r\n%lu samples, period %lu us\r\n", (unsigned long)j.samples, (unsigned long)j.period);
+        btserial.printf("interval: min %+ld max %+ld std %lu us\r\n", (long)j.intmin, (long)j.intmax,
+                        (unsigned long)j.intstd);
+        btserial.printf("latency:  min %lu max %lu us\r\n", (unsigned long)j.latmin, (unsigned long)j.latmax);
+    }
+    if (strncmp(p, "reset", 5) == 0)
+        measureTick.resetStats();
+    return runok;
+}
+
+RUNRESULT_T Deadline(char *p)
+{
+    DEADLINE_T d;
+    ledout = 0;
+    if (strncmp(p, "flags", 5) == 0) {
+        if (strstr(p, "on"))
+            logstatus = true;
+        else if (strstr(p, "off"))
+            logstatus = false;
+        btserial.printf("\r\nstatus column %s\r\n", logstatus ? "on" : "off");
+        return runok;
+    }
+    measureTick.deadlines(&d);
+    btserial.printf("\r\n%lu ticks, %lu missed, %lu in a row now, %lu at most\r\n",
+                    (unsigned long)d.ticks, (unsigned long)d.misses, (unsigned long)d.streak,
+                    (unsigned long)d.maxstreak);
+    btserial.printf("late (>%lu us): %lu, skipped: %lu, overruns: %lu\r\n", (unsigned long)d.limit,
+                    (unsigned long)d.late, (unsigned long)d.skipped, (unsigned long)d.overruns);
+    btserial.printf("execution: avg %lu max %lu us\r\n", (unsigned long)d.execavg, (unsigned long)d.execmax);
+    if (strncmp(p, "reset", 5) == 0)
+        measureTick.resetStats();
+    return runok;
+}
+
+RUNRESULT_T Cal(char *p)
+{
+    ledout = 0;
+    if (*p) {
+        long offset, gain;
+        if (sscanf(p, "%ld %ld", &offset, &gain) != 2) {
+            btserial.printf("\r\nbad calibration\r\n");
+            return runfailed;
+        }
+        prescal.offset = offset;
+        prescal.gain = gain;
+    }
+    btserial.printf("\r\n%ld %ld\r\n", (long)prescal.offset, (long)prescal.gain);
+    return runok;
+}
+
 // Provide the serial interface methods for the command processor
+// Serial receive interrupt: queue the characters, the command line task takes them
+void onSerialRx(void)
+{
+    MemStats_IsrMark();
+    int n = 0;
+    while (btport.readable()) {
+        if (rxbuf.full())
+            METRIC_INC(rx_overruns);    // the oldest character gives way
+        rxbuf.push(btport.getc());
+        n++;
+    }
+    METRIC_ADD(rx_bytes, n);
+    TRACE(rx, n);
+    lastRx = millis();
+    sched.post(tCli);
+}
+
 int mReadable()
 {
-    return btserial.readable();
+    return !rxbuf.empty();
 }
 int mGetCh()
 {
-    return btserial.getc();
+    char c = 0;
+    rxbuf.pop(c);
+    return c;
 }
 int mPutCh(int a)
 {
-    return btserial.putc(a);
+    return btport.putc(a);
 }
 int mPutS(const char * s)
 {
-    return btserial.printf("%s\r\n", s);
+    return btport.printf("%s\r\n", s);
+}
+unsigned long mMillis()
+{
+    return millis();
 }
 
 int main(int argc, char* argv[])
 {
+    MemStats_Paint();           // before anything else takes the stack
     strcpy (filename, "default.csv");
     sprintf(longfilename, "/sd/%s", filename);
 
-    CMDP_T * cp = GetCommandProcessor();
+    cp = GetCommandProcessor();
 
-    wdt.Configure (10.0);
+    hbBoot    = sup.watch("boot", 30000);  // probe search and RTC start until the scheduler runs
+    hbSched   = sup.watch("scheduler", 8000);
+    hbSampler = sup.watch("sampler", 2000);
+    hbMeasure = sup.watch("measure", 60000);
+    sup.pause(hbSched);
+    sup.pause(hbSampler);       // until a logging mode starts
+    sup.pause(hbMeasure);
+    sup.track(&sched);
+    sup.begin(10.0);
 
-    //btserial.baud(115200);
-    btserial.baud(9600);
+    //btport.baud(115200);
+    btport.baud(9600);
     cp->Init(
         &SignOnBannerCmd,
         0 | CFG_ENABLE_SYSTEM
@@ -323,35 +1640,72 @@ int main(int argc, char* argv[])
         mGetCh,     // User provided API
         mPutCh,     // User provided API
         mPutS);     // User provided API
+    cp->Clock(mMillis);     // machine mode frame timeout
 
     // Start adding custom commands now
+    cp->Add(&AdcCmd);
+    cp->Add(&BenchCmd);
+    cp->Add(&CalCmd);
+    cp->Add(&DeadlineCmd);
     cp->Add(&FilenameCmd);
     cp->Add(&FileGetCmd);
+    cp->Add(&FormatCmd);
+    cp->Add(&HealthCmd);
+    cp->Add(&JitterCmd);
     cp->Add(&CheckCmd);
     cp->Add(&LsCmd);
+    cp->Add(&MemCmd);
     cp->Add(&ModeCmd);
+    cp->Add(&PowerCmd);
+    cp->Add(&ProfCmd);
+    cp->Add(&TraceCmd);
+    cp->Add(&ProbesCmd);
+    cp->Add(&StatsCmd);
+    cp->Add(&SyncCmd);
 
     // Should never "wait" in here
 
-    if (wdt.WatchdogCausedReset())
-        btserial.printf("ERROR: Gauge has been restarted by watchdog\n");
+    startMillis();
+    Prof_Init();
+    Trace_Init();
+    if (!pm.begin())
+        btserial.printf("ERROR: no RTC clock, low power mode will not stop the clocks\n");
+    if (!pressin.start())
+        btserial.printf("ERROR: pressure input has no ADC1 channel\n");
 
-    // Initialize the probe array to DS1820 objects
-    int num_devices = 0;
+    // Find the DS1820 probes on all buses
+    static const PinName w1pins[] = W1_PINS;
+    for (unsigned i = 0; i < sizeof(w1pins) / sizeof(w1pins[0]); i++)
+        chain.addBus(w1pins[i]);
+#ifdef W1_UART_PIN
+    if (w1uart.valid())
+        chain.addBus(&w1uart);
+#endif
+    startProbes();
 
-    while(DS1820::unassignedProbe(W1_PIN)) {
-        probe[num_devices] = new DS1820(W1_PIN);
-        num_devices++;
-        if (num_devices == MAX_PROBES)
-            break;
-    }
-    dsstarted = num_devices;
+    // Nothing busy-waits any more: interrupts post tasks, the scheduler
+    // sleeps whenever no task is ready
+    tSampler  = sched.add(&samplerTask, 0, "sampler");
+    tProbe    = sched.add(&probeTask, 1, "probes");
+    tWake     = sched.add(&wakeTask, 1, "wake");
+    tMeasure  = sched.add(&measureTask, 1, "measure");
+    tLogger   = sched.add(&loggerTask, 2, "logger");
+    tCli      = sched.add(&cliTask, 3, "cli");
+    tWatchdog = sched.add(&watchdogTask, 4, "watchdog");
+    sched.every(tWatchdog, 1000);
+    sched.onIdle(&onIdle);
 
-    while (cp->Run() == runok) { // run this timeslice
-        // do non-blocking things here
-        wdt.Service();       // kick the dog before the timeout
-        ledout = 1;
+    CRUMB_T crumb;
+    if (sup.lastCrash(&crumb)) {
+        btserial.printf("ERROR: Gauge has been restarted by watchdog\n");
+        printCrash(&crumb);
     }
+    sup.pause(hbBoot);
+    sup.resume(hbSched);
+    btport.attach(&onSerialRx, Serial::RxIrq);
+    sched.post(tCli);           // sign-on banner and first prompt
+
+    sched.run();                // until the command line exits
     cp->End();  // cleanup
     return 0;
 }
\ No newline at end of file
@@ -31,31 +31,62 @@
  */
 
 #include "mbed.h"
+#include "us_ticker_api.h"
 #include "millis.h"
 
-static volatile uint32_t millisValue = 0;
+static uint32_t lastTicks = 0;          // us_ticker value at the previous call
+static uint32_t highTicks = 0;          // number of us_ticker wraps
+static uint64_t skipped = 0;            // time the us_ticker was stopped
 
 static  Ticker ticker;
 
-void millisTicker ()
+uint64_t micros64 ()
 {
-    millisValue ++;
+    uint64_t value;
+    core_util_critical_section_enter();
+    uint32_t ticks = us_ticker_read();
+    if (ticks < lastTicks)
+        highTicks++;
+    lastTicks = ticks;
+    value = (((uint64_t)highTicks << 32) | ticks) + skipped;
+    core_util_critical_section_exit();
+    return value;
+}
+
+void microsSkip (uint64_t us)
+{
+    core_util_critical_section_enter();
+    skipped += us;
+    core_util_critical_section_exit();
+}
+
+uint64_t microsSkipped ()
+{
+    return skipped;
+}
+
+uint32_t micros ()
+{
+    return (uint32_t)micros64();
 }
 
 uint32_t millis ()
 {
-    return millisValue;
+    return (uint32_t)(micros64() / 1000);
 }
 
-void setMillis (uint32_t theValue) {
-    millisValue = theValue;
+static void millisGuard ()
+{
+    micros64();                         // must see every wrap, i.e. run at least every 71 minutes
 }
 
 void startMillis () {
-    ticker.attach (millisTicker, 0.001);    
+    static bool started = false;
+    if (!started) {
+        started = true;
+        ticker.attach (millisGuard, 600.0);
+    }
 }
 
 void stopMillis () {
-    ticker.detach ();
 }
-
@@ -30,12 +30,34 @@
  *  Description:    millis library for mbed
  */
 
-#include "mbed.h"
+/*
+ *  The counter is no longer a 1 kHz Ticker: time is read from the free
+ *  running us_ticker and extended to 64 bits, so there is no interrupt per
+ *  millisecond, no ISR latency in the count, and the count never stops.
+ */
 
-void millisTicker ();
+#ifndef MILLIS_H
+#define MILLIS_H
+
+#include "mbed.h"
 
 uint32_t millis ();
 
+/* microseconds since boot, 32 bits (wraps after 71 minutes) and 64 bits */
+uint32_t micros ();
+
+uint64_t micros64 ();
+
+/* the us_ticker stops in Stop mode: add the time slept to the timebase */
+void microsSkip (uint64_t us);
+
+/* total time added by microsSkip(), micros64() - microsSkipped() is the raw us_ticker */
+uint64_t microsSkipped ();
+
+/* starts the guard that keeps the 64 bit extension alive while idle */
 void startMillis ();
 
-void stopMillis ();
\ No newline at end of file
+/* kept for compatibility, the timebase does not stop any more */
+void stopMillis ();
+
+#endif
\ No newline at end of file
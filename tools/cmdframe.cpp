@@ -0,0 +1,159 @@
+// cmdframe : machine mode frames of the gauge's command line, for scripts
+//            and host tools that drive it (see CommandProcessor.h, REPLY_T)
+//
+// usage: cmdframe -e ID COMMAND...   the request frame of a command line
+//        cmdframe -c ID              the frame that cancels request ID
+//        cmdframe -d [capture]       the replies in a capture, stdin if none
+//
+// Frames go to stdout. The port has to be in machine mode first, a
+// 'Machine on' line on the command line.
+//
+// The decoder collects the frames of each request and prints the reply
+// once its last frame is in:
+//     #ID STATUS BYTES
+//     payload
+// Output outside of a request, id 0, prints as it comes. Bytes between
+// frames, the command line before Machine on, are skipped. The exit status
+// is 1 if a frame did not check or a reply was left incomplete.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+extern "C" {
+#include "CommandProcessor.h"
+}
+
+static const char *const statuses[] = {
+    "more", "ok", "failed", "unknown", "ambiguous", "full", "cancelled", "badframe", "exit"
+};
+
+static unsigned char crc8(unsigned char crc, unsigned char b)
+{
+    for (int i = 0; i < 8; i++) {
+        int mix = (crc ^ b) & 0x01;
+        crc >>= 1;
+        if (mix)
+            crc ^= 0x8C;
+        b >>= 1;
+    }
+    return crc;
+}
+
+static int usage(const char *name)
+{
+    fprintf(stderr, "usage: %s -e ID COMMAND... | -c ID | -d [capture]\n", name);
+    return 2;
+}
+
+static void put(const std::string &frame)
+{
+    unsigned char crc = 0;
+    putchar(CMDP_SOF);
+    for (size_t i = 0; i < frame.size(); i++) {
+        crc = crc8(crc, (unsigned char)frame[i]);
+        putchar((unsigned char)frame[i]);
+    }
+    putchar(crc);
+}
+
+static int encode(int id, int argc, char *argv[])
+{
+    std::string line;
+    for (int i = 0; i < argc; i++) {
+        if (i)
+            line += ' ';
+        line += argv[i];
+    }
+    if (line.size() > CMDP_MAX_CMDLEN) {
+        fprintf(stderr, "command longer than %d\n", CMDP_MAX_CMDLEN);
+        return 1;
+    }
+    std::string frame;
+    frame += (char)id;
+    frame += (char)line.size();
+    put(frame + line);
+    return 0;
+}
+
+static void show(int id, int status, const std::string &payload)
+{
+    printf("#%d %s %u\n", id, status < (int)(sizeof(statuses) / sizeof(statuses[0])) ? statuses[status] : "?",
+           (unsigned)payload.size());
+    fwrite(payload.data(), 1, payload.size(), stdout);
+    if (!payload.empty() && payload[payload.size() - 1] != '\n')
+        putchar('\n');
+}
+
+static int decode(FILE *fp)
+{
+    std::string pending[256];           // replies so far, by request id
+    bool open[256] = { false };
+    unsigned frames = 0, bad = 0;
+    int c;
+
+    while ((c = getc(fp)) != EOF) {
+        if (c != CMDP_SOF)
+            continue;
+        unsigned char head[3];
+        if (fread(head, 1, 3, fp) != 3)
+            break;
+        std::string payload(head[2], '\0');
+        int crc = EOF;
+        if (fread(&payload[0], 1, head[2], fp) != head[2] || (crc = getc(fp)) == EOF)
+            break;
+        unsigned char sum = 0;
+        for (int i = 0; i < 3; i++)
+            sum = crc8(sum, head[i]);
+        for (size_t i = 0; i < payload.size(); i++)
+            sum = crc8(sum, (unsigned char)payload[i]);
+        if (sum != crc) {
+            bad++;
+            continue;
+        }
+        frames++;
+        int id = head[0], status = head[1];
+        if (id == 0) {
+            show(0, status, payload);
+            continue;
+        }
+        pending[id] += payload;
+        open[id] = status == replymore;
+        if (!open[id]) {
+            show(id, status, pending[id]);
+            pending[id].clear();
+        }
+    }
+    int incomplete = 0;
+    for (int i = 0; i < 256; i++)
+        incomplete += open[i];
+    fprintf(stderr, "%u frames, %u did not check, %d replies incomplete\n", frames, bad, incomplete);
+    return bad || incomplete ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc >= 3 && (strcmp(argv[1], "-e") == 0 || strcmp(argv[1], "-c") == 0)) {
+        int id = atoi(argv[2]);
+        if (id < 1 || id > 255) {
+            fprintf(stderr, "request id 1 to 255\n");
+            return 2;
+        }
+        if (argv[1][1] == 'c')
+            return argc == 3 ? encode(id, 0, NULL) : usage(argv[0]);
+        return argc > 3 ? encode(id, argc - 3, argv + 3) : usage(argv[0]);
+    }
+    if (argc >= 2 && argc <= 3 && strcmp(argv[1], "-d") == 0) {
+        FILE *fp = argc == 3 ? fopen(argv[2], "rb") : stdin;
+        if (!fp) {
+            perror(argv[2]);
+            return 1;
+        }
+        int rc = decode(fp);
+        if (fp != stdin)
+            fclose(fp);
+        return rc;
+    }
+    return usage(argv[0]);
+}
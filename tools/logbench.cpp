@@ -0,0 +1,124 @@
+// logbench : compression ratio of the LogCodec block format on recorded casts
+//
+// usage: logbench <cast.csv> [<cast.csv> ...]
+//
+// Each cast is a text log as written by the firmware (millis;T;P per line).
+// The samples are encoded exactly like the firmware does in Format bin mode,
+// decoded again to check the round trip, and the card usage is compared with
+// the text log. The CSV is charged for the sectors it occupies, so both sides
+// are measured in what the card actually stores.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "LogCodec.h"
+
+using namespace std;
+
+static bool parse_milli(const char *s, int32_t *v, const char **end)
+{
+    char *e;
+    double d = strtod(s, &e);
+    if (e == s)
+        return false;
+    *v = (int32_t)(d < 0 ? d * 1000.0 - 0.5 : d * 1000.0 + 0.5);
+    *end = e;
+    return true;
+}
+
+static bool parse_line(const char *line, LogSample &s)
+{
+    char *e;
+    const char *p;
+    unsigned long ms = strtoul(line, &e, 10);
+    if (e == line || *e != ';')
+        return false;
+    s.ms = ms;
+    if (!parse_milli(e + 1, &s.temp, &p) || *p != ';')
+        return false;
+    return parse_milli(p + 1, &s.pres, &p);
+}
+
+static bool same(const LogSample &a, const LogSample &b)
+{
+    return a.ms == b.ms && a.temp == b.temp && a.pres == b.pres;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <cast.csv> [...]\n", argv[0]);
+        return 2;
+    }
+    printf("%-24s %8s %10s %10s %10s %8s %7s\n",
+           "cast", "samples", "csv_bytes", "csv_card", "bin_card", "per_blk", "ratio");
+    unsigned long tot_samples = 0, tot_csv = 0, tot_bin = 0;
+    int rc = 0;
+
+    for (int a = 1; a < argc; a++) {
+        FILE *fp = fopen(argv[a], "r");
+        if (!fp) {
+            perror(argv[a]);
+            rc = 1;
+            continue;
+        }
+        vector<LogSample> in;
+        unsigned long csv_bytes = 0;
+        char line[128];
+        while (fgets(line, sizeof(line), fp)) {
+            csv_bytes += strlen(line);
+            LogSample s;
+            if (parse_line(line, s))
+                in.push_back(s);
+        }
+        fclose(fp);
+
+        // encode
+        vector<uint8_t> card;
+        uint8_t block[LOGCODEC_BLOCK_SIZE];
+        LogEncoder enc(block);
+        for (size_t i = 0; i < in.size(); i++) {
+            if (enc.add(in[i])) {
+                card.insert(card.end(), enc.data(), enc.data() + LOGCODEC_BLOCK_SIZE);
+                enc.reset();
+            }
+        }
+        if (!enc.empty())
+            card.insert(card.end(), enc.data(), enc.data() + LOGCODEC_BLOCK_SIZE);
+
+        // decode and verify
+        size_t k = 0;
+        for (size_t off = 0; off < card.size(); off += LOGCODEC_BLOCK_SIZE) {
+            LogDecoder dec(&card[off]);
+            LogSample s;
+            while (dec.next(s)) {
+                if (k >= in.size() || !same(s, in[k])) {
+                    fprintf(stderr, "%s: round trip mismatch at sample %u\n", argv[a], (unsigned)k);
+                    rc = 1;
+                    break;
+                }
+                k++;
+            }
+        }
+        if (k != in.size()) {
+            fprintf(stderr, "%s: decoded %u of %u samples\n", argv[a], (unsigned)k, (unsigned)in.size());
+            rc = 1;
+        }
+
+        unsigned long csv_card = (csv_bytes + LOGCODEC_BLOCK_SIZE - 1) / LOGCODEC_BLOCK_SIZE * LOGCODEC_BLOCK_SIZE;
+        unsigned long blocks = card.size() / LOGCODEC_BLOCK_SIZE;
+        printf("%-24s %8u %10lu %10lu %10u %8.1f %6.2fx\n", argv[a], (unsigned)in.size(),
+               csv_bytes, csv_card, (unsigned)card.size(),
+               blocks ? (double)in.size() / blocks : 0.0,
+               card.size() ? (double)csv_card / card.size() : 0.0);
+        tot_samples += in.size();
+        tot_csv += csv_card;
+        tot_bin += card.size();
+    }
+    if (argc > 2)
+        printf("%-24s %8lu %10s %10lu %10lu %8s %6.2fx\n", "total", tot_samples, "",
+               tot_csv, tot_bin, "", tot_bin ? (double)tot_csv / tot_bin : 0.0);
+    return rc;
+}
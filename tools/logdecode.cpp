@@ -0,0 +1,70 @@
+// logdecode : turns a compressed gauge log (Format bin) back into the
+//             millis;T;P CSV that the firmware writes in text mode.
+//
+// usage: logdecode <log file> [> out.csv]
+//
+// Every 512-byte sector is decoded on its own. Sectors with a bad header
+// are reported on stderr and skipped, the rest of the file still decodes.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "LogCodec.h"
+
+static void print_milli(FILE *out, int32_t v)
+{
+    if (v < 0) {
+        fputc('-', out);
+        v = -v;
+    }
+    fprintf(out, "%ld.%03ld", (long)(v / 1000), (long)(v % 1000));
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <log file>\n", argv[0]);
+        return 2;
+    }
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    uint8_t block[LOGCODEC_BLOCK_SIZE];
+    unsigned long sector = 0, samples = 0, bad = 0;
+    size_t n;
+    while ((n = fread(block, 1, sizeof(block), fp)) > 0) {
+        if (n != sizeof(block)) {
+            fprintf(stderr, "sector %lu: truncated (%u bytes)\n", sector, (unsigned)n);
+            bad++;
+            break;
+        }
+        LogDecoder dec(block);
+        if (!dec.valid()) {
+            fprintf(stderr, "sector %lu: bad header, skipped\n", sector);
+            bad++;
+        } else {
+            LogSample s;
+            uint16_t got = 0;
+            while (dec.next(s)) {
+                fprintf(stdout, "%lu;", (unsigned long)s.ms);
+                print_milli(stdout, s.temp);
+                fputc(';', stdout);
+                print_milli(stdout, s.pres);
+                fputs("\r\n", stdout);
+                got++;
+            }
+            if (got != dec.count() || got == 0) {
+                fprintf(stderr, "sector %lu: corrupt payload after %u samples\n", sector, got);
+                bad++;
+            }
+            samples += got;
+        }
+        sector++;
+    }
+    fclose(fp);
+    fprintf(stderr, "%lu sectors, %lu samples, %lu bad\n", sector, samples, bad);
+    return bad ? 1 : 0;
+}
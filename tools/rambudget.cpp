@@ -0,0 +1,183 @@
+// rambudget : static RAM and stack frames of the firmware, per subsystem
+//
+// usage: nm -A -C -S -t d <objects> | rambudget [options] [<.su files>]
+//   -r BYTES  RAM of the part (20480)
+//   -p DIR    build directory prefix of the object paths, stripped
+//   -n N      largest variables listed (12)
+//
+// make ram, in firmware/ or firmware/host/, runs it over the firmware's
+// objects. A subsystem is the top directory of an object under the build
+// directory, the library the sources come from, or the source file for
+// main.cpp.
+//
+// Static RAM is the initialized data and the zero filled bss of the
+// objects, before the linker drops unused sections; the libraries (mbed,
+// newlib) are not in it, the size of the linked image has them. The heap
+// is not used, the build rejects the firmware's objects when they call an
+// allocator. Stack frames come from the compiler's -fstack-usage files,
+// one per function: a call chain stacks the frames of its functions, a
+// '+' marks a frame that grows at run time.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct subsystem {
+    unsigned long data, bss;
+    unsigned long frame;
+    string deepest;
+    bool dynamic;
+    subsystem() : data(0), bss(0), frame(0), dynamic(false) {}
+};
+
+struct variable {
+    unsigned long size;
+    string sub, name;
+};
+
+static string prefix;
+static map<string, subsystem> subs;
+
+// the subsystem of a build path: its top directory, or the file name without extension
+static string subsystem_of(string path)
+{
+    if (!prefix.empty() && path.compare(0, prefix.size(), prefix) == 0)
+        path.erase(0, prefix.size());
+    size_t slash = path.find('/');
+    if (slash != string::npos)
+        return path.substr(0, slash);
+    return path.substr(0, path.rfind('.'));
+}
+
+static bool by_size(const variable &a, const variable &b)
+{
+    return a.size > b.size;
+}
+
+static bool by_static(const pair<string, subsystem> &a, const pair<string, subsystem> &b)
+{
+    return a.second.data + a.second.bss > b.second.data + b.second.bss;
+}
+
+// one line of nm -A -S: "path.o:value size type name"
+static bool parse_nm(const char *line, vector<variable> &vars)
+{
+    const char *colon = strstr(line, ".o:");
+    if (!colon)
+        return false;
+    string path(line, colon + 2 - line);
+    char type;
+    unsigned long value, size;
+    int name;
+    if (sscanf(colon + 3, "%lu %lu %c %n", &value, &size, &type, &name) != 3)
+        return false;               // undefined, or no size
+    subsystem &s = subs[subsystem_of(path)];
+    switch (type) {
+    case 'b': case 'B': case 's': case 'S': case 'C':
+        s.bss += size;
+        break;
+    case 'd': case 'D': case 'g': case 'G':
+        s.data += size;
+        break;
+    default:
+        return true;                // code or constants, in flash
+    }
+    variable v;
+    v.size = size;
+    v.sub = subsystem_of(path);
+    v.name = string(colon + 3 + name);
+    while (!v.name.empty() && (v.name[v.name.size() - 1] == '\n' || v.name[v.name.size() - 1] == '\r'))
+        v.name.erase(v.name.size() - 1);
+    vars.push_back(v);
+    return true;
+}
+
+// one -fstack-usage file: "file:line:col:function<TAB>bytes<TAB>static|dynamic[,bounded]"
+static void parse_su(const char *file)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp) {
+        perror(file);
+        return;
+    }
+    subsystem &s = subs[subsystem_of(file)];
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        char *tab = strchr(line, '\t');
+        if (!tab)
+            continue;
+        *tab = '\0';
+        char *name = line;
+        for (int k = 0; k < 3 && name; k++) {
+            name = strchr(name, ':');
+            if (name)
+                name++;
+        }
+        unsigned long bytes = strtoul(tab + 1, NULL, 10);
+        if (name && bytes > s.frame) {
+            s.frame = bytes;
+            s.deepest = name;
+            s.dynamic = strstr(tab + 1, "dynamic") != NULL;
+        }
+    }
+    fclose(fp);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long ram = 20480;
+    unsigned listed = 12;
+    int a = 1;
+    for (; a + 1 < argc && argv[a][0] == '-' && argv[a][1] && !argv[a][2]; a += 2) {
+        switch (argv[a][1]) {
+        case 'r': ram = strtoul(argv[a + 1], NULL, 0); break;
+        case 'p': prefix = argv[a + 1]; break;
+        case 'n': listed = atoi(argv[a + 1]); break;
+        default:
+            fprintf(stderr, "usage: nm -A -C -S -t d <objects> | %s [-r BYTES] [-p DIR] [-n N] [<.su files>]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    vector<variable> vars;
+    char line[512];
+    while (fgets(line, sizeof(line), stdin))
+        parse_nm(line, vars);
+    for (; a < argc; a++)
+        parse_su(argv[a]);
+    if (subs.empty()) {
+        fprintf(stderr, "%s: no symbols on stdin\n", argv[0]);
+        return 1;
+    }
+
+    vector<pair<string, subsystem> > order(subs.begin(), subs.end());
+    stable_sort(order.begin(), order.end(), by_static);
+    unsigned long data = 0, bss = 0;
+    printf("%-18s %7s %7s %7s %7s  %s\n", "subsystem", "data", "bss", "static", "frame", "deepest frame");
+    for (size_t i = 0; i < order.size(); i++) {
+        const subsystem &s = order[i].second;
+        data += s.data;
+        bss += s.bss;
+        printf("%-18s %7lu %7lu %7lu %6lu%c  %s\n", order[i].first.c_str(), s.data, s.bss,
+               s.data + s.bss, s.frame, s.dynamic ? '+' : ' ', s.deepest.c_str());
+    }
+    printf("%-18s %7lu %7lu %7lu\n", "total", data, bss, data + bss);
+
+    stable_sort(vars.begin(), vars.end(), by_size);
+    printf("\nlargest variables\n");
+    for (size_t i = 0; i < vars.size() && i < listed; i++)
+        printf("%7lu  %-18s %s\n", vars[i].size, vars[i].sub.c_str(), vars[i].name.c_str());
+
+    printf("\nstatic  %lu of %lu bytes, %ld left for the libraries and the stack\n",
+           data + bss, ram, (long)ram - (long)(data + bss));
+    printf("heap    none, the firmware's objects call no allocator\n");
+    return 0;
+}
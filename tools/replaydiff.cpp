@@ -0,0 +1,271 @@
+// replaydiff : checks the firmware's log of a cast replay against the cast
+//
+// usage: replaydiff [options] <cast.csv> <log.csv>
+//   -t C    temperature tolerance, degrees C (0.070)
+//   -p X    pressure tolerance, units (0.002)
+//   -T MS   a temperature may be this old, the probe pipeline (see below)
+//   -P MS   a pressure may be this old (0)
+//   -i MS   sample interval the log should have (the cast's median)
+//
+// The log is the copy gauge --replay leaves behind (see firmware/host/
+// Replay.h), a Format bin log goes through logdecode first. Both are
+// millis;T;P lines, extra log columns are ignored.
+//
+// Timing: the sample interval of the log (median, range, mean, deviation),
+// gaps of more than 1.5 times the expected interval counted as missing
+// samples, records out of order or repeated, and the records the cast span
+// has room for.
+//
+// Values: each record inside the cast span is held against the range the
+// cast took over the lag window before its time, interpolated like the
+// simulated sensors do. A temperature is taken at the start of a
+// conversion, picked up at the first probe poll after its end and held
+// until the next one is in: by default it may be two such cycles and a
+// sample interval old and still be right.
+//
+// The first problems are listed, the exit status is 1 if there are any.
+//
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+struct row {
+    unsigned long ms;
+    int32_t t, p;           // milli-units
+    unsigned long line;
+};
+
+#define MAX_LISTED 10
+#define CONVERSION_MS   750     // DS18B20 12 bit conversion, the firmware's PWR_CONV_MS
+#define PROBE_POLL_MS   250     // the firmware's probe task period in Mode 1
+
+static unsigned long listed;
+
+static bool parse_milli(const char *s, int32_t *v, const char **end)
+{
+    char *e;
+    double d = strtod(s, &e);
+    if (e == s)
+        return false;
+    *v = (int32_t)(d < 0 ? d * 1000.0 - 0.5 : d * 1000.0 + 0.5);
+    *end = e;
+    return true;
+}
+
+static bool parse_line(const char *line, row &r)
+{
+    char *e;
+    const char *p;
+    unsigned long ms = strtoul(line, &e, 10);
+    if (e == line || *e != ';')
+        return false;
+    r.ms = ms;
+    if (!parse_milli(e + 1, &r.t, &p) || *p != ';')
+        return false;
+    return parse_milli(p + 1, &r.p, &p);
+}
+
+static bool load(const char *file, vector<row> &rows)
+{
+    FILE *fp = fopen(file, "r");
+    if (!fp) {
+        perror(file);
+        return false;
+    }
+    char line[256];
+    unsigned long n = 0;
+    row r;
+    while (fgets(line, sizeof(line), fp)) {
+        n++;
+        if (parse_line(line, r)) {
+            r.line = n;
+            rows.push_back(r);
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+static void problem(const row &r, const char *fmt, ...)
+{
+    if (++listed > MAX_LISTED)
+        return;
+    va_list ap;
+    va_start(ap, fmt);
+    printf("  line %lu, %lu ms: ", r.line, r.ms);
+    vprintf(fmt, ap);
+    putchar('\n');
+    va_end(ap);
+}
+
+static bool by_ms(const row &a, const row &b)
+{
+    return a.ms < b.ms;
+}
+
+// the cast's value at a time, interpolated, held before and after
+static double at(const vector<row> &cast, double ms, int32_t row::*v)
+{
+    row key;
+    key.ms = (unsigned long)ms;
+    const row *first = &cast[0], *end = first + cast.size();
+    const row *b = upper_bound(first, end, key, by_ms);
+    if (b == first)
+        return b->*v;
+    if (b == end)
+        return cast.back().*v;
+    const row *a = b - 1;
+    return a->*v + (double)(b->*v - a->*v) * (ms - a->ms) / (double)(b->ms - a->ms);
+}
+
+// how far a value is from the range the cast took over [ms - lag, ms]
+static double error(const vector<row> &cast, const row &r, double lag, int32_t row::*v)
+{
+    double from = r.ms > lag ? r.ms - lag : 0;
+    double lo = at(cast, r.ms, v), hi = lo;
+    double e = at(cast, from, v);
+    lo = min(lo, e);
+    hi = max(hi, e);
+    row key;
+    key.ms = (unsigned long)from;
+    for (vector<row>::const_iterator i = upper_bound(cast.begin(), cast.end(), key, by_ms);
+            i != cast.end() && i->ms <= r.ms; ++i) {
+        lo = min(lo, (double)((*i).*v));
+        hi = max(hi, (double)((*i).*v));
+    }
+    double x = r.*v;
+    return (x < lo ? lo - x : x > hi ? x - hi : 0) / 1000.0;
+}
+
+struct check {
+    const char *name, *unit;
+    int32_t row::*v;
+    double tol, lag;
+    double max, sum;
+    unsigned long over;
+};
+
+int main(int argc, char *argv[])
+{
+    check checks[2] = {
+        { "T", " C", &row::t, 0.070, -1, 0, 0, 0 },
+        { "P", "", &row::p, 0.002, 0, 0, 0, 0 },
+    };
+    long interval = 0;
+    int a = 1;
+    for (; a + 1 < argc && argv[a][0] == '-' && argv[a][1] && !argv[a][2]; a += 2) {
+        double x = atof(argv[a + 1]);
+        switch (argv[a][1]) {
+        case 't': checks[0].tol = x; break;
+        case 'p': checks[1].tol = x; break;
+        case 'T': checks[0].lag = x; break;
+        case 'P': checks[1].lag = x; break;
+        case 'i': interval = (long)x; break;
+        default: a = argc; break;
+        }
+    }
+    if (argc - a != 2) {
+        fprintf(stderr, "usage: %s [-t C] [-p X] [-T MS] [-P MS] [-i MS] <cast.csv> <log.csv>\n", argv[0]);
+        return 2;
+    }
+    vector<row> cast, log;
+    if (!load(argv[a], cast) || !load(argv[a + 1], log))
+        return 1;
+    if (cast.size() < 2 || log.size() < 2) {
+        fprintf(stderr, "%s: too few samples\n", cast.size() < 2 ? argv[a] : argv[a + 1]);
+        return 1;
+    }
+    stable_sort(cast.begin(), cast.end(), by_ms);
+    unsigned long c0 = cast.front().ms, c1 = cast.back().ms;
+    if (interval <= 0) {
+        vector<long> civ;
+        for (size_t i = 1; i < cast.size(); i++)
+            civ.push_back((long)(cast[i].ms - cast[i - 1].ms));
+        sort(civ.begin(), civ.end());
+        interval = civ[civ.size() / 2];
+    }
+    if (checks[0].lag < 0) {
+        long cycle = (CONVERSION_MS / PROBE_POLL_MS + 1) * PROBE_POLL_MS;   // the first poll after the end
+        checks[0].lag = 2 * cycle + interval;
+    }
+
+    // timing, in the order the records were written
+    vector<long> iv;
+    for (size_t i = 1; i < log.size(); i++)
+        iv.push_back((long)log[i].ms - (long)log[i - 1].ms);
+    vector<long> sorted(iv);
+    sort(sorted.begin(), sorted.end());
+    long median = sorted[sorted.size() / 2];
+    double mean = 0, var = 0;
+    for (size_t i = 0; i < iv.size(); i++)
+        mean += iv[i];
+    mean /= iv.size();
+    for (size_t i = 0; i < iv.size(); i++)
+        var += (iv[i] - mean) * (iv[i] - mean);
+
+    printf("problems:\n");
+    unsigned long missing = 0, reordered = 0, repeated = 0, inside = 0;
+    unsigned long latest = 0;
+    for (size_t i = 0; i < log.size(); i++) {
+        const row &r = log[i];
+        if (i > 0 && r.ms < latest) {
+            reordered++;
+            problem(r, "%lu ms before a record ahead of it", latest - r.ms);
+        }
+        latest = max(latest, r.ms);
+        if (r.ms < c0 || r.ms > c1)
+            continue;
+        inside++;
+        for (int k = 0; k < 2; k++) {
+            check &c = checks[k];
+            double e = error(cast, r, c.lag, c.v);
+            c.sum += e;
+            c.max = max(c.max, e);
+            if (e > c.tol) {
+                c.over++;
+                problem(r, "%s %.3f off the cast by %.3f", c.name, r.*c.v / 1000.0, e);
+            }
+        }
+    }
+
+    // gaps and repeats in time order, a late record fills its gap
+    vector<row> timed(log);
+    stable_sort(timed.begin(), timed.end(), by_ms);
+    for (size_t i = 1; i < timed.size(); i++) {
+        const row &r = timed[i];
+        long d = (long)(r.ms - timed[i - 1].ms);
+        if (d == 0) {
+            repeated++;
+            problem(r, "repeated");
+        } else if (d > interval * 3 / 2) {
+            unsigned long n = (d + interval / 2) / interval - 1;
+            missing += n;
+            problem(r, "gap of %ld ms, %lu samples missing", d, n);
+        }
+    }
+    if (listed > MAX_LISTED)
+        printf("  ... %lu more\n", listed - MAX_LISTED);
+    else if (!listed)
+        printf("  none\n");
+
+    printf("cast    %lu points, %.3f .. %.3f s\n", (unsigned long)cast.size(), c0 / 1e3, c1 / 1e3);
+    printf("log     %lu records, %lu in the cast span, room for %lu\n",
+           (unsigned long)log.size(), inside,
+           interval > 0 ? (c1 - c0) / interval + 1 : 0);
+    printf("timing  interval %ld ms median of %ld expected, %ld .. %ld ms, mean %.3f, std %.3f\n",
+           median, interval, sorted.front(), sorted.back(), mean, sqrt(var / iv.size()));
+    printf("        %lu missing, %lu reordered, %lu repeated\n", missing, reordered, repeated);
+    for (int k = 0; k < 2; k++) {
+        const check &c = checks[k];
+        printf("%-7s max error %.3f%s, mean %.4f, %lu over %.3f (lag %.0f ms)\n", c.name, c.max,
+               c.unit, inside ? c.sum / inside : 0, c.over, c.tol, c.lag);
+    }
+    return listed ? 1 : 0;
+}
@@ -0,0 +1,151 @@
+// trace2json : turns an event trace dump (Trace dump) into Chrome
+//              trace-event JSON for chrome://tracing or ui.perfetto.dev.
+//
+// usage: trace2json <capture file> [> trace.json]
+//
+// The capture is whatever the serial terminal logged, the dump is found by
+// its magic. If the capture holds several dumps the last complete one is
+// decoded. Timestamps are in us from the oldest record kept.
+//
+// A wide span event shows its 32 bit argument on the end record, the
+// viewer merges the arguments of the begin and the end.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "TraceFormat.h"
+
+#define TRACE_NAME(name, span, on) #name,
+static const char *const names[TRACE_COUNT] = {
+    TRACE_EVENTS(TRACE_NAME)
+};
+#undef TRACE_NAME
+
+#define TRACE_SPAN(name, span, on) span,
+static const int spans[TRACE_COUNT] = {
+    TRACE_EVENTS(TRACE_SPAN)
+};
+#undef TRACE_SPAN
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <capture file>\n", argv[0]);
+        return 2;
+    }
+    FILE *fp = fopen(argv[1], "rb");
+    if (!fp) {
+        perror(argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> buf;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+        buf.insert(buf.end(), chunk, chunk + n);
+    fclose(fp);
+
+    // the last dump whose records are all there
+    const uint8_t *dump = NULL;
+    unsigned dumps = 0;
+    for (size_t i = 0; i + TRACE_HEADER_SIZE <= buf.size(); i++) {
+        if (memcmp(&buf[i], TRACE_MAGIC, 4) != 0)
+            continue;
+        size_t len = TRACE_HEADER_SIZE + get_u16(&buf[i + 4]) * sizeof(TRACE_REC);
+        if (i + len > buf.size()) {
+            fprintf(stderr, "dump at offset %lu: truncated\n", (unsigned long)i);
+            continue;
+        }
+        dump = &buf[i];
+        dumps++;
+    }
+    if (!dump) {
+        fprintf(stderr, "%s: no trace dump found\n", argv[1]);
+        return 1;
+    }
+
+    unsigned count = get_u16(dump + 4);
+    uint32_t hz = get_u32(dump + 8);
+    uint32_t recorded = get_u32(dump + 12);
+    if (!hz) {
+        fprintf(stderr, "bad header: counter rate 0\n");
+        return 1;
+    }
+
+    // unwrap the 32 bit counter, and add the time it stood still in Stop mode
+    const uint8_t *rec = dump + TRACE_HEADER_SIZE;
+    int64_t elapsed = 0;
+    uint32_t prev = count ? get_u32(rec) : 0;
+    double stopped = 0;
+    int open[TRACE_COUNT] = { 0 };
+    uint16_t low[TRACE_COUNT] = { 0 };  // argument of the open wide span
+    unsigned bad = 0;
+
+    printf("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char *sep = "";
+    for (unsigned i = 0; i < count; i++, rec += sizeof(TRACE_REC)) {
+        uint32_t cycles = get_u32(rec);
+        uint16_t id = get_u16(rec + 4);
+        uint16_t arg = get_u16(rec + 6);
+        bool end = id & TRACE_END_BIT;
+        id &= ~TRACE_END_BIT;
+
+        elapsed += (int32_t)(cycles - prev);  // a step back is an event recorded late, not a wrap
+        prev = cycles;
+        if (id >= TRACE_COUNT) {
+            bad++;
+            continue;
+        }
+        if (id == TR_stop && end)
+            stopped += arg * 1000.0;
+        double ts = (double)elapsed * 1e6 / hz + stopped;
+        unsigned long value = arg;
+        bool shown = true;              // the argument, not on the begin of a wide span
+
+        const char *ph = "i";
+        if (spans[id]) {
+            if (end) {
+                if (!open[id])          // its begin was overwritten
+                    continue;
+                open[id]--;
+                ph = "E";
+                if (spans[id] == 2)
+                    value = (unsigned long)arg << 16 | low[id];
+            } else {
+                open[id]++;
+                ph = "B";
+                if (spans[id] == 2) {
+                    low[id] = arg;
+                    shown = false;
+                }
+            }
+        }
+        printf("%s{\"name\":\"", sep);
+        if (id == TR_task)
+            printf("task %u", arg);
+        else
+            printf("%s", names[id]);
+        printf("\",\"ph\":\"%s\",%s\"ts\":%.3f,\"pid\":1,\"tid\":1", ph,
+               *ph == 'i' ? "\"s\":\"t\"," : "", ts);
+        if (shown)
+            printf(",\"args\":{\"arg\":%lu}", value);
+        printf("}");
+        sep = ",\n";
+    }
+    printf("\n]}\n");
+
+    fprintf(stderr, "%u dumps, last: %u records of %lu recorded at %lu Hz, %u bad\n", dumps, count,
+            (unsigned long)recorded, (unsigned long)hz, bad);
+    return bad ? 1 : 0;
+}